@@ -0,0 +1,596 @@
+/*
+ * apex_cache.c
+ * Timing model of a set-associative, write-back and write-allocate L1D with
+ * an optional L2 behind it. Only tags are kept: loads and stores still read
+ * and write data_memory, the hierarchy just decides how many cycles the
+ * memory stage needs. Lines carry the cycle their fill completes, so a
+ * prefetch that is still in flight makes the demand access wait for it.
+ *
+ * Behind the last level sits either a flat memory latency or the DRAM
+ * model, whose reads complete at a cycle only known once the controller
+ * schedules them; the memory stage then polls APEX_cache_poll.
+ *
+ * The cores of a multicore run only keep their L1D: what reaches memory
+ * from there goes to the L2 and memory they share, held by a separate
+ * APEX_CPU (see apex_multicore.c).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "apex_cache.h"
+#include "apex_dram.h"
+#include "apex_macros.h"
+#include "apex_multicore.h"
+#include "apex_prefetch.h"
+#include "apex_table.h"
+
+/* Lines of level, for a lookup that may update them */
+static APEX_CacheLine *
+level_lines(APEX_Caches *c, int level)
+{
+    return APEX_table_write(&c->lines[level]);
+}
+
+/* Sets the geometry up from the configuration, done on the first access */
+void
+APEX_cache_init(APEX_CPU *cpu)
+{
+    APEX_Caches *c = &cpu->caches;
+
+    c->line_shift = 0;
+    while ((1 << c->line_shift) < cpu->config.cache_line)
+    {
+        c->line_shift++;
+    }
+    for (int level = 0; level < CACHE_LEVELS; ++level)
+    {
+        int num_lines = cpu->config.cache_size[level] / cpu->config.cache_line;
+        APEX_CacheLine *lines = APEX_table_alloc(&c->lines[level],
+                                                 num_lines * sizeof(APEX_CacheLine));
+
+        c->level[level].ways = cpu->config.cache_ways[level];
+        c->level[level].num_sets = num_lines / c->level[level].ways;
+        for (int i = 0; i < num_lines; ++i)
+        {
+            lines[i].line = -1;
+        }
+    }
+    if (cpu->config.memory == MEMORY_DRAM)
+    {
+        APEX_dram_init(cpu);
+    }
+    c->ready = TRUE;
+}
+
+static APEX_CacheLine *
+cache_lookup(APEX_Caches *c, int level, int line)
+{
+    const APEX_Cache *cache = &c->level[level];
+    APEX_CacheLine *set = level_lines(c, level)
+                          + (line & (cache->num_sets - 1)) * cache->ways;
+
+    for (int way = 0; way < cache->ways; ++way)
+    {
+        if (set[way].line == line)
+        {
+            return &set[way];
+        }
+    }
+    return NULL;
+}
+
+static void
+cache_touch(APEX_Caches *c, int level, APEX_CacheLine *entry)
+{
+    entry->lru = ++c->level[level].stamp;
+}
+
+/*
+ * Writes back the dirty line evicted from level: into the L2 if it is
+ * below and holds the line, to memory otherwise.
+ */
+static void
+write_back(APEX_CPU *cpu, int level, int line)
+{
+    APEX_Caches *c = &cpu->caches;
+    APEX_CacheLine *below = level == CACHE_L1D && c->level[CACHE_L2].num_sets
+                                ? cache_lookup(c, CACHE_L2, line) : NULL;
+
+    if (below)
+    {
+        below->dirty = TRUE;
+        return;
+    }
+    c->mem_writes++;
+    if (cpu->core)
+    {
+        APEX_multicore_write(cpu, line);
+    }
+    else if (cpu->config.memory == MEMORY_DRAM)
+    {
+        APEX_dram_write(cpu, line, cpu->clock);
+    }
+}
+
+/*
+ * Puts line into level, evicting the least recently used way of its set.
+ * In the L1D of a core the line is marked shared if other cores hold it.
+ */
+static APEX_CacheLine *
+cache_fill(APEX_CPU *cpu, int level, int line, int ready)
+{
+    APEX_Caches *c = &cpu->caches;
+    APEX_Cache *cache = &c->level[level];
+    APEX_CacheLine *set = level_lines(c, level)
+                          + (line & (cache->num_sets - 1)) * cache->ways;
+    APEX_CacheLine *victim = &set[0];
+
+    for (int way = 0; way < cache->ways; ++way)
+    {
+        if (set[way].line < 0)
+        {
+            victim = &set[way];
+            break;
+        }
+        if (set[way].lru < victim->lru)
+        {
+            victim = &set[way];
+        }
+    }
+
+    if (victim->line >= 0 && victim->dirty)
+    {
+        cache->writebacks++;
+        write_back(cpu, level, victim->line);
+    }
+
+    victim->line = line;
+    victim->ready = ready;
+    victim->dirty = FALSE;
+    victim->prefetched = FALSE;
+    victim->shared = cpu->core && level == CACHE_L1D && APEX_multicore_shared(cpu, line);
+    cache_touch(c, level, victim);
+    return victim;
+}
+
+/*
+ * Reads line from memory, the request reaching it at cycle arrival.
+ *
+ * Returns the cycle the data is available, CACHE_PENDING while the DRAM
+ * controller has not scheduled the read, or -1 for a prefetch refused by a
+ * full controller queue.
+ */
+static int
+memory_read(APEX_CPU *cpu, int line, int arrival, int prefetch)
+{
+    if (cpu->core)
+    {
+        cpu->caches.mem_reads++;
+        return APEX_multicore_miss(cpu, line << cpu->caches.line_shift, line, arrival,
+                                   FALSE, prefetch);
+    }
+    if (cpu->config.memory == MEMORY_DRAM)
+    {
+        if (APEX_dram_read(cpu, line, arrival, prefetch))
+        {
+            cpu->caches.mem_reads++;
+            return CACHE_PENDING;
+        }
+        if (prefetch)
+        {
+            return -1;
+        }
+    }
+    cpu->caches.mem_reads++;
+    return arrival + cpu->config.mem_latency;
+}
+
+/*
+ * Returns the cycle a line prefetched at cycle now for level arrives from
+ * the level beneath it, without counting as a demand access there, or -1
+ * if memory refused the read. A line brought from memory on behalf of the
+ * L1D is placed in the L2 as well.
+ */
+int
+APEX_cache_fetch_time(APEX_CPU *cpu, int level, int line, int now)
+{
+    APEX_Caches *c = &cpu->caches;
+    int l2_latency = cpu->config.cache_latency[CACHE_L2];
+    int ready;
+
+    if (level == CACHE_L1D && c->level[CACHE_L2].num_sets)
+    {
+        APEX_CacheLine *entry = cache_lookup(c, CACHE_L2, line);
+
+        if (entry)
+        {
+            cache_touch(c, CACHE_L2, entry);
+            return entry->ready > now + l2_latency ? entry->ready : now + l2_latency;
+        }
+        ready = memory_read(cpu, line, now + l2_latency, TRUE);
+        if (ready >= 0)
+        {
+            cache_fill(cpu, CACHE_L2, line, ready);
+        }
+        return ready;
+    }
+    return memory_read(cpu, line, now, TRUE);
+}
+
+/*
+ * Issues a prefetch of line into the level the prefetcher is attached to,
+ * unless that level already holds it.
+ *
+ * Returns TRUE if the prefetch was issued.
+ */
+int
+APEX_cache_prefetch(APEX_CPU *cpu, int line, int now)
+{
+    APEX_Caches *c = &cpu->caches;
+    int level = cpu->config.prefetch_level;
+    int ready;
+
+    if (line < 0 || cache_lookup(c, level, line))
+    {
+        return FALSE;
+    }
+    ready = APEX_cache_fetch_time(cpu, level, line, now);
+    if (ready < 0)
+    {
+        return FALSE;
+    }
+    cache_fill(cpu, level, line, ready)->prefetched = TRUE;
+    c->prefetch.issued++;
+    return TRUE;
+}
+
+/*
+ * Counts a demand access finding the prefetched line it needs still in
+ * flight, done being the cycle it would have completed otherwise
+ */
+static void
+prefetch_late(APEX_Prefetcher *pf, int ready, int done)
+{
+    pf->late++;
+    if (ready == CACHE_PENDING)
+    {
+        pf->late_from = done;
+        return;
+    }
+    pf->late_cycles += ready - done;
+}
+
+/*
+ * Marks entry written by a store to addr that would complete at cycle
+ * done; in the L1D of a core, a line other cores may hold must first be
+ * upgraded. Returns the cycle the store completes.
+ */
+static int
+line_write(APEX_CPU *cpu, APEX_CacheLine *entry, int addr, int done)
+{
+    entry->dirty = TRUE;
+    if (entry->shared)
+    {
+        entry->shared = FALSE;
+        return APEX_multicore_upgrade(cpu, addr, entry->line, done);
+    }
+    return done;
+}
+
+/*
+ * Demand access of line at level starting at cycle now. Returns the cycle
+ * the data is available, or CACHE_PENDING while it waits for DRAM.
+ */
+static int
+level_access(APEX_CPU *cpu, int level, int pc, int addr, int line, int now,
+             int is_store)
+{
+    APEX_Caches *c = &cpu->caches;
+    APEX_Cache *cache = &c->level[level];
+    APEX_Prefetcher *pf = &c->prefetch;
+    int done = now + cpu->config.cache_latency[level];
+    int attached = cpu->config.prefetch != PREFETCH_NONE
+                   && cpu->config.prefetch_level == level;
+    APEX_CacheLine *entry = cache_lookup(c, level, line);
+    int ready;
+
+    cache->accesses++;
+    if (entry)
+    {
+        int first_use = entry->prefetched;
+
+        if (first_use)
+        {
+            pf->useful++;
+            if (entry->ready > done)
+            {
+                prefetch_late(pf, entry->ready, done);
+            }
+            entry->prefetched = FALSE;
+        }
+        if (entry->ready > done)
+        {
+            done = entry->ready;
+        }
+        if (is_store)
+        {
+            done = line_write(cpu, entry, addr, done);
+        }
+        cache_touch(c, level, entry);
+        if (attached)
+        {
+            APEX_prefetch_access(cpu, pc, addr, FALSE, first_use, now);
+        }
+        return done;
+    }
+
+    /* A line waiting outside the cache, in a stream buffer */
+    if (attached && APEX_prefetch_lookup(cpu, line, now, &ready))
+    {
+        if (ready > done)
+        {
+            prefetch_late(pf, ready, done);
+            done = ready;
+        }
+        entry = cache_fill(cpu, level, line, done);
+        return is_store ? line_write(cpu, entry, addr, done) : done;
+    }
+
+    cache->misses++;
+    if (level == CACHE_L1D && c->level[CACHE_L2].num_sets)
+    {
+        done = level_access(cpu, CACHE_L2, pc, addr, line, done, FALSE);
+    }
+    else if (cpu->core)
+    {
+        /* A store asks the other cores to give the line up */
+        c->mem_reads++;
+        done = APEX_multicore_miss(cpu, addr, line, done, is_store, FALSE);
+    }
+    else
+    {
+        done = memory_read(cpu, line, done, FALSE);
+    }
+    entry = cache_fill(cpu, level, line, done);
+    entry->dirty = is_store;
+    entry->shared &= !is_store;
+    if (attached)
+    {
+        APEX_prefetch_access(cpu, pc, addr, TRUE, FALSE, now);
+    }
+    return done;
+}
+
+/*
+ * Looks the data word addr up in the hierarchy for the load or store at pc
+ * that reaches memory in the current cycle.
+ *
+ * Returns the cycle the access completes, one past the current one for an
+ * L1D hit with the default latency, or CACHE_PENDING if it waits for a
+ * DRAM read; APEX_cache_poll tells when that one completes.
+ */
+int
+APEX_cache_access(APEX_CPU *cpu, int pc, int addr, int is_store)
+{
+    APEX_Caches *c = &cpu->caches;
+    int line, done;
+
+    if (!c->ready)
+    {
+        APEX_cache_init(cpu);
+    }
+    if (cpu->config.memory == MEMORY_DRAM)
+    {
+        APEX_dram_advance(cpu, cpu->clock);
+    }
+    line = addr >> c->line_shift;
+    done = level_access(cpu, CACHE_L1D, pc, addr, line, cpu->clock, is_store);
+    if (done == CACHE_PENDING)
+    {
+        APEX_dram_demand(cpu, line);
+    }
+    return done;
+}
+
+/*
+ * Returns the cycle the access waiting for DRAM completes, CACHE_PENDING
+ * while its read is not scheduled yet.
+ */
+int
+APEX_cache_poll(APEX_CPU *cpu)
+{
+    APEX_Prefetcher *pf = &cpu->caches.prefetch;
+    int done;
+
+    APEX_dram_advance(cpu, cpu->clock);
+    done = cpu->caches.dram.demand_done;
+    if (done != CACHE_PENDING && pf->late_from)
+    {
+        pf->late_cycles += done - pf->late_from;
+        pf->late_from = 0;
+    }
+    return done;
+}
+
+/* Called by DRAM when the read of line is scheduled to complete at done */
+void
+APEX_cache_resolve(APEX_CPU *cpu, int line, int done)
+{
+    APEX_Caches *c = &cpu->caches;
+
+    for (int level = 0; level < CACHE_LEVELS; ++level)
+    {
+        APEX_CacheLine *entry = c->level[level].num_sets ? cache_lookup(c, level, line) : NULL;
+
+        if (entry && entry->ready == CACHE_PENDING)
+        {
+            entry->ready = done;
+        }
+    }
+    for (int i = 0; i < PREFETCH_STREAMS; ++i)
+    {
+        APEX_StreamBuffer *buf = &c->prefetch.stream[i];
+
+        for (int j = 0; j < buf->num; ++j)
+        {
+            if (buf->line[j] == line && buf->ready[j] == CACHE_PENDING)
+            {
+                buf->ready[j] = done;
+            }
+        }
+    }
+}
+
+/* Returns the entry of level holding line, NULL if there is none */
+APEX_CacheLine *
+APEX_cache_find(APEX_CPU *cpu, int level, int line)
+{
+    APEX_Caches *c = &cpu->caches;
+
+    return c->level[level].num_sets ? cache_lookup(c, level, line) : NULL;
+}
+
+/*
+ * Returns the cycle a read of line reaching the shared levels of a
+ * multicore run at cycle arrival would complete, were nothing else in
+ * flight. Only looks at the shared state, which the cores read in parallel
+ * while it does not change.
+ */
+int
+APEX_cache_estimate(APEX_CPU *shared, int line, int arrival)
+{
+    APEX_Caches *c = &shared->caches;
+    int done = arrival;
+
+    if (c->level[CACHE_L2].num_sets)
+    {
+        APEX_CacheLine *entry = cache_lookup(c, CACHE_L2, line);
+
+        done += shared->config.cache_latency[CACHE_L2];
+        if (entry && entry->ready != CACHE_PENDING)
+        {
+            return entry->ready > done ? entry->ready : done;
+        }
+    }
+    if (shared->config.memory == MEMORY_DRAM)
+    {
+        return done + APEX_dram_latency(shared, line);
+    }
+    return done + shared->config.mem_latency;
+}
+
+/*
+ * Carries out on the shared levels a read, prefetch or write back of line
+ * that the L1D of a core sent at cycle now. Requests must come in cycle
+ * order.
+ */
+void
+APEX_cache_shared_access(APEX_CPU *shared, int line, int now, int is_write, int prefetch)
+{
+    shared->clock = now;
+    if (shared->config.memory == MEMORY_DRAM)
+    {
+        APEX_dram_advance(shared, now);
+    }
+    if (is_write)
+    {
+        write_back(shared, CACHE_L1D, line);
+    }
+    else if (prefetch)
+    {
+        APEX_cache_fetch_time(shared, CACHE_L1D, line, now);
+    }
+    else if (shared->caches.level[CACHE_L2].num_sets)
+    {
+        level_access(shared, CACHE_L2, 0, line << shared->caches.line_shift, line, now, FALSE);
+    }
+    else
+    {
+        memory_read(shared, line, now, FALSE);
+    }
+}
+
+static double
+ratio(long long part, long long whole)
+{
+    return whole ? (double)part / whole : 0.0;
+}
+
+/*
+ * Prints the counters of every cache level and of the prefetcher.
+ *
+ * Accuracy is the share of prefetched lines that a demand access used,
+ * coverage the share of would-be misses at the prefetcher's level that it
+ * turned into hits, and late the share of used lines that were still in
+ * flight when needed.
+ */
+void
+APEX_cache_print_stats(const APEX_CPU *cpu)
+{
+    static const char *names[CACHE_LEVELS] = { "L1D", "L2" };
+    const APEX_Caches *c = &cpu->caches;
+    const APEX_Prefetcher *pf = &c->prefetch;
+
+    printf("%-6s %12s %12s %8s %12s\n", "level", "accesses", "misses",
+           "miss%", "writebacks");
+    for (int level = 0; level < CACHE_LEVELS; ++level)
+    {
+        const APEX_Cache *cache = &c->level[level];
+
+        if (!cpu->config.cache_size[level])
+        {
+            continue;
+        }
+        printf("%-6s %12lld %12lld %7.2f%% %12lld\n", names[level],
+               cache->accesses, cache->misses,
+               100.0 * ratio(cache->misses, cache->accesses), cache->writebacks);
+    }
+    printf("memory: %lld line reads, %lld line writes\n", c->mem_reads, c->mem_writes);
+    if (cpu->config.memory == MEMORY_DRAM)
+    {
+        APEX_dram_print_stats(cpu);
+    }
+
+    if (cpu->config.prefetch != PREFETCH_NONE)
+    {
+        long long misses = c->level[cpu->config.prefetch_level].misses;
+
+        printf("prefetch %s at %s: %lld issued, %lld useful, accuracy %.2f%%, "
+               "coverage %.2f%%, late %.2f%% (%lld cycles waited)\n",
+               APEX_config_prefetch_name(cpu->config.prefetch),
+               names[cpu->config.prefetch_level], pf->issued, pf->useful,
+               100.0 * ratio(pf->useful, pf->issued),
+               100.0 * ratio(pf->useful, pf->useful + misses),
+               100.0 * ratio(pf->late, pf->useful), pf->late_cycles);
+    }
+}
+
+/*
+ * Runs the program until HALT retires or the given number of cycles
+ * elapse, then reports the time spent waiting on data memory and the
+ * counters of the cache hierarchy.
+ */
+void
+APEX_cache_run(APEX_CPU *cpu, const char *cycles)
+{
+    int max_cycles = cycles ? atoi(cycles) : 0;
+
+    if (!cpu->config.cache_size[CACHE_L1D])
+    {
+        fprintf(stderr, "APEX_Error: cache_stats needs an l1d_size\n");
+        return;
+    }
+    while (!APEX_cpu_cycle(cpu))
+    {
+        if (max_cycles > 0 && cpu->clock == max_cycles)
+        {
+            break;
+        }
+    }
+
+    printf("cycles %d, instructions %d, CPI %.3f, memory stall cycles %d (%.2f%%)\n",
+           cpu->clock, cpu->insn_completed,
+           cpu->insn_completed ? (double)cpu->clock / cpu->insn_completed : 0.0,
+           cpu->mem_stall_cycles, 100.0 * ratio(cpu->mem_stall_cycles, cpu->clock));
+    APEX_cache_print_stats(cpu);
+}
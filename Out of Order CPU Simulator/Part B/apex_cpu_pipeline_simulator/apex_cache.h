@@ -0,0 +1,22 @@
+/*
+ * apex_cache.h
+ * Contains declarations of the timing model of the data cache hierarchy
+ * between the memory stage and data memory
+ */
+#ifndef _APEX_CACHE_H_
+#define _APEX_CACHE_H_
+
+#include "apex_cpu.h"
+
+void APEX_cache_init(APEX_CPU *cpu);
+int APEX_cache_access(APEX_CPU *cpu, int pc, int addr, int is_store);
+int APEX_cache_poll(APEX_CPU *cpu);
+void APEX_cache_resolve(APEX_CPU *cpu, int line, int done);
+int APEX_cache_prefetch(APEX_CPU *cpu, int line, int now);
+int APEX_cache_fetch_time(APEX_CPU *cpu, int level, int line, int now);
+APEX_CacheLine *APEX_cache_find(APEX_CPU *cpu, int level, int line);
+int APEX_cache_estimate(APEX_CPU *shared, int line, int arrival);
+void APEX_cache_shared_access(APEX_CPU *shared, int line, int now, int is_write, int prefetch);
+void APEX_cache_print_stats(const APEX_CPU *cpu);
+void APEX_cache_run(APEX_CPU *cpu, const char *cycles);
+#endif
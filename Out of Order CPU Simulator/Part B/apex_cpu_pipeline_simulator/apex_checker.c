@@ -0,0 +1,250 @@
+/*
+ * apex_checker.c
+ * Lockstep co-simulation of the pipeline against the functional engine
+ *
+ * A private copy of the initial state is stepped with APEX_func_step every
+ * time the pipeline retires an instruction, and the architectural effects
+ * of both are compared. The functional engine only runs once per retired
+ * instruction, so the checker costs a fraction of the pipeline itself.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_checker.h"
+#include "apex_cpu.h"
+#include "apex_func.h"
+#include "apex_macros.h"
+#include "apex_mem.h"
+
+/*
+ * Builds the retirement record of the instruction held in a pipeline latch,
+ * the same way APEX_memory and APEX_writeback commit it
+ */
+void
+APEX_checker_from_stage(const CPU_Stage *stage, APEX_Retire *rec)
+{
+    rec->pc = stage->pc;
+    rec->opcode = stage->opcode;
+    rec->rd = -1;
+    rec->rd1 = -1;
+    rec->mem_addr = -1;
+    rec->mem_read = -1;
+    rec->zero_flag = stage->zero_flag;
+    rec->positive_flag = stage->positive_flag;
+
+    switch (stage->opcode)
+    {
+        case OPCODE_ADD:
+        case OPCODE_SUB:
+        case OPCODE_MUL:
+        case OPCODE_DIV:
+        case OPCODE_AND:
+        case OPCODE_OR:
+        case OPCODE_XOR:
+        case OPCODE_MOVC:
+        case OPCODE_ADDL:
+        case OPCODE_SUBL:
+        {
+            rec->rd = stage->rd;
+            rec->rd_value = stage->result_buffer;
+            break;
+        }
+
+        case OPCODE_LOAD:
+        {
+            rec->rd = stage->rd;
+            rec->rd_value = stage->result_buffer;
+            rec->mem_read = stage->memory_address;
+            break;
+        }
+
+        case OPCODE_LDI:
+        {
+            rec->mem_read = stage->memory_address;
+            rec->rd = stage->rd;
+            rec->rd_value = stage->result_buffer;
+            rec->rd1 = stage->rs1;
+            rec->rd1_value = stage->result_buffer1;
+            break;
+        }
+
+        case OPCODE_STORE:
+        {
+            rec->mem_addr = stage->memory_address;
+            rec->mem_value = stage->rs1_value;
+            break;
+        }
+
+        case OPCODE_STI:
+        {
+            rec->mem_addr = stage->memory_address;
+            rec->mem_value = stage->rs1_value;
+            rec->rd = stage->rs2;
+            rec->rd_value = stage->result_buffer;
+            break;
+        }
+
+        case OPCODE_LL:
+        {
+            rec->rd = stage->rd;
+            rec->rd_value = stage->result_buffer;
+            rec->mem_read = stage->memory_address;
+            break;
+        }
+
+        case OPCODE_SC:
+        {
+            rec->rd = stage->rd;
+            rec->rd_value = stage->result_buffer;
+            rec->mem_read = stage->memory_address;
+            if (stage->result_buffer)
+            {
+                rec->mem_addr = stage->memory_address;
+                rec->mem_value = stage->rs1_value;
+            }
+            break;
+        }
+
+        case OPCODE_FAA:
+        {
+            rec->rd = stage->rd;
+            rec->rd_value = stage->result_buffer;
+            rec->mem_read = stage->memory_address;
+            rec->mem_addr = stage->memory_address;
+            rec->mem_value = stage->result_buffer1;
+            break;
+        }
+    }
+}
+
+/* Returns TRUE when two retirement records have the same effects */
+int
+APEX_checker_compare(const APEX_Retire *a, const APEX_Retire *b)
+{
+    return a->pc == b->pc
+           && a->rd == b->rd && (a->rd < 0 || a->rd_value == b->rd_value)
+           && a->rd1 == b->rd1 && (a->rd1 < 0 || a->rd1_value == b->rd1_value)
+           && a->zero_flag == b->zero_flag
+           && a->positive_flag == b->positive_flag
+           && a->mem_addr == b->mem_addr
+           && (a->mem_addr < 0 || a->mem_value == b->mem_value);
+}
+
+/* Turns the record of a fused instruction into that of the branch fused into it */
+static void
+checker_fused_branch(const CPU_Stage *stage, APEX_Retire *rec)
+{
+    rec->pc = stage->fused_pc;
+    rec->opcode = stage->fused_opcode;
+    rec->rd = -1;
+    rec->rd1 = -1;
+    rec->mem_addr = -1;
+    rec->mem_read = -1;
+}
+
+static void
+checker_print(const char *name, const APEX_Retire *rec)
+{
+    printf("  %-10s pc=%d", name, rec->pc);
+    if (rec->rd >= 0)
+    {
+        printf(" R%d=%d", rec->rd, rec->rd_value);
+    }
+    if (rec->rd1 >= 0)
+    {
+        printf(" R%d=%d", rec->rd1, rec->rd1_value);
+    }
+    if (rec->mem_addr >= 0)
+    {
+        printf(" MEM[%d]=%d", rec->mem_addr, rec->mem_value);
+    }
+    printf(" Z=%d P=%d\n", rec->zero_flag, rec->positive_flag);
+}
+
+/*
+ * Runs the pipeline to HALT (or for the given number of cycles) and checks
+ * every retired instruction against the functional engine.
+ *
+ * Returns TRUE when no divergence was found.
+ */
+int
+APEX_checker_run(APEX_CPU *cpu, const char *cycles)
+{
+    APEX_CPU *golden = calloc(1, sizeof(APEX_CPU));
+    int max_cycles = cycles ? atoi(cycles) : 0;
+    int stop = FALSE;
+    int ok = TRUE;
+
+    if (!golden)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate checker state\n");
+        return FALSE;
+    }
+    APEX_cpu_copy(golden, cpu);
+
+    while (!stop && ok)
+    {
+        const CPU_Stage *retired;
+        int num_retired;
+
+        stop = APEX_cpu_cycle(cpu);
+
+        /* A wide pipeline retires a group of instructions per cycle */
+        retired = cpu->config.width > 1 ? cpu->pwriteback_group.slot : &cpu->pwriteback;
+        num_retired = cpu->config.width > 1 ? cpu->pwriteback_group.count : cpu->wp == 1;
+
+        /* The branch of a fused pair retires right behind its instruction */
+        for (int i = 0; i < num_retired && ok; ++i)
+        {
+            for (int part = 0; part <= retired[i].fused && ok; ++part)
+            {
+                APEX_Retire expect, got;
+
+                APEX_func_step(golden, &expect);
+                APEX_checker_from_stage(&retired[i], &got);
+                if (part)
+                {
+                    checker_fused_branch(&retired[i], &got);
+                }
+
+                if (!APEX_checker_compare(&expect, &got))
+                {
+                    printf("APEX_CHECKER: Divergence at cycle %d, instruction %d\n",
+                           cpu->clock, cpu->insn_completed);
+                    checker_print("expected", &expect);
+                    checker_print("pipeline", &got);
+                    APEX_cpu_print_pipeline(cpu);
+                    ok = FALSE;
+                }
+            }
+        }
+
+        if (max_cycles > 0 && cpu->clock == max_cycles)
+        {
+            break;
+        }
+    }
+
+    if (ok && stop && memcmp(golden->regs, cpu->regs, sizeof(cpu->regs)) != 0)
+    {
+        printf("APEX_CHECKER: Register file differs after HALT\n");
+        ok = FALSE;
+    }
+    if (ok && stop && !APEX_mem_equal(&golden->data_memory, &cpu->data_memory))
+    {
+        printf("APEX_CHECKER: Data memory differs after HALT\n");
+        ok = FALSE;
+    }
+
+    if (ok)
+    {
+        printf("APEX_CHECKER: %d instructions match, cycles = %d, CPI = %.3f\n",
+               cpu->insn_completed, cpu->clock,
+               cpu->insn_completed ? (double)cpu->clock / cpu->insn_completed : 0.0);
+    }
+
+    APEX_cpu_release(golden);
+    free(golden);
+    return ok;
+}
@@ -0,0 +1,14 @@
+/*
+ * apex_checker.h
+ * Contains declarations of the lockstep checker which validates the
+ * pipeline against the functional engine
+ */
+#ifndef _APEX_CHECKER_H_
+#define _APEX_CHECKER_H_
+
+#include "apex_cpu.h"
+
+void APEX_checker_from_stage(const CPU_Stage *stage, APEX_Retire *rec);
+int APEX_checker_compare(const APEX_Retire *a, const APEX_Retire *b);
+int APEX_checker_run(APEX_CPU *cpu, const char *cycles);
+#endif
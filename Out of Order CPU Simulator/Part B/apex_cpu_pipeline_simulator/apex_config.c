@@ -0,0 +1,914 @@
+/*
+ * apex_config.c
+ * Contains functions to set up the simulator configuration from key=value
+ * command line options, you can edit this file to add new options
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+static const char *bypass_names[] = { "none", "ex", "mem", "full" };
+static const char *prefetch_names[] = { "none", "next_line", "stride", "stream" };
+static const char *level_names[] = { "l1d", "l2" };
+static const char *memory_names[] = { "flat", "dram" };
+static const char *coherence_names[] = { "mesi", "moesi" };
+static const char *smt_fetch_names[] = { "icount", "round_robin" };
+static const char *switch_names[] = { "off", "on" };
+static const char *frontend_names[] = { "coupled", "decoupled" };
+static const char *indirect_names[] = { "btb", "target_cache" };
+static const char *resolve_names[] = { "decode", "execute", "memory", "writeback" };
+
+/* Options holding one number of the DRAM model */
+static const struct
+{
+    const char *key;
+    size_t offset;
+    int min;
+    int max;
+    int pow2;
+} dram_options[] = {
+    { "dram_channels", offsetof(APEX_Config, dram_channels), 1, DRAM_MAX_CHANNELS, TRUE },
+    { "dram_ranks", offsetof(APEX_Config, dram_ranks), 1, DRAM_MAX_RANKS, TRUE },
+    { "dram_banks", offsetof(APEX_Config, dram_banks), 1, DRAM_MAX_BANKS, TRUE },
+    { "dram_row_size", offsetof(APEX_Config, dram_row_size), 64, 65536, TRUE },
+    { "dram_tcas", offsetof(APEX_Config, dram_tcas), 1, 1000, FALSE },
+    { "dram_trcd", offsetof(APEX_Config, dram_trcd), 1, 1000, FALSE },
+    { "dram_trp", offsetof(APEX_Config, dram_trp), 1, 1000, FALSE },
+    { "dram_tburst", offsetof(APEX_Config, dram_tburst), 1, 1000, FALSE },
+    { "dram_trefi", offsetof(APEX_Config, dram_trefi), 0, 1000000, FALSE },
+    { "dram_trfc", offsetof(APEX_Config, dram_trfc), 1, 10000, FALSE },
+};
+
+/* Opcodes done in execute, with their <name>_latency and <name>_interval
+ * options */
+static const struct
+{
+    const char *name;
+    int opcode;
+} fu_opcodes[] = {
+    { "add", OPCODE_ADD },   { "sub", OPCODE_SUB },   { "mul", OPCODE_MUL },
+    { "div", OPCODE_DIV },   { "and", OPCODE_AND },   { "or", OPCODE_OR },
+    { "exor", OPCODE_XOR },  { "movc", OPCODE_MOVC }, { "addl", OPCODE_ADDL },
+    { "subl", OPCODE_SUBL }, { "cmp", OPCODE_CMP },
+};
+
+#define FU_OPCODES (int)(sizeof(fu_opcodes) / sizeof(fu_opcodes[0]))
+
+/* Conditional branches of the fuse option, by FUSE_* bit */
+static const char *branch_names[FUSE_BRANCHES] = { "bz", "bnz", "bp", "bnp" };
+
+/*
+ * Sets every option to its default, the configuration of the original
+ * forwarding pipeline
+ */
+void
+APEX_config_init(APEX_Config *config)
+{
+    memset(config, 0, sizeof(APEX_Config));
+    config->bypass = BYPASS_FULL;
+    config->cache_line = 64;
+    config->profile_window = 10000;
+    config->cache_ways[CACHE_L1D] = 4;
+    config->cache_ways[CACHE_L2] = 8;
+    config->cache_latency[CACHE_L1D] = 1;
+    config->cache_latency[CACHE_L2] = 10;
+    config->mem_latency = 100;
+    config->memory = MEMORY_DRAM;
+    config->dram_channels = 1;
+    config->dram_ranks = 1;
+    config->dram_banks = 8;
+    config->dram_row_size = 2048;
+    config->dram_tcas = 14;
+    config->dram_trcd = 14;
+    config->dram_trp = 14;
+    config->dram_tburst = 4;
+    config->dram_trefi = 7800;
+    config->dram_trfc = 350;
+    config->prefetch = PREFETCH_NONE;
+    config->prefetch_level = CACHE_L1D;
+    config->prefetch_degree = 4;
+    config->cores = 1;
+    config->quantum = 1000;
+    config->coherence = COHERENCE_MESI;
+    config->interconnect_latency = 4;
+    config->smt_threads = 1;
+    config->smt_fetch = SMT_FETCH_ICOUNT;
+    config->width = 1;
+    config->frontend = FRONTEND_COUPLED;
+    config->ftq_size = 8;
+    config->btb_entries = 512;
+    config->l1i_ways = 2;
+    config->l1i_miss_latency = 20;
+    config->indirect = INDIRECT_BTB;
+    config->itc_entries = 256;
+    config->ras_reg = -1;
+    config->ras_size = 8;
+    config->branch_resolve = RESOLVE_EXECUTE;
+    for (int i = 0; i < OPCODE_COUNT; ++i)
+    {
+        config->fu_latency[i] = 1;
+        config->fu_interval[i] = 1;
+    }
+}
+
+const char *
+APEX_config_bypass_name(int bypass)
+{
+    return bypass_names[bypass & BYPASS_FULL];
+}
+
+const char *
+APEX_config_resolve_name(int stage)
+{
+    return resolve_names[stage];
+}
+
+const char *
+APEX_config_prefetch_name(int prefetch)
+{
+    return prefetch_names[prefetch];
+}
+
+/* Returns the option name of an opcode done in execute, NULL for others */
+const char *
+APEX_config_fu_name(int opcode)
+{
+    for (int i = 0; i < FU_OPCODES; ++i)
+    {
+        if (fu_opcodes[i].opcode == opcode)
+        {
+            return fu_opcodes[i].name;
+        }
+    }
+    return NULL;
+}
+
+/* Returns the fuse option name of the branch of FUSE_* bit 1 << branch */
+const char *
+APEX_config_branch_name(int branch)
+{
+    return branch_names[branch];
+}
+
+/* Writes the options of config as a line of key=value pairs */
+void
+APEX_config_format(const APEX_Config *config, char *buf, int size)
+{
+    int len = snprintf(buf, size, "bypass=%s cache_line=%d",
+                       APEX_config_bypass_name(config->bypass), config->cache_line);
+
+    if (config->cache_size[CACHE_L1D] && len < size)
+    {
+        len += snprintf(buf + len, size - len, " l1d_size=%d l2_size=%d memory=%s",
+                        config->cache_size[CACHE_L1D], config->cache_size[CACHE_L2],
+                        memory_names[config->memory]);
+    }
+    if (config->prefetch != PREFETCH_NONE && len < size)
+    {
+        len += snprintf(buf + len, size - len, " prefetch=%s prefetch_level=%s",
+                        prefetch_names[config->prefetch], level_names[config->prefetch_level]);
+    }
+    if (config->frontend == FRONTEND_DECOUPLED && len < size)
+    {
+        len += snprintf(buf + len, size - len, " frontend=decoupled ftq_size=%d btb_entries=%d",
+                        config->ftq_size, config->btb_entries);
+    }
+    if (config->indirect == INDIRECT_TARGET_CACHE && len < size)
+    {
+        len += snprintf(buf + len, size - len, " indirect=target_cache itc_entries=%d",
+                        config->itc_entries);
+    }
+    if (config->ras_reg >= 0 && len < size)
+    {
+        len += snprintf(buf + len, size - len, " ras_reg=%d ras_size=%d", config->ras_reg,
+                        config->ras_size);
+    }
+    if (config->l1i_size && len < size)
+    {
+        len += snprintf(buf + len, size - len, " l1i_size=%d l1i_ways=%d l1i_miss_latency=%d",
+                        config->l1i_size, config->l1i_ways, config->l1i_miss_latency);
+    }
+    if (config->flag_rename && len < size)
+    {
+        len += snprintf(buf + len, size - len, " flag_rename=on");
+    }
+    if (config->branch_resolve != RESOLVE_EXECUTE && len < size)
+    {
+        len += snprintf(buf + len, size - len, " branch_resolve=%s",
+                        resolve_names[config->branch_resolve]);
+    }
+    for (int i = 0, sep = '='; i < FU_OPCODES && len < size; ++i)
+    {
+        int mask = config->fuse[fu_opcodes[i].opcode];
+
+        for (int b = 0; b < FUSE_BRANCHES && mask && len < size; ++b)
+        {
+            if (mask == FUSE_ANY)
+            {
+                len += snprintf(buf + len, size - len, "%s%c%s", sep == '=' ? " fuse" : "",
+                                sep, fu_opcodes[i].name);
+                sep = ',';
+                break;
+            }
+            if (mask & (1 << b))
+            {
+                len += snprintf(buf + len, size - len, "%s%c%s+%s", sep == '=' ? " fuse" : "",
+                                sep, fu_opcodes[i].name, branch_names[b]);
+                sep = ',';
+            }
+        }
+    }
+    for (int i = 0; i < FU_OPCODES && len < size; ++i)
+    {
+        int op = fu_opcodes[i].opcode;
+
+        if (config->fu_latency[op] > 1 || config->fu_interval[op] > 1)
+        {
+            len += snprintf(buf + len, size - len, " %s_latency=%d %s_interval=%d",
+                            fu_opcodes[i].name, config->fu_latency[op], fu_opcodes[i].name,
+                            config->fu_interval[op]);
+        }
+    }
+}
+
+static int
+parse_bypass(const char *value, int *bypass)
+{
+    for (int i = 0; i <= BYPASS_FULL; ++i)
+    {
+        if (strcmp(value, bypass_names[i]) == 0)
+        {
+            *bypass = i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* Parses a power of two in [min, max] */
+static int
+parse_pow2(const char *value, int min, int max, int *out)
+{
+    char *end;
+    long n = strtol(value, &end, 10);
+
+    if (*value == '\0' || *end != '\0' || n < min || n > max || (n & (n - 1)) != 0)
+    {
+        return FALSE;
+    }
+    *out = (int)n;
+    return TRUE;
+}
+
+/* Parses a whole number in [min, max] */
+static int
+parse_int(const char *value, int min, int max, int *out)
+{
+    char *end;
+    long n = strtol(value, &end, 10);
+
+    if (*value == '\0' || *end != '\0' || n < min || n > max)
+    {
+        return FALSE;
+    }
+    *out = (int)n;
+    return TRUE;
+}
+
+/* Looks value up in a table of names, storing its index */
+static int
+parse_name(const char *value, const char *const *names, int num_names, int *out)
+{
+    for (int i = 0; i < num_names; ++i)
+    {
+        if (strcmp(value, names[i]) == 0)
+        {
+            *out = i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * Parses the fuse option: none, or a comma separated list of <op>+<branch>
+ * pairs, <op> alone standing for it with every conditional branch. Only
+ * single-cycle opcodes setting the flags fuse.
+ */
+static int
+parse_fuse(const char *value, int *fuse)
+{
+    char list[256];
+    char *save;
+
+    memset(fuse, 0, OPCODE_COUNT * sizeof(int));
+    if (strcmp(value, "none") == 0)
+    {
+        return TRUE;
+    }
+    if (strlen(value) >= sizeof(list))
+    {
+        return FALSE;
+    }
+    strcpy(list, value);
+    for (char *pair = strtok_r(list, ",", &save); pair; pair = strtok_r(NULL, ",", &save))
+    {
+        char *branch = strchr(pair, '+');
+        int op = -1;
+        int mask = FUSE_ANY;
+
+        if (branch)
+        {
+            *branch++ = '\0';
+            if (!parse_name(branch, branch_names, FUSE_BRANCHES, &mask))
+            {
+                return FALSE;
+            }
+            mask = 1 << mask;
+        }
+        for (int i = 0; i < FU_OPCODES; ++i)
+        {
+            if (strcmp(pair, fu_opcodes[i].name) == 0)
+            {
+                op = fu_opcodes[i].opcode;
+            }
+        }
+        if (op < 0 || op == OPCODE_MUL || op == OPCODE_DIV || op == OPCODE_MOVC)
+        {
+            return FALSE;
+        }
+        fuse[op] |= mask;
+    }
+    return TRUE;
+}
+
+static int
+option_key(const char *option, const char *key)
+{
+    size_t len = strlen(key);
+
+    return strncmp(option, key, len) == 0 && option[len] == '=';
+}
+
+/* Applies one of the per-level "<level>_size/_ways/_latency" options or
+ * one of the dram_* numbers */
+static int
+set_memory_option(APEX_Config *config, const char *option, const char *value)
+{
+    for (int level = 0; level < CACHE_LEVELS; ++level)
+    {
+        char key[32];
+
+        snprintf(key, sizeof(key), "%s_size", level_names[level]);
+        if (option_key(option, key))
+        {
+            if (strcmp(value, "0") == 0
+                || parse_pow2(value, 64, 1 << 24, &config->cache_size[level]))
+            {
+                config->cache_size[level] = atoi(value);
+                return TRUE;
+            }
+            fprintf(stderr, "APEX_Error: %s must be 0 or a power of two from 64 to %d\n",
+                    key, 1 << 24);
+            return FALSE;
+        }
+
+        snprintf(key, sizeof(key), "%s_ways", level_names[level]);
+        if (option_key(option, key))
+        {
+            if (parse_pow2(value, 1, 64, &config->cache_ways[level]))
+            {
+                return TRUE;
+            }
+            fprintf(stderr, "APEX_Error: %s must be a power of two from 1 to 64\n", key);
+            return FALSE;
+        }
+
+        snprintf(key, sizeof(key), "%s_latency", level_names[level]);
+        if (option_key(option, key))
+        {
+            if (parse_int(value, 1, 1000, &config->cache_latency[level]))
+            {
+                return TRUE;
+            }
+            fprintf(stderr, "APEX_Error: %s must be from 1 to 1000 cycles\n", key);
+            return FALSE;
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(dram_options) / sizeof(dram_options[0]); ++i)
+    {
+        int *field = (int *)((char *)config + dram_options[i].offset);
+
+        if (!option_key(option, dram_options[i].key))
+        {
+            continue;
+        }
+        if (dram_options[i].pow2
+                ? parse_pow2(value, dram_options[i].min, dram_options[i].max, field)
+                : parse_int(value, dram_options[i].min, dram_options[i].max, field))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: %s must be %sfrom %d to %d\n", dram_options[i].key,
+                dram_options[i].pow2 ? "a power of two " : "", dram_options[i].min,
+                dram_options[i].max);
+        return FALSE;
+    }
+
+    fprintf(stderr, "APEX_Error: Unknown option '%s'\n", option);
+    return FALSE;
+}
+
+/*
+ * Applies one "key=value" option.
+ *
+ * Returns FALSE, after printing why, for unknown keys or bad values.
+ */
+int
+APEX_config_set(APEX_Config *config, const char *option)
+{
+    const char *value = strchr(option, '=');
+
+    if (!value)
+    {
+        fprintf(stderr, "APEX_Error: Option '%s' is not key=value\n", option);
+        return FALSE;
+    }
+    value++;
+
+    if (option_key(option, "bypass"))
+    {
+        if (parse_bypass(value, &config->bypass))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: bypass must be none, ex, mem or full\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "cache_line"))
+    {
+        if (parse_pow2(value, 4, 4096, &config->cache_line))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: cache_line must be a power of two from 4 to 4096\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "mem_latency"))
+    {
+        if (parse_int(value, 1, 10000, &config->mem_latency))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: mem_latency must be from 1 to 10000 cycles\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "memory"))
+    {
+        if (parse_name(value, memory_names, 2, &config->memory))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: memory must be flat or dram\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "prefetch"))
+    {
+        if (parse_name(value, prefetch_names, 4, &config->prefetch))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: prefetch must be none, next_line, stride or stream\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "prefetch_level"))
+    {
+        if (parse_name(value, level_names, CACHE_LEVELS, &config->prefetch_level))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: prefetch_level must be l1d or l2\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "prefetch_degree"))
+    {
+        if (parse_int(value, 1, PREFETCH_MAX_DEGREE, &config->prefetch_degree))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: prefetch_degree must be from 1 to %d\n",
+                PREFETCH_MAX_DEGREE);
+        return FALSE;
+    }
+
+    if (option_key(option, "cores"))
+    {
+        if (parse_int(value, 1, MULTICORE_MAX_CORES, &config->cores))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: cores must be from 1 to %d\n", MULTICORE_MAX_CORES);
+        return FALSE;
+    }
+
+    if (option_key(option, "quantum"))
+    {
+        if (parse_int(value, 1, 1000000, &config->quantum))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: quantum must be from 1 to 1000000 cycles\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "coherence"))
+    {
+        if (parse_name(value, coherence_names, 2, &config->coherence))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: coherence must be mesi or moesi\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "interconnect_latency"))
+    {
+        if (parse_int(value, 0, 1000, &config->interconnect_latency))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: interconnect_latency must be from 0 to 1000 cycles\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "width"))
+    {
+        if (parse_int(value, 1, SUPERSCALAR_MAX_WIDTH, &config->width))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: width must be from 1 to %d\n", SUPERSCALAR_MAX_WIDTH);
+        return FALSE;
+    }
+
+    if (option_key(option, "pairing"))
+    {
+        if (parse_name(value, switch_names, 2, &config->pairing))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: pairing must be off or on\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "flag_rename"))
+    {
+        if (parse_name(value, switch_names, 2, &config->flag_rename))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: flag_rename must be off or on\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "branch_resolve"))
+    {
+        if (parse_name(value, resolve_names, RESOLVE_STAGES, &config->branch_resolve))
+        {
+            return TRUE;
+        }
+        fprintf(stderr,
+                "APEX_Error: branch_resolve must be decode, execute, memory or writeback\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "fuse"))
+    {
+        if (parse_fuse(value, config->fuse))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: fuse must be none or a list of <op>[+<branch>] with op "
+                        "add, sub, and, or, exor, addl, subl or cmp and branch bz, bnz, bp "
+                        "or bnp\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "frontend"))
+    {
+        if (parse_name(value, frontend_names, 2, &config->frontend))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: frontend must be coupled or decoupled\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "ftq_size"))
+    {
+        if (parse_int(value, 1, FRONTEND_FTQ_MAX, &config->ftq_size))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: ftq_size must be from 1 to %d\n", FRONTEND_FTQ_MAX);
+        return FALSE;
+    }
+
+    if (option_key(option, "btb_entries"))
+    {
+        if (parse_pow2(value, 1, FRONTEND_BTB_MAX, &config->btb_entries))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: btb_entries must be a power of two from 1 to %d\n",
+                FRONTEND_BTB_MAX);
+        return FALSE;
+    }
+
+    if (option_key(option, "indirect"))
+    {
+        if (parse_name(value, indirect_names, 2, &config->indirect))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: indirect must be btb or target_cache\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "itc_entries"))
+    {
+        if (parse_pow2(value, 1, FRONTEND_ITC_MAX, &config->itc_entries))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: itc_entries must be a power of two from 1 to %d\n",
+                FRONTEND_ITC_MAX);
+        return FALSE;
+    }
+
+    if (option_key(option, "ras_reg"))
+    {
+        if (strcmp(value, "none") == 0)
+        {
+            config->ras_reg = -1;
+            return TRUE;
+        }
+        if (parse_int(value, 0, REG_FILE_SIZE - 1, &config->ras_reg))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: ras_reg must be none or a register from 0 to %d\n",
+                REG_FILE_SIZE - 1);
+        return FALSE;
+    }
+
+    if (option_key(option, "ras_size"))
+    {
+        if (parse_int(value, 1, FRONTEND_RAS_MAX, &config->ras_size))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: ras_size must be from 1 to %d\n", FRONTEND_RAS_MAX);
+        return FALSE;
+    }
+
+    if (option_key(option, "l1i_size"))
+    {
+        if (strcmp(value, "0") == 0 || parse_pow2(value, 64, 1 << 24, &config->l1i_size))
+        {
+            config->l1i_size = atoi(value);
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: l1i_size must be 0 or a power of two from 64 to %d\n",
+                1 << 24);
+        return FALSE;
+    }
+
+    if (option_key(option, "l1i_ways"))
+    {
+        if (parse_pow2(value, 1, 64, &config->l1i_ways))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: l1i_ways must be a power of two from 1 to 64\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "l1i_miss_latency"))
+    {
+        if (parse_int(value, 1, 1000, &config->l1i_miss_latency))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: l1i_miss_latency must be from 1 to 1000 cycles\n");
+        return FALSE;
+    }
+
+    if (option_key(option, "smt_threads"))
+    {
+        if (parse_int(value, 1, SMT_MAX_THREADS, &config->smt_threads))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: smt_threads must be from 1 to %d\n", SMT_MAX_THREADS);
+        return FALSE;
+    }
+
+    if (option_key(option, "smt_fetch"))
+    {
+        if (parse_name(value, smt_fetch_names, 2, &config->smt_fetch))
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: smt_fetch must be icount or round_robin\n");
+        return FALSE;
+    }
+
+    for (int i = 0; i < FU_OPCODES; ++i)
+    {
+        char key[32];
+        int op = fu_opcodes[i].opcode;
+
+        snprintf(key, sizeof(key), "%s_latency", fu_opcodes[i].name);
+        if (option_key(option, key))
+        {
+            if (parse_int(value, 1, FU_MAX_LATENCY, &config->fu_latency[op]))
+            {
+                return TRUE;
+            }
+            fprintf(stderr, "APEX_Error: %s must be from 1 to %d cycles\n", key,
+                    FU_MAX_LATENCY);
+            return FALSE;
+        }
+
+        snprintf(key, sizeof(key), "%s_interval", fu_opcodes[i].name);
+        if (option_key(option, key))
+        {
+            if (parse_int(value, 1, FU_MAX_LATENCY, &config->fu_interval[op]))
+            {
+                return TRUE;
+            }
+            fprintf(stderr, "APEX_Error: %s must be from 1 to %d cycles\n", key,
+                    FU_MAX_LATENCY);
+            return FALSE;
+        }
+    }
+
+    if (option_key(option, "profile_window"))
+    {
+        config->profile_window = atoi(value);
+        if (config->profile_window > 0)
+        {
+            return TRUE;
+        }
+        fprintf(stderr, "APEX_Error: profile_window must be a positive number of cycles\n");
+        return FALSE;
+    }
+
+    return set_memory_option(config, option, value);
+}
+
+/*
+ * Checks the options that only make sense together, once all of them are
+ * set.
+ *
+ * Returns FALSE, after printing why, for an impossible cache hierarchy.
+ */
+int
+APEX_config_check(const APEX_Config *config)
+{
+    static const int max_lines[CACHE_LEVELS] = { CACHE_L1D_MAX_LINES, CACHE_L2_MAX_LINES };
+
+    for (int level = 0; level < CACHE_LEVELS; ++level)
+    {
+        int lines = config->cache_size[level] / config->cache_line;
+
+        if (!config->cache_size[level])
+        {
+            continue;
+        }
+        if (lines < config->cache_ways[level] || lines > max_lines[level])
+        {
+            fprintf(stderr, "APEX_Error: %s_size must hold from %s_ways to %d lines of %d bytes\n",
+                    level_names[level], level_names[level], max_lines[level],
+                    config->cache_line);
+            return FALSE;
+        }
+    }
+    if (config->l1i_size && (config->l1i_size / config->cache_line < config->l1i_ways
+                             || config->l1i_size / config->cache_line > CACHE_L1I_MAX_LINES))
+    {
+        fprintf(stderr, "APEX_Error: l1i_size must hold from l1i_ways to %d lines of %d bytes\n",
+                CACHE_L1I_MAX_LINES, config->cache_line);
+        return FALSE;
+    }
+    if ((config->indirect != INDIRECT_BTB || config->ras_reg >= 0)
+        && config->frontend != FRONTEND_DECOUPLED)
+    {
+        fprintf(stderr, "APEX_Error: indirect and ras_reg need frontend=decoupled\n");
+        return FALSE;
+    }
+    if (config->cache_size[CACHE_L2] && !config->cache_size[CACHE_L1D])
+    {
+        fprintf(stderr, "APEX_Error: l2_size needs an l1d_size\n");
+        return FALSE;
+    }
+    if (config->prefetch != PREFETCH_NONE && !config->cache_size[config->prefetch_level])
+    {
+        fprintf(stderr, "APEX_Error: prefetch needs a cache at prefetch_level=%s\n",
+                level_names[config->prefetch_level]);
+        return FALSE;
+    }
+    if (config->cores > 1 && config->prefetch != PREFETCH_NONE
+        && config->prefetch_level == CACHE_L2)
+    {
+        fprintf(stderr, "APEX_Error: the shared l2 of several cores cannot have a prefetcher\n");
+        return FALSE;
+    }
+    if (config->pairing && config->width == 1)
+    {
+        fprintf(stderr, "APEX_Error: pairing needs a width above 1\n");
+        return FALSE;
+    }
+    if (config->width > 1 && (config->cores > 1 || config->smt_threads > 1))
+    {
+        fprintf(stderr, "APEX_Error: width above 1 needs a single core and thread\n");
+        return FALSE;
+    }
+    if (config->cores > 1 && config->smt_threads > 1)
+    {
+        fprintf(stderr, "APEX_Error: cores and smt_threads cannot both be above 1\n");
+        return FALSE;
+    }
+    for (int i = 0; i < FU_OPCODES; ++i)
+    {
+        int op = fu_opcodes[i].opcode;
+
+        if (config->fu_interval[op] > config->fu_latency[op])
+        {
+            fprintf(stderr, "APEX_Error: %s_interval cannot be longer than %s_latency\n",
+                    fu_opcodes[i].name, fu_opcodes[i].name);
+            return FALSE;
+        }
+    }
+    if (config->dram_row_size < config->cache_line)
+    {
+        fprintf(stderr, "APEX_Error: dram_row_size must hold at least one cache_line\n");
+        return FALSE;
+    }
+    if (config->dram_trefi && config->dram_trefi <= config->dram_trfc)
+    {
+        fprintf(stderr, "APEX_Error: dram_trefi must be 0 or longer than dram_trfc\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Returns the configuration an option applies to and moves *option past its
+ * prefix: "b.<key>=<value>" selects configuration 1, "c<n>.<key>=<value>"
+ * configuration n and plain options configuration 0. Returns -1 for an out
+ * of range n.
+ */
+int
+APEX_config_target(const char **option)
+{
+    const char *s = *option;
+    char *end;
+    long n;
+
+    if (strncmp(s, "b.", 2) == 0)
+    {
+        *option = s + 2;
+        return 1;
+    }
+    if (s[0] != 'c' || s[1] < '0' || s[1] > '9')
+    {
+        return 0;
+    }
+
+    n = strtol(s + 1, &end, 10);
+    if (*end != '.')
+    {
+        return 0;
+    }
+    if (n >= APEX_MAX_CONFIGS)
+    {
+        fprintf(stderr, "APEX_Error: Configuration index in '%s' is over %d\n",
+                s, APEX_MAX_CONFIGS - 1);
+        return -1;
+    }
+    *option = end + 1;
+    return (int)n;
+}
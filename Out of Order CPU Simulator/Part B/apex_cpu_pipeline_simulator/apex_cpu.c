@@ -10,8 +10,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "apex_cache.h"
 #include "apex_cpu.h"
+#include "apex_frontend.h"
 #include "apex_macros.h"
+#include "apex_mem.h"
+#include "apex_multicore.h"
+#include "apex_table.h"
+#include "apex_trace.h"
 
 /* Converts the PC(4000 series) into array index for code memory
  *
@@ -23,6 +29,50 @@ get_code_memory_index_from_pc(const int pc)
     return (pc - 4000) / 4;
 }
 
+/* FUSE_* bit of a conditional branch, 0 for other opcodes */
+static int
+fuse_bit(int opcode)
+{
+    switch (opcode)
+    {
+        case OPCODE_BZ:
+        {
+            return FUSE_BZ;
+        }
+
+        case OPCODE_BNZ:
+        {
+            return FUSE_BNZ;
+        }
+
+        case OPCODE_BP:
+        {
+            return FUSE_BP;
+        }
+
+        case OPCODE_BNP:
+        {
+            return FUSE_BNP;
+        }
+    }
+    return 0;
+}
+
+/* Index of the FUSE_* bit of a conditional branch */
+static int
+fuse_branch(int opcode)
+{
+    int bit = fuse_bit(opcode);
+    int branch = 0;
+
+    while (bit > 1)
+    {
+        bit >>= 1;
+        branch++;
+    }
+    return branch;
+}
+
 static void
 print_instruction(const CPU_Stage *stage)
 {
@@ -51,12 +101,21 @@ print_instruction(const CPU_Stage *stage)
         case OPCODE_SUBL:
         case OPCODE_LDI:
         case OPCODE_LOAD:
+        case OPCODE_LL:
         {
             printf("%s,R%d,R%d,#%d ", stage->opcode_str, stage->rd, stage->rs1,
                    stage->imm);
             break;
         }
 
+        case OPCODE_SC:
+        case OPCODE_FAA:
+        {
+            printf("%s,R%d,R%d,R%d,#%d ", stage->opcode_str, stage->rd, stage->rs1,
+                   stage->rs2, stage->imm);
+            break;
+        }
+
         case OPCODE_STI:
         case OPCODE_STORE:
         {
@@ -76,6 +135,7 @@ print_instruction(const CPU_Stage *stage)
 
         case OPCODE_NOP:
         case OPCODE_HALT:
+        case OPCODE_FENCE:
         {
             printf("%s", stage->opcode_str);
             break;
@@ -103,11 +163,31 @@ print_instruction(const CPU_Stage *stage)
 static void
 print_stage_content(const char *name, const CPU_Stage *stage)
 {
+    static const char *branch_names[FUSE_BRANCHES] = { "BZ", "BNZ", "BP", "BNP" };
+
     printf("%-15s (I%d: %d) ", name, (stage->pc-4000)/4, stage->pc);
     print_instruction(stage);
+    if (stage->fused)
+    {
+        printf("+ %s,#%d ", branch_names[fuse_branch(stage->fused_opcode)], stage->fused_imm);
+    }
     printf("\n");
 }
 
+/* Debug function which prints every instruction of a wide pipeline stage */
+static void
+print_group(const char *name, const CPU_Group *group)
+{
+    if (!group->count)
+    {
+        printf("%s EMPTY\n", name);
+    }
+    for (int i = 0; i < group->count; ++i)
+    {
+        print_stage_content(name, &group->slot[i]);
+    }
+}
+
 /* Debug function which prints the register file
  *
  * Note: You are not supposed to edit this function
@@ -126,6 +206,66 @@ print_reg_file(const APEX_CPU *cpu)
 
 }
 
+/*
+ * In trace mode fetch follows the recorded path: the next record is
+ * consumed when it belongs to the pc being fetched. Any other pc lies on the
+ * wrong path behind a taken branch, which flushes it when it resolves.
+ */
+static void
+trace_fetch(APEX_CPU *cpu)
+{
+    const APEX_TraceRecord *rec = &cpu->trace[cpu->trace_pos & cpu->trace_mask];
+
+    if (rec->pc == cpu->pc)
+    {
+        cpu->fetch.trace_index = cpu->trace_pos++;
+        cpu->fetch.trace_info = rec->info;
+    }
+    else
+    {
+        cpu->fetch.trace_index = -1;
+    }
+}
+
+/* Opcodes given a latency or interval above 1 run on a unit of their own */
+static int
+fu_own_unit(const APEX_CPU *cpu, int opcode)
+{
+    return cpu->config.fu_latency[opcode] > 1 || cpu->config.fu_interval[opcode] > 1;
+}
+
+/*
+ * Fuses the conditional branch following the instruction just fetched into
+ * it when config.fuse has the pair, so that decode takes both as a single
+ * micro-op. An opcode on a unit of its own does not fuse, the branch could
+ * not resolve with it.
+ */
+static void
+fuse_next(APEX_CPU *cpu)
+{
+    int index = get_code_memory_index_from_pc(cpu->pc);
+    const APEX_Instruction *next;
+
+    cpu->fetch.fused = FALSE;
+    if (!cpu->config.fuse[cpu->fetch.opcode] || cpu->trace || index >= cpu->code_memory_size
+        || fu_own_unit(cpu, cpu->fetch.opcode) || cpu->pc != cpu->fetch.pc + 4
+        || !APEX_frontend_ready(cpu))
+    {
+        return;
+    }
+    next = &cpu->code_memory[index];
+    if (!(cpu->config.fuse[cpu->fetch.opcode] & fuse_bit(next->opcode)))
+    {
+        return;
+    }
+    cpu->fetch.fused = TRUE;
+    cpu->fetch.fused_pc = cpu->pc;
+    cpu->fetch.fused_opcode = next->opcode;
+    cpu->fetch.fused_imm = next->imm;
+    cpu->fetch.pred_pc = APEX_frontend_next(cpu);
+    cpu->pc = cpu->fetch.pred_pc;
+}
+
 /*
  * Fetch Stage of APEX Pipeline
  *
@@ -142,14 +282,41 @@ APEX_fetch(APEX_CPU *cpu)
         if (cpu->fetch_from_next_cycle == TRUE)
         {
             cpu->fetch_from_next_cycle = FALSE;
+            cpu->frontend.redirect_bubbles++;
             //printf("Instruction at FETCH_____STAGE ---> EMPTY\n");
             cpu->fp=0;
             /* Skip this cycle*/
             return;
         }
 
+        /* A branch resolved past execute redirects fetch that much later */
+        if (cpu->clock < cpu->fetch_resume)
+        {
+            cpu->frontend.redirect_bubbles++;
+            cpu->fp=0;
+            return;
+        }
+
+        /* A trace without HALT ends where the program left code memory */
+        if (cpu->trace && cpu->trace_pos == cpu->trace_len
+            && !(cpu->trace_queue && APEX_trace_queue_wait(cpu)))
+        {
+            cpu->fetch.has_insn = FALSE;
+            cpu->fp=0;
+            return;
+        }
+
+        /* The front end has no instruction for fetch this cycle */
+        if ((cpu->config.frontend == FRONTEND_DECOUPLED || cpu->config.l1i_size)
+            && !APEX_frontend_fetch(cpu))
+        {
+            cpu->fp=0;
+            return;
+        }
+
         /* Store current PC in fetch latch */
         cpu->fetch.pc = cpu->pc;
+        cpu->fetch.thread = cpu->thread;
 
         /* Index into code memory using this pc and copy all instruction fields
          * into fetch latch  */
@@ -161,8 +328,16 @@ APEX_fetch(APEX_CPU *cpu)
         cpu->fetch.rs2 = current_ins->rs2;
         cpu->fetch.imm = current_ins->imm;
 
-        /* Update PC for next instruction */
-        cpu->pc += 4;
+        if (cpu->trace)
+        {
+            trace_fetch(cpu);
+        }
+
+        /* Update PC for next instruction, the predicted one with a
+         * decoupled front end */
+        cpu->fetch.pred_pc = APEX_frontend_next(cpu);
+        cpu->pc = cpu->fetch.pred_pc;
+        fuse_next(cpu);
 
         /* Copy data from fetch latch to decode latch*/
         cpu->decode = cpu->fetch;
@@ -184,6 +359,87 @@ APEX_fetch(APEX_CPU *cpu)
     }
 }
 
+/*
+ * read_operand of a wide pipeline: every slot of memory and execute has its
+ * own bypass path, the younger slot winning within a stage
+ */
+static int
+wide_read_operand(APEX_CPU *cpu, int reg)
+{
+    int value = cpu->regs[reg];
+
+    for (int i = 0; i < cpu->mem_slots && (cpu->config.bypass & BYPASS_MEM); ++i)
+    {
+        if (reg == cpu->mem_bypass[i].dest)
+        {
+            value = cpu->mem_bypass[i].value;
+            cpu->regf[reg] = 1;
+        }
+        if (reg == cpu->mem_bypass[i].dest1)
+        {
+            value = cpu->mem_bypass[i].value1;
+            cpu->regf[reg] = 1;
+        }
+    }
+    for (int i = 0; i < cpu->ex_slots && (cpu->config.bypass & BYPASS_EX); ++i)
+    {
+        if (reg == cpu->ex_bypass[i].dest)
+        {
+            value = cpu->ex_bypass[i].value;
+            cpu->regf[reg] = 1;
+        }
+        if (reg == cpu->ex_bypass[i].dest1)
+        {
+            value = cpu->ex_bypass[i].value1;
+            cpu->regf[reg] = 1;
+        }
+    }
+    return value;
+}
+
+/*
+ * Reads a source register in decode. Values produced by the instructions
+ * in memory and execute are taken from the bypass paths enabled in
+ * cpu->config.bypass, the younger producer in execute winning. Whether the
+ * value is actually available this cycle is decided by check_stalling.
+ */
+static int
+read_operand(APEX_CPU *cpu, int reg)
+{
+    int value = cpu->regs[reg];
+
+    if (cpu->config.width > 1)
+    {
+        return wide_read_operand(cpu, reg);
+    }
+
+    if (cpu->config.bypass & BYPASS_MEM)
+    {
+        if(reg==cpu->mem_dest){
+            value=cpu->mem_dest_value;
+            cpu->regf[cpu->mem_dest]=1;
+        }
+        if(reg==cpu->mem_dest1){
+            value=cpu->mem_dest1_value;
+            cpu->regf[cpu->mem_dest1]=1;
+        }
+    }
+
+    if (cpu->config.bypass & BYPASS_EX)
+    {
+        if(reg==cpu->ex_dest){
+            value=cpu->ex_dest_value;
+            cpu->regf[cpu->ex_dest]=1;
+        }
+        if(reg==cpu->ex_dest1){
+            value=cpu->ex_dest1_value;
+            cpu->regf[cpu->ex_dest1]=1;
+        }
+    }
+
+    return value;
+}
+
 /*
  * Decode Stage of APEX Pipeline
  *
@@ -207,50 +463,11 @@ APEX_decode(APEX_CPU *cpu)
             case OPCODE_STORE:
             case OPCODE_STI:
             case OPCODE_CMP:
+            case OPCODE_SC:
+            case OPCODE_FAA:
             {
-                cpu->decode.rs1_value = cpu->regs[cpu->decode.rs1];
-                cpu->decode.rs2_value = cpu->regs[cpu->decode.rs2];
-
-                //comparing sources in decode with destination in memory and storing their values
-
-                if(cpu->decode.rs1==cpu->mem_dest){
-                    cpu->decode.rs1_value=cpu->mem_dest_value;
-                    cpu->regf[cpu->mem_dest]=1;
-                }
-                if(cpu->decode.rs1==cpu->mem_dest1){
-                    cpu->decode.rs1_value=cpu->mem_dest1_value;
-                    cpu->regf[cpu->mem_dest1]=1;
-                }
-                if(cpu->decode.rs2==cpu->mem_dest){
-                    cpu->decode.rs2_value=cpu->mem_dest_value;
-                    cpu->regf[cpu->mem_dest]=1;
-                }
-                if(cpu->decode.rs2==cpu->mem_dest1){
-                    cpu->decode.rs2_value=cpu->mem_dest1_value;
-                    cpu->regf[cpu->mem_dest1]=1;
-                }
-
-                //printf("CMP in DECODE Stage RS1:%d --> EX_Dest:%d",cpu->decode.rs1,cpu->ex_dest);
-
-                //comparing sources in decode with destination in execution and storing their values
-
-                if(cpu->decode.rs1==cpu->ex_dest){
-                    cpu->decode.rs1_value=cpu->ex_dest_value;
-                    cpu->regf[cpu->ex_dest]=1;
-                }
-                if(cpu->decode.rs1==cpu->ex_dest1){
-                    cpu->decode.rs1_value=cpu->ex_dest1_value;
-                    cpu->regf[cpu->ex_dest1]=1;
-                }
-                if(cpu->decode.rs2==cpu->ex_dest){
-                    cpu->decode.rs2_value=cpu->ex_dest_value;
-                    cpu->regf[cpu->ex_dest]=1;
-                }
-                if(cpu->decode.rs2==cpu->ex_dest1){
-                    cpu->decode.rs2_value=cpu->ex_dest1_value;
-                    cpu->regf[cpu->ex_dest1]=1;
-                }
-
+                cpu->decode.rs1_value = read_operand(cpu, cpu->decode.rs1);
+                cpu->decode.rs2_value = read_operand(cpu, cpu->decode.rs2);
                 break;
             }
 
@@ -259,28 +476,9 @@ APEX_decode(APEX_CPU *cpu)
             case OPCODE_SUBL:
             case OPCODE_LDI:
             case OPCODE_JUMP:
+            case OPCODE_LL:
             {
-                cpu->decode.rs1_value = cpu->regs[cpu->decode.rs1];
-
-                if(cpu->decode.rs1==cpu->mem_dest){
-                    cpu->decode.rs1_value=cpu->mem_dest_value;
-                    cpu->regf[cpu->mem_dest]=1;
-                }
-                if(cpu->decode.rs1==cpu->mem_dest1){
-                    cpu->decode.rs1_value=cpu->mem_dest1_value;
-                    cpu->regf[cpu->mem_dest1]=1;
-                }
-
-                if(cpu->decode.rs1==cpu->ex_dest){
-                    cpu->decode.rs1_value=cpu->ex_dest_value;
-                    cpu->regf[cpu->ex_dest]=1;
-
-                }
-                if(cpu->decode.rs1==cpu->ex_dest1){
-                    cpu->decode.rs1_value=cpu->ex_dest1_value;
-                    cpu->regf[cpu->ex_dest1]=1;
-                }
-
+                cpu->decode.rs1_value = read_operand(cpu, cpu->decode.rs1);
                 break;
             }
 
@@ -291,6 +489,7 @@ APEX_decode(APEX_CPU *cpu)
             case OPCODE_BNP:
             case OPCODE_HALT:
             case OPCODE_NOP:
+            case OPCODE_FENCE:
             {
                 /* doesn't have register operands */
                 break;
@@ -322,76 +521,412 @@ APEX_decode(APEX_CPU *cpu)
 }
 
 /*
- * Execute Stage of APEX Pipeline
- *
- * Note: You are free to edit this function according to your implementation
+ * Sends fetch to target after a taken branch or JUMP in execute. Fetch runs
+ * after execute, so the target is only fetched from the next cycle on, and
+ * the instruction fetched behind the branch is flushed from decode unless
+ * it belongs to another SMT thread. The decoupled front end has no block
+ * queued for fetch in the meantime.
  */
 static void
-APEX_execute(APEX_CPU *cpu)
+redirect_fetch(APEX_CPU *cpu, int target)
 {
-    
-    if (cpu->execute.has_insn)
+    cpu->pc = target;
+    if (cpu->config.frontend == FRONTEND_DECOUPLED)
     {
-        /* Execute logic based on instruction type */
-        switch (cpu->execute.opcode)
-        {
-            case OPCODE_ADD:
-            {
-                cpu->execute.result_buffer
-                    = cpu->execute.rs1_value + cpu->execute.rs2_value;
+        APEX_frontend_redirect(cpu, target);
+    }
+    else
+    {
+        cpu->fetch_from_next_cycle = TRUE;
+    }
+    cpu->redirects++;
+    if (cpu->decode.thread == cpu->execute.thread)
+    {
+        cpu->decode.has_insn = FALSE;
+    }
 
-                /* Set the zero flag based on the result buffer */
-                if (cpu->execute.result_buffer == 0)
-                {
-                    cpu->zero_flag = TRUE;
-                } 
-                else 
-                {
-                    cpu->zero_flag = FALSE;
-                }
+    /* Make sure fetch stage is enabled to start fetching from new PC */
+    cpu->fetch.has_insn = TRUE;
+}
 
-                if (cpu->execute.result_buffer > 0)
-                {
-                    cpu->positive_flag = TRUE;
-                } 
-                else 
-                {
-                    cpu->positive_flag = FALSE;
-                }
+/*
+ * Resolves the branch or JUMP at pc in execute, or in decode for the one
+ * decode_resolve takes, unless decode already did. Fetch went on at the
+ * next pc behind it, or with the decoupled front end at the one predicted,
+ * and is sent to the right one if that was wrong; with branch_resolve past
+ * execute only after a cycle more for every stage further down.
+ */
+static void
+resolve_branch(APEX_CPU *cpu, int pc, int taken, int target)
+{
+    int wrong = taken;
 
-                break;
-            }
+    if (cpu->execute.resolved)
+    {
+        return;
+    }
+    if (cpu->config.frontend == FRONTEND_DECOUPLED)
+    {
+        wrong = (taken ? target : pc + 4) != cpu->execute.pred_pc;
+    }
+    APEX_frontend_resolve(cpu, pc, taken, target, wrong);
+    if (wrong)
+    {
+        redirect_fetch(cpu, taken ? target : pc + 4);
+        if (cpu->config.branch_resolve > RESOLVE_EXECUTE)
+        {
+            cpu->fetch_resume = cpu->clock + 1 + cpu->config.branch_resolve - RESOLVE_EXECUTE;
+        }
+    }
+}
 
-            case OPCODE_SUB:
-            {
-                cpu->execute.result_buffer
-                    = cpu->execute.rs1_value - cpu->execute.rs2_value;
+/*
+ * Sends fetch to target after a taken branch in trace mode. A flushed
+ * decode instruction that consumed a trace record returns it, which happens
+ * when the branch target is the next pc.
+ */
+static void
+trace_redirect(APEX_CPU *cpu, int target)
+{
+    cpu->pc = target;
+    cpu->fetch_from_next_cycle = TRUE;
 
-                /* Set the zero flag based on the result buffer */
-                if (cpu->execute.result_buffer == 0)
-                {
-                    cpu->zero_flag = TRUE;
-                } 
-                else 
-                {
-                    cpu->zero_flag = FALSE;
-                }
+    if (cpu->decode.has_insn && cpu->decode.trace_index >= 0)
+    {
+        cpu->trace_pos = cpu->decode.trace_index;
+    }
+    cpu->decode.has_insn = FALSE;
+    cpu->fetch.has_insn = TRUE;
+}
 
-                if (cpu->execute.result_buffer > 0)
-                {
-                    cpu->positive_flag = TRUE;
-                } 
-                else 
-                {
-                    cpu->positive_flag = FALSE;
-                }
+/*
+ * Execute stage in trace mode: memory addresses and branch outcomes come
+ * from the trace, so no operation is evaluated and only the redirects of
+ * taken branches are modelled. Operand and result values are meaningless.
+ */
+static void
+trace_execute(APEX_CPU *cpu)
+{
+    switch (cpu->execute.opcode)
+    {
+        case OPCODE_LOAD:
+        case OPCODE_LDI:
+        case OPCODE_STORE:
+        case OPCODE_STI:
+        case OPCODE_LL:
+        case OPCODE_SC:
+        case OPCODE_FAA:
+        {
+            cpu->execute.memory_address = cpu->execute.trace_info;
+            break;
+        }
 
-                break;
+        case OPCODE_BZ:
+        case OPCODE_BNZ:
+        case OPCODE_BP:
+        case OPCODE_BNP:
+        {
+            if (cpu->execute.trace_info)
+            {
+                trace_redirect(cpu, cpu->execute.pc + cpu->execute.imm);
             }
+            break;
+        }
 
-            case OPCODE_MUL:
-            {
-                cpu->execute.result_buffer
+        case OPCODE_JUMP:
+        {
+            trace_redirect(cpu, cpu->execute.trace_info);
+            break;
+        }
+    }
+
+    cpu->memory = cpu->execute;
+    cpu->pexecute = cpu->execute;
+}
+
+/* Opcodes setting the flags, SC in memory and the others in execute */
+static int
+flag_writer(int opcode)
+{
+    switch (opcode)
+    {
+        case OPCODE_ADD:
+        case OPCODE_SUB:
+        case OPCODE_MUL:
+        case OPCODE_DIV:
+        case OPCODE_AND:
+        case OPCODE_OR:
+        case OPCODE_XOR:
+        case OPCODE_ADDL:
+        case OPCODE_SUBL:
+        case OPCODE_CMP:
+        case OPCODE_SC:
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static int
+branch_opcode(int opcode)
+{
+    return opcode == OPCODE_BZ || opcode == OPCODE_BNZ || opcode == OPCODE_BP
+           || opcode == OPCODE_BNP;
+}
+
+/*
+ * Starts the instruction in execute on its functional unit. The result of
+ * a unit of its own, register and flags, can only be forwarded to decode
+ * fu_latency cycles later, and the unit takes the next instruction after
+ * fu_interval cycles. Results are still written in order, so a later
+ * write of the register or flags does not make them ready any earlier,
+ * except for the flags when renamed: then they are the last write's.
+ */
+static void
+fu_start(APEX_CPU *cpu)
+{
+    int op = cpu->execute.opcode;
+    int ready = cpu->clock + cpu->config.fu_latency[op] - 1;
+
+    cpu->fu_issued[op]++;
+    if (cpu->config.flag_rename && flag_writer(op))
+    {
+        cpu->flags_ready = ready;
+        cpu->flags_unit = op;
+    }
+    if (!fu_own_unit(cpu, op))
+    {
+        return;
+    }
+    cpu->fu_free[op] = cpu->clock + cpu->config.fu_interval[op];
+    if (op != OPCODE_CMP && ready > cpu->reg_ready[cpu->execute.rd])
+    {
+        cpu->reg_ready[cpu->execute.rd] = ready;
+        cpu->reg_unit[cpu->execute.rd] = op;
+    }
+    if (!cpu->config.flag_rename && op != OPCODE_MOVC && ready > cpu->flags_ready)
+    {
+        cpu->flags_ready = ready;
+        cpu->flags_unit = op;
+    }
+    if (ready > cpu->fu_done)
+    {
+        cpu->fu_done = ready;
+        cpu->fu_done_unit = op;
+    }
+}
+
+/* Whether the conditional branch opcode is taken on the flags as they are */
+static int
+branch_taken(const APEX_CPU *cpu, int opcode)
+{
+    switch (opcode)
+    {
+        case OPCODE_BZ:
+        {
+            return cpu->zero_flag == TRUE;
+        }
+
+        case OPCODE_BNZ:
+        {
+            return cpu->zero_flag == FALSE;
+        }
+
+        case OPCODE_BP:
+        {
+            return cpu->positive_flag == TRUE;
+        }
+
+        case OPCODE_BNP:
+        {
+            return cpu->positive_flag == FALSE;
+        }
+    }
+    return FALSE;
+}
+
+/* Resolves the branch fused into the instruction in execute on the flags it just set */
+static void
+fused_branch(APEX_CPU *cpu)
+{
+    resolve_branch(cpu, cpu->execute.fused_pc, branch_taken(cpu, cpu->execute.fused_opcode),
+                   cpu->execute.fused_pc + cpu->execute.fused_imm);
+}
+
+/*
+ * Returns TRUE when decode has the flags a branch issuing from it will find
+ * in execute: the last instruction before it writing them set them in an
+ * earlier cycle, and they reach decode over the bypass path of the stage
+ * it is in now, memory (it executed this cycle) or writeback. An SC about
+ * to set them in memory, or an older slot issuing with the branch, has not
+ * set them yet.
+ */
+static int
+flags_in_decode(const APEX_CPU *cpu)
+{
+    const CPU_Stage *executed = NULL;
+    const CPU_Stage *accessed = NULL;
+
+    if (cpu->config.width > 1)
+    {
+        for (int i = 0; i < cpu->execute_group.count; ++i)
+        {
+            if (flag_writer(cpu->execute_group.slot[i].opcode))
+            {
+                return FALSE;
+            }
+        }
+        for (int i = cpu->memory_group.count - 1; i >= 0 && !executed; --i)
+        {
+            if (flag_writer(cpu->memory_group.slot[i].opcode))
+            {
+                executed = &cpu->memory_group.slot[i];
+            }
+        }
+        for (int i = cpu->writeback_group.count - 1; i >= 0 && !accessed; --i)
+        {
+            if (flag_writer(cpu->writeback_group.slot[i].opcode))
+            {
+                accessed = &cpu->writeback_group.slot[i];
+            }
+        }
+    }
+    else
+    {
+        if (cpu->memory.has_insn && flag_writer(cpu->memory.opcode))
+        {
+            executed = &cpu->memory;
+        }
+        if (cpu->writeback.has_insn && flag_writer(cpu->writeback.opcode))
+        {
+            accessed = &cpu->writeback;
+        }
+    }
+
+    if (executed)
+    {
+        return executed->opcode != OPCODE_SC && (cpu->config.bypass & BYPASS_EX);
+    }
+    if (accessed)
+    {
+        return (cpu->config.bypass & BYPASS_MEM) != 0;
+    }
+    return TRUE;
+}
+
+/*
+ * With branch_resolve=decode, resolves the branch or JUMP decode just
+ * issued to execute when decode has what it depends on: the register of a
+ * JUMP, read like any operand, or the flags of a conditional branch not
+ * fused with the instruction setting them. Fetch is then sent to the right
+ * pc a cycle earlier than from execute, and execute leaves it alone.
+ */
+static void
+decode_resolve(APEX_CPU *cpu)
+{
+    CPU_Stage *stage = &cpu->execute;
+
+    if (cpu->config.branch_resolve != RESOLVE_DECODE || !stage->has_insn || stage->fused)
+    {
+        return;
+    }
+    if (stage->opcode == OPCODE_JUMP)
+    {
+        resolve_branch(cpu, stage->pc, TRUE, stage->rs1_value + stage->imm);
+    }
+    else if (branch_opcode(stage->opcode) && flags_in_decode(cpu))
+    {
+        resolve_branch(cpu, stage->pc, branch_taken(cpu, stage->opcode), stage->pc + stage->imm);
+    }
+    else
+    {
+        return;
+    }
+    stage->resolved = TRUE;
+    cpu->early_resolved++;
+}
+
+/*
+ * Execute Stage of APEX Pipeline
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+static void
+APEX_execute(APEX_CPU *cpu)
+{
+    if (cpu->execute.has_insn)
+    {
+        fu_start(cpu);
+    }
+    if (cpu->execute.has_insn && cpu->trace)
+    {
+        trace_execute(cpu);
+        return;
+    }
+
+    if (cpu->execute.has_insn)
+    {
+        /* Execute logic based on instruction type */
+        switch (cpu->execute.opcode)
+        {
+            case OPCODE_ADD:
+            {
+                cpu->execute.result_buffer
+                    = cpu->execute.rs1_value + cpu->execute.rs2_value;
+
+                /* Set the zero flag based on the result buffer */
+                if (cpu->execute.result_buffer == 0)
+                {
+                    cpu->zero_flag = TRUE;
+                } 
+                else 
+                {
+                    cpu->zero_flag = FALSE;
+                }
+
+                if (cpu->execute.result_buffer > 0)
+                {
+                    cpu->positive_flag = TRUE;
+                } 
+                else 
+                {
+                    cpu->positive_flag = FALSE;
+                }
+
+                break;
+            }
+
+            case OPCODE_SUB:
+            {
+                cpu->execute.result_buffer
+                    = cpu->execute.rs1_value - cpu->execute.rs2_value;
+
+                /* Set the zero flag based on the result buffer */
+                if (cpu->execute.result_buffer == 0)
+                {
+                    cpu->zero_flag = TRUE;
+                } 
+                else 
+                {
+                    cpu->zero_flag = FALSE;
+                }
+
+                if (cpu->execute.result_buffer > 0)
+                {
+                    cpu->positive_flag = TRUE;
+                } 
+                else 
+                {
+                    cpu->positive_flag = FALSE;
+                }
+
+                break;
+            }
+
+            case OPCODE_MUL:
+            {
+                cpu->execute.result_buffer
                     = cpu->execute.rs1_value * cpu->execute.rs2_value;
 
                 /* Set the zero flag based on the result buffer */
@@ -540,83 +1075,50 @@ APEX_execute(APEX_CPU *cpu)
                 break;
             }
 
+            case OPCODE_LL:
+            {
+                cpu->execute.memory_address
+                    = cpu->execute.rs1_value + cpu->execute.imm;
+                break;
+            }
+
+            case OPCODE_SC:
+            case OPCODE_FAA:
+            {
+                cpu->execute.memory_address
+                    = cpu->execute.rs2_value + cpu->execute.imm;
+                break;
+            }
+
             case OPCODE_BZ:
             {
-                if (cpu->zero_flag == TRUE)
-                {
-                    /* Calculate new PC, and send it to fetch unit */
-                    cpu->pc = cpu->execute.pc + cpu->execute.imm;
-                    
-                    /* Since we are using reverse callbacks for pipeline stages, 
-                     * this will prevent the new instruction from being fetched in the current cycle*/
-                    cpu->fetch_from_next_cycle = TRUE;
-
-                    /* Flush previous stages */
-                    cpu->decode.has_insn = FALSE;
-
-                    /* Make sure fetch stage is enabled to start fetching from new PC */
-                    cpu->fetch.has_insn = TRUE;
-                }
+                /* Calculate new PC, and send it to fetch unit */
+                resolve_branch(cpu, cpu->execute.pc, cpu->zero_flag == TRUE,
+                               cpu->execute.pc + cpu->execute.imm);
                 break;
             }
 
             case OPCODE_BNZ:
             {
-                if (cpu->zero_flag == FALSE)
-                {
-                    /* Calculate new PC, and send it to fetch unit */
-                    cpu->pc = cpu->execute.pc + cpu->execute.imm;
-                    
-                    /* Since we are using reverse callbacks for pipeline stages, 
-                     * this will prevent the new instruction from being fetched in the current cycle*/
-                    cpu->fetch_from_next_cycle = TRUE;
-
-                    /* Flush previous stages */
-                    cpu->decode.has_insn = FALSE;
-
-                    /* Make sure fetch stage is enabled to start fetching from new PC */
-                    cpu->fetch.has_insn = TRUE;
-                }
+                /* Calculate new PC, and send it to fetch unit */
+                resolve_branch(cpu, cpu->execute.pc, cpu->zero_flag == FALSE,
+                               cpu->execute.pc + cpu->execute.imm);
                 break;
             }
 
             case OPCODE_BP:
             {
-                if (cpu->positive_flag == TRUE)
-                {
-                    /* Calculate new PC, and send it to fetch unit */
-                    cpu->pc = cpu->execute.pc + cpu->execute.imm;
-                    
-                    /* Since we are using reverse callbacks for pipeline stages, 
-                     * this will prevent the new instruction from being fetched in the current cycle*/
-                    cpu->fetch_from_next_cycle = TRUE;
-
-                    /* Flush previous stages */
-                    cpu->decode.has_insn = FALSE;
-
-                    /* Make sure fetch stage is enabled to start fetching from new PC */
-                    cpu->fetch.has_insn = TRUE;
-                }
+                /* Calculate new PC, and send it to fetch unit */
+                resolve_branch(cpu, cpu->execute.pc, cpu->positive_flag == TRUE,
+                               cpu->execute.pc + cpu->execute.imm);
                 break;
             }
 
             case OPCODE_BNP:
             {
-                if (cpu->positive_flag == FALSE)
-                {
-                    /* Calculate new PC, and send it to fetch unit */
-                    cpu->pc = cpu->execute.pc + cpu->execute.imm;
-                    
-                    /* Since we are using reverse callbacks for pipeline stages, 
-                     * this will prevent the new instruction from being fetched in the current cycle*/
-                    cpu->fetch_from_next_cycle = TRUE;
-
-                    /* Flush previous stages */
-                    cpu->decode.has_insn = FALSE;
-
-                    /* Make sure fetch stage is enabled to start fetching from new PC */
-                    cpu->fetch.has_insn = TRUE;
-                }
+                /* Calculate new PC, and send it to fetch unit */
+                resolve_branch(cpu, cpu->execute.pc, cpu->positive_flag == FALSE,
+                               cpu->execute.pc + cpu->execute.imm);
                 break;
             }
 
@@ -728,23 +1230,14 @@ APEX_execute(APEX_CPU *cpu)
 
             case OPCODE_JUMP:
             {
-                cpu->pc= cpu->execute.rs1_value + cpu->execute.imm;
-
-                /* Since we are using reverse callbacks for pipeline stages, 
-                     * this will prevent the new instruction from being fetched in the current cycle*/
-                    cpu->fetch_from_next_cycle = TRUE;
-
-                    /* Flush previous stages */
-                    cpu->decode.has_insn = FALSE;
-
-                    /* Make sure fetch stage is enabled to start fetching from new PC */
-                    cpu->fetch.has_insn = TRUE;
-
+                resolve_branch(cpu, cpu->execute.pc, TRUE,
+                               cpu->execute.rs1_value + cpu->execute.imm);
                 break;
             }
 
             case OPCODE_HALT:
             case OPCODE_NOP:
+            case OPCODE_FENCE:
             {
                 /* No work for these instructions */
                 break;
@@ -752,6 +1245,14 @@ APEX_execute(APEX_CPU *cpu)
 
         }
 
+        if (cpu->execute.fused)
+        {
+            fused_branch(cpu);
+        }
+
+        cpu->execute.zero_flag = cpu->zero_flag;
+        cpu->execute.positive_flag = cpu->positive_flag;
+
         /* Copy data from execute latch to memory latch*/
         cpu->memory = cpu->execute;
         cpu->pexecute = cpu->execute;
@@ -769,26 +1270,169 @@ APEX_execute(APEX_CPU *cpu)
 }
 
 /*
- * Memory Stage of APEX Pipeline
+ * Starts the data cache access of a load or store when it enters memory.
  *
- * Note: You are free to edit this function according to your implementation
+ * Returns TRUE while the access needs more cycles; the instruction then
+ * stays in memory and completes in the cycle the access does.
  */
-static void
-APEX_memory(APEX_CPU *cpu)
+static int
+memory_busy(APEX_CPU *cpu)
 {
-    if(cpu->stall_count==1){
-        cpu->stall_count=0;
+    int is_store = FALSE;
+
+    switch (cpu->memory.opcode)
+    {
+        case OPCODE_STORE:
+        case OPCODE_STI:
+        case OPCODE_SC:
+        case OPCODE_FAA:
+        {
+            is_store = TRUE;
+            break;
+        }
+
+        case OPCODE_LOAD:
+        case OPCODE_LDI:
+        case OPCODE_LL:
+        case OPCODE_FENCE:
+        {
+            break;
+        }
+
+        default:
+        {
+            return FALSE;
+        }
     }
-    cpu->load_in_ex=0;
-    if (cpu->memory.has_insn)
+
+    if (!cpu->mem_pending)
     {
-        switch (cpu->memory.opcode)
+        cpu->mem_done = cpu->clock + 1;
+        if (cpu->config.cache_size[CACHE_L1D] && cpu->memory.opcode != OPCODE_FENCE)
         {
-            case OPCODE_ADD:
-            case OPCODE_SUB:
-            case OPCODE_MUL:
-            case OPCODE_DIV:
-            case OPCODE_AND:
+            cpu->mem_done = APEX_cache_access(cpu, cpu->memory.pc,
+                                              cpu->memory.memory_address, is_store);
+        }
+        cpu->mem_pending = TRUE;
+
+        /* On a core, atomics and fences wait for the end of the quantum to
+         * be ordered with the other cores */
+        if (cpu->core && (cpu->memory.opcode == OPCODE_LL || cpu->memory.opcode == OPCODE_SC
+                          || cpu->memory.opcode == OPCODE_FAA
+                          || cpu->memory.opcode == OPCODE_FENCE))
+        {
+            APEX_multicore_atomic(cpu, cpu->memory.opcode, cpu->memory.memory_address,
+                                  cpu->memory.rs1_value, cpu->mem_done);
+            return TRUE;
+        }
+    }
+    if (cpu->mem_done == CACHE_PENDING)
+    {
+        cpu->mem_done = APEX_cache_poll(cpu);
+    }
+    if (cpu->clock + 1 < cpu->mem_done)
+    {
+        return TRUE;
+    }
+    cpu->mem_pending = FALSE;
+    return FALSE;
+}
+
+/*
+ * A store of one SMT thread breaks the reservations other threads hold on
+ * the word, as the stores of other cores do in a multicore run
+ */
+static void
+smt_break_links(APEX_CPU *cpu, int addr)
+{
+    for (int t = 0; t < cpu->config.smt_threads; ++t)
+    {
+        if (t != cpu->thread && cpu->threads[t].link_addr == addr)
+        {
+            cpu->threads[t].link_addr = -1;
+        }
+    }
+}
+
+/*
+ * Performs LL, SC and FAA in memory. SC succeeds if the last LL reserved
+ * its word and no SC came in between, and sets the flags from its result.
+ * A core of a multicore run got the outcome from the other cores at the
+ * end of the quantum, with the word stored already in its data memory.
+ */
+static void
+memory_atomic(APEX_CPU *cpu)
+{
+    CPU_Stage *stage = &cpu->memory;
+    int addr = stage->memory_address;
+
+    if (cpu->core)
+    {
+        stage->result_buffer = APEX_multicore_result(cpu);
+    }
+    else if (stage->opcode == OPCODE_LL)
+    {
+        stage->result_buffer = APEX_mem_read(&cpu->data_memory, addr);
+        cpu->link_addr = addr;
+    }
+    else if (stage->opcode == OPCODE_SC)
+    {
+        stage->result_buffer = cpu->link_addr == addr;
+        cpu->link_addr = -1;
+        if (stage->result_buffer)
+        {
+            APEX_mem_write(&cpu->data_memory, addr, stage->rs1_value);
+            smt_break_links(cpu, addr);
+        }
+    }
+    else
+    {
+        stage->result_buffer = APEX_mem_read(&cpu->data_memory, addr);
+        APEX_mem_write(&cpu->data_memory, addr, stage->result_buffer + stage->rs1_value);
+        smt_break_links(cpu, addr);
+    }
+
+    if (stage->opcode == OPCODE_SC)
+    {
+        cpu->zero_flag = stage->result_buffer == 0;
+        cpu->positive_flag = stage->result_buffer > 0;
+        stage->zero_flag = cpu->zero_flag;
+        stage->positive_flag = cpu->positive_flag;
+    }
+
+    /* Word stored by FAA */
+    stage->result_buffer1 = stage->result_buffer + stage->rs1_value;
+}
+
+/*
+ * Memory Stage of APEX Pipeline
+ *
+ * Returns TRUE while a data cache miss holds the instruction in memory.
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+static int
+APEX_memory(APEX_CPU *cpu)
+{
+    if(cpu->stall_count==1){
+        cpu->stall_count=0;
+    }
+    cpu->load_in_ex=0;
+    if (cpu->memory.has_insn && (cpu->config.cache_size[CACHE_L1D] || cpu->core)
+        && memory_busy(cpu))
+    {
+        cpu->pmemory = cpu->memory;
+        return TRUE;
+    }
+    if (cpu->memory.has_insn)
+    {
+        switch (cpu->memory.opcode)
+        {
+            case OPCODE_ADD:
+            case OPCODE_SUB:
+            case OPCODE_MUL:
+            case OPCODE_DIV:
+            case OPCODE_AND:
             case OPCODE_OR:
             case OPCODE_XOR:
             case OPCODE_MOVC:
@@ -802,17 +1446,26 @@ APEX_memory(APEX_CPU *cpu)
             case OPCODE_JUMP:
             case OPCODE_HALT:
             case OPCODE_NOP:
+            case OPCODE_FENCE:
             {
                 /* No work for these instructions */
                 break;
             }
 
+            case OPCODE_LL:
+            case OPCODE_SC:
+            case OPCODE_FAA:
+            {
+                memory_atomic(cpu);
+                break;
+            }
+
             case OPCODE_LOAD:
             case OPCODE_LDI:
             {
                 /* Read from data memory */
                 cpu->memory.result_buffer
-                    = cpu->data_memory[cpu->memory.memory_address];
+                    = APEX_mem_read(&cpu->data_memory, cpu->memory.memory_address);
                 break;
             }
 
@@ -820,8 +1473,14 @@ APEX_memory(APEX_CPU *cpu)
             case OPCODE_STI:
             {
                 /* Read from data memory */
-                cpu->data_memory[cpu->memory.memory_address]
-                    = cpu->memory.rs1_value;
+                APEX_mem_write(&cpu->data_memory, cpu->memory.memory_address,
+                               cpu->memory.rs1_value);
+                if (cpu->core)
+                {
+                    APEX_multicore_store(cpu, cpu->memory.memory_address,
+                                         cpu->memory.rs1_value);
+                }
+                smt_break_links(cpu, cpu->memory.memory_address);
                 break;
             }
 
@@ -842,6 +1501,32 @@ APEX_memory(APEX_CPU *cpu)
             cpu->mp=0;
             //printf("Instruction at MEMORY____STAGE ---> EMPTY\n");
     }
+    return FALSE;
+}
+
+/*
+ * Counts the instruction retiring from writeback in the fusion statistics:
+ * the branch of a fused pair retires with it, and a conditional branch
+ * right behind the ALU instruction setting its flags is a pair missed.
+ */
+static void
+fuse_retire(APEX_CPU *cpu)
+{
+    const CPU_Stage *wb = &cpu->writeback;
+    int last = cpu->last_retired_op;
+
+    if (wb->fused)
+    {
+        cpu->insn_completed++;
+        cpu->fused[wb->opcode][fuse_branch(wb->fused_opcode)]++;
+    }
+    else if (fuse_bit(wb->opcode) && cpu->last_retired_pc + 4 == wb->pc && flag_writer(last)
+             && last != OPCODE_MUL && last != OPCODE_DIV && last != OPCODE_SC)
+    {
+        cpu->fuse_missed[last][fuse_branch(wb->opcode)]++;
+    }
+    cpu->last_retired_pc = wb->pc;
+    cpu->last_retired_op = wb->opcode;
 }
 
 /*
@@ -868,6 +1553,9 @@ APEX_writeback(APEX_CPU *cpu)
             case OPCODE_LOAD:
             case OPCODE_ADDL:
             case OPCODE_SUBL:
+            case OPCODE_LL:
+            case OPCODE_SC:
+            case OPCODE_FAA:
             {
                 cpu->regs[cpu->writeback.rd] = cpu->writeback.result_buffer;
                 break;
@@ -895,6 +1583,7 @@ APEX_writeback(APEX_CPU *cpu)
             case OPCODE_JUMP:
             case OPCODE_HALT:
             case OPCODE_NOP:
+            case OPCODE_FENCE:
             {
                 /* No work for these instructions */
                 break;
@@ -903,6 +1592,7 @@ APEX_writeback(APEX_CPU *cpu)
         }
 
         cpu->insn_completed++;
+        fuse_retire(cpu);
         cpu->pwriteback = cpu->writeback;
         cpu->writeback.has_insn = FALSE;
 
@@ -944,6 +1634,9 @@ get_mem_dest(APEX_CPU *cpu)
             case OPCODE_LOAD:
             case OPCODE_ADDL:
             case OPCODE_SUBL:
+            case OPCODE_LL:
+            case OPCODE_SC:
+            case OPCODE_FAA:
             {
                 cpu->mem_dest=cpu->memory.rd;
                 cpu->mem_dest_value=cpu->memory.result_buffer;
@@ -1001,6 +1694,9 @@ get_ex_dest(APEX_CPU *cpu)
             }
 
             case OPCODE_LOAD:
+            case OPCODE_LL:
+            case OPCODE_SC:
+            case OPCODE_FAA:
             {
                 cpu->ex_dest=cpu->execute.rd;
                 cpu->ex_dest1=-1;
@@ -1033,9 +1729,154 @@ get_ex_dest(APEX_CPU *cpu)
 }
 
 
+/*
+ * forward_ready of a wide pipeline. The youngest slot of execute writing
+ * reg decides like ex_dest does, any slot of memory like mem_dest. An older
+ * instruction issuing from decode in the same cycle has no value to give
+ * yet, so reg is never ready when it writes it.
+ */
+static int
+wide_forward_ready(APEX_CPU *cpu, int reg)
+{
+    for (int i = 0; i < cpu->issue_slots; ++i)
+    {
+        if (reg == cpu->issue_dests[i].dest || reg == cpu->issue_dests[i].dest1)
+        {
+            cpu->regf[reg] = 1;
+            cpu->issue_limit = ISSUE_LIMIT_GROUP;
+            return FALSE;
+        }
+    }
+    cpu->issue_limit = ISSUE_LIMIT_OPERAND;
+    for (int i = cpu->ex_slots - 1; i >= 0; --i)
+    {
+        const APEX_Bypass *b = &cpu->ex_bypass[i];
+
+        if (reg == b->dest || reg == b->dest1)
+        {
+            if (!(cpu->config.bypass & BYPASS_EX))
+            {
+                cpu->regf[reg] = 1;
+                return FALSE;
+            }
+            return !(reg == b->dest && b->load);
+        }
+    }
+    for (int i = 0; i < cpu->mem_slots; ++i)
+    {
+        const APEX_Bypass *b = &cpu->mem_bypass[i];
+
+        if ((reg == b->dest || reg == b->dest1) && !(cpu->config.bypass & BYPASS_MEM))
+        {
+            cpu->regf[reg] = 1;
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Returns FALSE when decode cannot obtain reg in this cycle: its producer
+ * is in execute or memory and the matching bypass path is disabled, or it
+ * is a load still in execute. Without any bypass the value is read from the
+ * register file once the producer reaches writeback. Unlike Part A, only
+ * producers still in execute or memory are waited for: after a taken
+ * branch Part A also stalled on the destination of the last instruction
+ * seen there, although it had already retired.
+ */
+static int
+forward_ready(APEX_CPU *cpu, int reg)
+{
+    if (cpu->config.width > 1)
+    {
+        return wide_forward_ready(cpu, reg);
+    }
+    if((reg==cpu->ex_dest) || (reg==cpu->ex_dest1)){
+        if(!(cpu->config.bypass & BYPASS_EX)){
+            cpu->regf[reg]=1;
+            return FALSE;
+        }
+        return !(reg==cpu->ex_dest && cpu->load_in_ex==1);
+    }
+
+    if((reg==cpu->mem_dest) || (reg==cpu->mem_dest1)){
+        if(!(cpu->config.bypass & BYPASS_MEM)){
+            cpu->regf[reg]=1;
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/*
+ * Returns FALSE while a result of the functional unit of opcode, due in
+ * cycle ready, cannot be forwarded to decode yet
+ */
+static int
+result_ready(APEX_CPU *cpu, int ready, int opcode)
+{
+    if (cpu->clock >= ready)
+    {
+        return TRUE;
+    }
+    cpu->fu_waiting = opcode;
+    cpu->issue_limit = ISSUE_LIMIT_OPERAND;
+    return FALSE;
+}
+
+/* Returns FALSE when reg is not there for decode to read in this cycle */
+static int
+operand_ready(APEX_CPU *cpu, int reg)
+{
+    return forward_ready(cpu, reg) && result_ready(cpu, cpu->reg_ready[reg], cpu->reg_unit[reg]);
+}
+
+/*
+ * Returns FALSE when the instruction in decode waits on the functional
+ * units: a branch on flags still being computed, HALT on any unit not
+ * drained, anything else on its unit busy with an earlier instruction.
+ */
+static int
+fu_ready(APEX_CPU *cpu)
+{
+    int op = cpu->decode.opcode;
+
+    switch (op)
+    {
+        case OPCODE_BZ:
+        case OPCODE_BNZ:
+        case OPCODE_BP:
+        case OPCODE_BNP:
+        {
+            if (!result_ready(cpu, cpu->flags_ready, cpu->flags_unit))
+            {
+                cpu->flag_stall_cycles++;
+                return FALSE;
+            }
+            return TRUE;
+        }
+
+        case OPCODE_HALT:
+        {
+            return result_ready(cpu, cpu->fu_done, cpu->fu_done_unit);
+        }
+    }
+
+    /* It reaches execute in the next cycle */
+    if (fu_own_unit(cpu, op) && cpu->clock + 1 < cpu->fu_free[op])
+    {
+        cpu->fu_unit_stalls[op]++;
+        cpu->issue_limit = ISSUE_LIMIT_UNIT;
+        return FALSE;
+    }
+    return TRUE;
+}
+
 static void
 check_stalling(APEX_CPU *cpu)
 {
+    cpu->fu_waiting = -1;
     if (cpu->decode.has_insn)
     {
         /* Read operands from register file based on the instruction type */
@@ -1051,23 +1892,13 @@ check_stalling(APEX_CPU *cpu)
             case OPCODE_STORE:
             case OPCODE_STI:
             case OPCODE_CMP:
+            case OPCODE_SC:
+            case OPCODE_FAA:
             {
-                
-                if(cpu->decode.rs1==cpu->ex_dest){
-                    if(cpu->load_in_ex==1){
-                        cpu->stall_count=1;
-                        break;
-                    }
-                    
+                if(!operand_ready(cpu, cpu->decode.rs1) || !operand_ready(cpu, cpu->decode.rs2)){
+                    cpu->stall_count=1;
                 }
-                if(cpu->decode.rs2==cpu->ex_dest){
-                    if(cpu->load_in_ex==1){
-                        cpu->stall_count=1;
-                        break;
-                    }
-                    
-                }
-                
+                break;
             }
 
             case OPCODE_LOAD:
@@ -1075,16 +1906,12 @@ check_stalling(APEX_CPU *cpu)
             case OPCODE_SUBL:
             case OPCODE_LDI:
             case OPCODE_JUMP:
+            case OPCODE_LL:
             {
-                
-                if((cpu->decode.rs1==cpu->ex_dest) || (cpu->decode.rs1==cpu->ex_dest1)){
-                    if(cpu->load_in_ex==1){
-                        cpu->stall_count=1;
-                        break;
-                    }
-                    
+                if(!operand_ready(cpu, cpu->decode.rs1)){
+                    cpu->stall_count=1;
                 }
-                
+                break;
             }
 
             case OPCODE_MOVC:
@@ -1094,16 +1921,25 @@ check_stalling(APEX_CPU *cpu)
             case OPCODE_BNP:
             case OPCODE_HALT:
             case OPCODE_NOP:
+            case OPCODE_FENCE:
             {
                 /* doesn't have register operands */
                 break;
             }
+        }
 
-            
-            
+        if (!cpu->stall_count && !fu_ready(cpu))
+        {
+            cpu->stall_count = 1;
+        }
+
+        if(cpu->stall_count){
+            cpu->stall_cycles++;
+        }
+        if (cpu->stall_count && cpu->fu_waiting >= 0)
+        {
+            cpu->fu_result_stalls[cpu->fu_waiting]++;
         }
-        
-        /* Copy data from decode latch to execute latch*/
      }   
 }
 
@@ -1136,6 +1972,7 @@ stall_fetch(APEX_CPU *cpu)
         cpu->fetch.rs1 = current_ins->rs1;
         cpu->fetch.rs2 = current_ins->rs2;
         cpu->fetch.imm = current_ins->imm;
+        cpu->fetch.fused = FALSE;
 
         cpu->mem_dest=-1;
         cpu->mem_dest1=-1;
@@ -1164,6 +2001,26 @@ stall_fetch(APEX_CPU *cpu)
     }
 }
 
+/*
+ * Keeps fetch, decode and execute where they are while memory is busy, as
+ * if execute had stalled on its way into memory
+ */
+static void
+hold_front(APEX_CPU *cpu)
+{
+    cpu->pexecute = cpu->execute;
+    cpu->ep = cpu->execute.has_insn;
+    if (cpu->fetch.has_insn && !cpu->fetch_from_next_cycle)
+    {
+        stall_fetch(cpu);
+    }
+    else
+    {
+        cpu->pdecode = cpu->decode;
+        cpu->fp = 0;
+    }
+    cpu->dp = cpu->decode.has_insn;
+}
 
 static void
 print_data_mem(const APEX_CPU *cpu, int size)
@@ -1173,7 +2030,7 @@ print_data_mem(const APEX_CPU *cpu, int size)
 
     for (int i = 0; i < size; ++i)
     {
-        printf("| MEM[%-4d] | Data Value=%-4d |\n", i, cpu->data_memory[i]);
+        printf("| MEM[%-4d] | Data Value=%-4d |\n", i, APEX_mem_peek(&cpu->data_memory, i));
     }
 
     
@@ -1183,12 +2040,13 @@ print_data_mem(const APEX_CPU *cpu, int size)
 
 
 /*
- * This function creates and initializes APEX cpu.
+ * This function creates and initializes APEX cpu, with data memory holding
+ * the words of data_image from word data_base on if data_image is given.
  *
  * Note: You are free to edit this function according to your implementation
  */
 APEX_CPU *
-APEX_cpu_init(const char *filename)
+APEX_cpu_init(const char *filename, const char *data_image, int data_base)
 {
     //int i;
     APEX_CPU *cpu;
@@ -1207,9 +2065,11 @@ APEX_cpu_init(const char *filename)
 
     /* Initialize PC, Registers and all pipeline stages */
     cpu->pc = 4000;
+    cpu->link_addr = -1;
     memset(cpu->regs, 0, sizeof(int) * REG_FILE_SIZE);
-    memset(cpu->data_memory, 0, sizeof(int) * DATA_MEMORY_SIZE);
+    APEX_mem_init(&cpu->data_memory);
     cpu->single_step = ENABLE_SINGLE_STEP;
+    APEX_config_init(&cpu->config);
 
     /* Parse input file and create code memory */
     cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
@@ -1218,6 +2078,11 @@ APEX_cpu_init(const char *filename)
         free(cpu);
         return NULL;
     }
+    if (data_image && !APEX_mem_map(&cpu->data_memory, data_image, data_base))
+    {
+        APEX_cpu_stop(cpu);
+        return NULL;
+    }
 
     /*if (ENABLE_DEBUG_MESSAGES)
     {
@@ -1244,98 +2109,743 @@ APEX_cpu_init(const char *filename)
 }
 
 /*
- * APEX CPU simulation loop
- *
- * Note: You are free to edit this function according to your implementation
+ * Debug function which prints the content of every pipeline stage in the
+ * cycle that just completed
  */
 void
-APEX_cpu_run(APEX_CPU *cpu,char func[],char cycle[])
+APEX_cpu_print_pipeline(const APEX_CPU *cpu)
 {
-    char user_prompt_val;
-    cpu->clock=1;
-    while (TRUE)
-    {
-        
-        cpu->wp=1;
-        cpu->mp=1;
-        cpu->ep=1;
-        cpu->dp=1;
-        cpu->fp=1;
+    printf("\n_ _ _ _ _ _ _ _ _ _ _ _CLOCK CYCLE %d_ _ _ _ _ _ _ _ _ _ _ _\n", cpu->clock);
 
-        for (int i = 0; i < REG_FILE_SIZE; ++i)
+    if (cpu->config.width > 1)
     {
-        cpu->regf[i]=0;
+        print_group("Instruction at FETCH_____STAGE --->", &cpu->pfetch_group);
+        print_group("Instruction at DECODE_RF_STAGE --->", &cpu->pdecode_group);
+        print_group("Instruction at EX________STAGE --->", &cpu->pexecute_group);
+        print_group("Instruction at MEMORY____STAGE --->", &cpu->pmemory_group);
+        print_group("Instruction at WRITEBACK_STAGE --->", &cpu->pwriteback_group);
+        return;
     }
 
-        /*if (ENABLE_DEBUG_MESSAGES)
-        {
-            printf("_ _ _ _ _ _ _ _ _ _ _ _CLOCK CYCLE %d_ _ _ _ _ _ _ _ _ _ _ _\n", cpu->clock);
-        }*/
-
-        int stop=APEX_writeback(cpu);
-            /* Halt in writeback stage */
-            
+    if(cpu->fp==1){
+        print_stage_content("\nInstruction at FETCH_____STAGE --->", &cpu->pfetch);
+    }
+    else{
+        printf("Instruction at FETCH_____STAGE ---> EMPTY\n");
+    }
 
-        APEX_memory(cpu);
+    if(cpu->dp==1){
+        print_stage_content("Instruction at DECODE_RF_STAGE --->", &cpu->pdecode);
+    }
+    else{
+        printf("Instruction at DECODE_RF_STAGE ---> EMPTY\n");
+    }
 
-        get_mem_dest(cpu);
-        
-        APEX_execute(cpu);
-        
-        get_ex_dest(cpu);
+    if(cpu->ep==1){
+        print_stage_content("Instruction at EX________STAGE --->", &cpu->pexecute);
+    }
+    else{
+        printf("Instruction at EX________STAGE ---> EMPTY\n");
+    }
 
-        check_stalling(cpu);
-        
-        if(cpu->stall_count==0){
-            APEX_decode(cpu);
-            APEX_fetch(cpu);
-        }
-        else{
-            //print_stage_content("Instruction at DECODE_RF_STAGE --->", &cpu->decode);
-            stall_fetch(cpu);
-            //print_stage_content("Instruction at FETCH_____STAGE --->", &cpu->fetch);
-        }
+    if(cpu->mp==1){
+        print_stage_content("Instruction at MEMORY____STAGE --->", &cpu->pmemory);
+    }
+    else{
+        printf("Instruction at MEMORY____STAGE ---> EMPTY\n");
+    }
 
+    if(cpu->wp==1){
+        print_stage_content("Instruction at WRITEBACK_STAGE --->", &cpu->pwriteback);
+    }
+    else{
+        printf("Instruction at WRITEBACK_STAGE ---> EMPTY\n");
+    }
+}
 
-        if(strcmp(func, "display") == 0 || strcmp(func, "single_step") == 0){
+/*
+ * Debug function which prints the flags, the register file and the first
+ * mem_size words of data memory
+ */
+void
+APEX_cpu_print_state(const APEX_CPU *cpu, int mem_size)
+{
+    printf("\n-----Flag Registers-----\nZero Flag:%d\nPositive Flag:%d\n",cpu->zero_flag,cpu->positive_flag);
+    print_reg_file(cpu);
+    print_data_mem(cpu,mem_size);
+}
 
-            printf("\n_ _ _ _ _ _ _ _ _ _ _ _CLOCK CYCLE %d_ _ _ _ _ _ _ _ _ _ _ _\n", cpu->clock);
+/*
+ * Sets b to the registers the instruction in stage writes and the values it
+ * forwards, as get_mem_dest finds them for an instruction leaving memory
+ * and get_ex_dest for one leaving execute
+ */
+static void
+wide_bypass(APEX_CPU *cpu, const CPU_Stage *stage, int in_memory, APEX_Bypass *b)
+{
+    cpu->mem_dest = -1;
+    cpu->mem_dest1 = -1;
+    cpu->ex_dest = -1;
+    cpu->ex_dest1 = -1;
+    cpu->load_in_ex = 0;
+    if (in_memory)
+    {
+        cpu->memory = *stage;
+        get_mem_dest(cpu);
+        b->dest = cpu->mem_dest;
+        b->value = cpu->mem_dest_value;
+        b->dest1 = cpu->mem_dest1;
+        b->value1 = cpu->mem_dest1_value;
+        b->load = FALSE;
+    }
+    else
+    {
+        cpu->execute = *stage;
+        get_ex_dest(cpu);
+        b->dest = cpu->ex_dest;
+        b->value = cpu->ex_dest_value;
+        b->dest1 = cpu->ex_dest1;
+        b->value1 = cpu->ex_dest1_value;
+        b->load = cpu->load_in_ex;
+    }
+}
 
-            if(cpu->fp==1){
-                print_stage_content("\nInstruction at FETCH_____STAGE --->", &cpu->pfetch);
-            }
-            else{
-                printf("Instruction at FETCH_____STAGE ---> EMPTY\n");
-            }
+/* Retires the writeback group in order. Returns TRUE once HALT retired. */
+static int
+wide_writeback(APEX_CPU *cpu)
+{
+    CPU_Group *wb = &cpu->writeback_group;
+    int stop = FALSE;
 
-            if(cpu->dp==1){
-                print_stage_content("Instruction at DECODE_RF_STAGE --->", &cpu->pdecode);
-            }
-            else{
-                printf("Instruction at DECODE_RF_STAGE ---> EMPTY\n");
-            }
-        
-            if(cpu->ep==1){
-                print_stage_content("Instruction at EX________STAGE --->", &cpu->pexecute);
-            }
-            else{
-                printf("Instruction at EX________STAGE ---> EMPTY\n");
-            }
+    cpu->pwriteback_group.count = 0;
+    for (int i = 0; i < wb->count && !stop; ++i)
+    {
+        cpu->writeback = wb->slot[i];
+        stop = APEX_writeback(cpu);
+        cpu->pwriteback_group.slot[cpu->pwriteback_group.count++] = cpu->pwriteback;
+    }
+    wb->count = 0;
+    cpu->wp = cpu->pwriteback_group.count > 0;
+    return stop;
+}
 
-            if(cpu->mp==1){
-                print_stage_content("Instruction at MEMORY____STAGE --->", &cpu->pmemory);
-            }
-            else{
-                printf("Instruction at MEMORY____STAGE ---> EMPTY\n");
-            }
-        
-            if(cpu->wp==1){
-                print_stage_content("Instruction at WRITEBACK_STAGE --->", &cpu->pwriteback);
-            }
-            else{
-                printf("Instruction at WRITEBACK_STAGE ---> EMPTY\n");
-            }
+/*
+ * With renamed flags an SC issues with younger instructions, which executed
+ * before it sets the flags in memory. Those up to the next flags write
+ * take the flags of the SC as theirs; if there is such a write, the flags
+ * are left as it set them.
+ */
+static void
+wide_sc_flags(APEX_CPU *cpu, CPU_Group *mem, int sc, int zero_flag, int positive_flag)
+{
+    for (int i = sc + 1; i < mem->count; ++i)
+    {
+        if (flag_writer(mem->slot[i].opcode))
+        {
+            cpu->zero_flag = zero_flag;
+            cpu->positive_flag = positive_flag;
+            return;
+        }
+        mem->slot[i].zero_flag = cpu->zero_flag;
+        mem->slot[i].positive_flag = cpu->positive_flag;
+    }
+}
+
+/*
+ * Moves the memory group on to writeback in order, each instruction
+ * leaving a bypass path behind. Returns TRUE when one of them has to wait
+ * for the data cache; it stays in memory with everything younger.
+ */
+static int
+wide_memory(APEX_CPU *cpu)
+{
+    CPU_Group *mem = &cpu->memory_group;
+    CPU_Group *wb = &cpu->writeback_group;
+    int busy = FALSE;
+    int done = 0;
+
+    cpu->pmemory_group.count = 0;
+    while (done < mem->count)
+    {
+        int zero_flag = cpu->zero_flag;
+        int positive_flag = cpu->positive_flag;
+
+        cpu->memory = mem->slot[done];
+        busy = APEX_memory(cpu);
+        cpu->pmemory_group.slot[cpu->pmemory_group.count++] = cpu->pmemory;
+        if (busy)
+        {
+            break;
+        }
+        if (cpu->config.flag_rename && cpu->writeback.opcode == OPCODE_SC)
+        {
+            wide_sc_flags(cpu, mem, done, zero_flag, positive_flag);
+        }
+        wb->slot[done] = cpu->writeback;
+        wide_bypass(cpu, &cpu->writeback, TRUE, &cpu->mem_bypass[done]);
+        done++;
+    }
+    wb->count = done;
+    cpu->mem_slots = done;
+    mem->count -= done;
+    memmove(mem->slot, mem->slot + done, mem->count * sizeof(CPU_Stage));
+    cpu->mp = cpu->pmemory_group.count > 0;
+    return busy;
+}
+
+/*
+ * Executes the execute group in order, so flags set by an older slot are
+ * seen by a younger branch. A taken branch drops the younger slots and the
+ * decode group, all fetched on the wrong path.
+ */
+static void
+wide_execute(APEX_CPU *cpu)
+{
+    CPU_Group *ex = &cpu->execute_group;
+    CPU_Group *mem = &cpu->memory_group;
+
+    cpu->pexecute_group.count = 0;
+    cpu->ex_slots = 0;
+    for (int i = 0; i < ex->count; ++i)
+    {
+        int redirects = cpu->redirects;
+
+        cpu->execute = ex->slot[i];
+        APEX_execute(cpu);
+        mem->slot[mem->count++] = cpu->memory;
+        cpu->pexecute_group.slot[cpu->pexecute_group.count++] = cpu->pexecute;
+        wide_bypass(cpu, &cpu->memory, FALSE, &cpu->ex_bypass[cpu->ex_slots++]);
+        if (cpu->redirects != redirects)
+        {
+            cpu->decode_group.count = 0;
+            break;
+        }
+    }
+    ex->count = 0;
+    cpu->ep = cpu->pexecute_group.count > 0;
+}
+
+/* Units of the pairing rules an instruction needs */
+static int
+pairing_class(int opcode)
+{
+    switch (opcode)
+    {
+        case OPCODE_LOAD:
+        case OPCODE_STORE:
+        case OPCODE_LDI:
+        case OPCODE_STI:
+        case OPCODE_LL:
+        case OPCODE_SC:
+        case OPCODE_FAA:
+        case OPCODE_FENCE:
+        {
+            return ISSUE_LIMIT_MEMORY;
+        }
+
+        case OPCODE_MUL:
+        case OPCODE_DIV:
+        {
+            return ISSUE_LIMIT_MULTIPLY;
+        }
+
+        case OPCODE_BZ:
+        case OPCODE_BNZ:
+        case OPCODE_BP:
+        case OPCODE_BNP:
+        case OPCODE_JUMP:
+        {
+            return ISSUE_LIMIT_BRANCH;
+        }
+    }
+    return ISSUE_LIMIT_EMPTY;
+}
+
+/*
+ * Pairing rules of config.pairing, those of a cheap in-order dual-issue
+ * pipeline: one data cache port, one multiplier, and branches resolved in
+ * the younger slot only, so nothing issues behind one. Returns the
+ * ISSUE_LIMIT_* keeping slot from issuing with the older slots, or
+ * ISSUE_LIMIT_EMPTY if it pairs.
+ */
+static int
+pairing_conflict(const CPU_Group *dec, int slot)
+{
+    int unit = pairing_class(dec->slot[slot].opcode);
 
+    for (int i = 0; i < slot; ++i)
+    {
+        int older = pairing_class(dec->slot[i].opcode);
+
+        if (older == ISSUE_LIMIT_BRANCH || dec->slot[i].fused)
+        {
+            return ISSUE_LIMIT_BRANCH;
+        }
+        if (older == unit && unit != ISSUE_LIMIT_EMPTY)
+        {
+            return unit;
+        }
+    }
+    return ISSUE_LIMIT_EMPTY;
+}
+
+/* Youngest slot older than slot writing the flags, -1 if none */
+static int
+flag_producer(const CPU_Group *dec, int slot)
+{
+    for (int i = slot - 1; i >= 0; --i)
+    {
+        if (flag_writer(dec->slot[i].opcode))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * The functional units of an older slot of the group that slot would issue
+ * with, once they have started: a unit of its own takes one instruction a
+ * cycle, and its flags are not there yet for a younger branch, renamed
+ * only if it is the branch's producer, or HALT. Returns the
+ * ISSUE_LIMIT_* keeping slot back, or ISSUE_LIMIT_EMPTY.
+ */
+static int
+fu_group_conflict(APEX_CPU *cpu, const CPU_Group *dec, int slot)
+{
+    int op = dec->slot[slot].opcode;
+    int producer = flag_producer(dec, slot);
+
+    for (int i = 0; i < slot; ++i)
+    {
+        int older = dec->slot[i].opcode;
+
+        if (!fu_own_unit(cpu, older))
+        {
+            continue;
+        }
+        if (older == op)
+        {
+            cpu->fu_unit_stalls[op]++;
+            return ISSUE_LIMIT_UNIT;
+        }
+        if (op == OPCODE_HALT)
+        {
+            cpu->fu_result_stalls[older]++;
+            return ISSUE_LIMIT_GROUP;
+        }
+        if (branch_opcode(op) && flag_writer(older)
+            && (!cpu->config.flag_rename || i == producer))
+        {
+            cpu->fu_result_stalls[older]++;
+            cpu->flag_stall_cycles++;
+            return ISSUE_LIMIT_GROUP;
+        }
+    }
+    return ISSUE_LIMIT_EMPTY;
+}
+
+/*
+ * Issues the oldest instructions of the decode group whose operands are
+ * ready, in order: check_stalling decides slot by slot, against the bypass
+ * paths of every slot of execute and memory and against the registers the
+ * older slots issuing with it write, after the pairing rules if enabled
+ * and the functional units the older slots take.
+ * The first slot that cannot issue holds itself and everything younger in
+ * decode, the reason being counted.
+ */
+static void
+wide_decode(APEX_CPU *cpu)
+{
+    CPU_Group *dec = &cpu->decode_group;
+    CPU_Group *ex = &cpu->execute_group;
+    int limit = ISSUE_LIMIT_EMPTY;
+    int issued = 0;
+    int producer;
+
+    cpu->pdecode_group = *dec;
+    cpu->issue_slots = 0;
+    cpu->stall_count = 0;
+    while (issued < dec->count)
+    {
+        if (cpu->config.pairing && (limit = pairing_conflict(dec, issued)) != ISSUE_LIMIT_EMPTY)
+        {
+            break;
+        }
+        if ((limit = fu_group_conflict(cpu, dec, issued)) != ISSUE_LIMIT_EMPTY)
+        {
+            break;
+        }
+
+        /* A branch on the flags of an SC of its group, renamed or not, has
+         * to wait for the SC to set them in memory */
+        producer = flag_producer(dec, issued);
+        if (branch_opcode(dec->slot[issued].opcode) && producer >= 0
+            && dec->slot[producer].opcode == OPCODE_SC)
+        {
+            limit = ISSUE_LIMIT_FLAGS;
+            cpu->flag_stall_cycles++;
+            break;
+        }
+        cpu->decode = dec->slot[issued];
+        check_stalling(cpu);
+        if (cpu->stall_count)
+        {
+            limit = cpu->issue_limit;
+            break;
+        }
+        wide_bypass(cpu, &dec->slot[issued], FALSE, &cpu->issue_dests[cpu->issue_slots++]);
+
+        /* SC sets the flags in memory, after the younger slots of its
+         * group would have executed; unless renamed, they cannot issue */
+        if (dec->slot[issued++].opcode == OPCODE_SC && issued < dec->count
+            && !cpu->config.flag_rename)
+        {
+            limit = ISSUE_LIMIT_FLAGS;
+            cpu->flag_stall_cycles++;
+            break;
+        }
+    }
+    for (int i = 0; i < issued; ++i)
+    {
+        int redirects = cpu->redirects;
+
+        cpu->decode = dec->slot[i];
+        APEX_decode(cpu);
+        decode_resolve(cpu);
+        ex->slot[ex->count++] = cpu->execute;
+
+        /* The younger slots of a branch resolved taken here are on the
+         * wrong path */
+        if (cpu->redirects != redirects)
+        {
+            dec->count = issued = i + 1;
+            break;
+        }
+    }
+    dec->count -= issued;
+    memmove(dec->slot, dec->slot + issued, dec->count * sizeof(CPU_Stage));
+    cpu->dp = cpu->pdecode_group.count > 0;
+
+    cpu->issued[issued]++;
+    if (issued < cpu->config.width)
+    {
+        cpu->issue_limits[limit]++;
+    }
+}
+
+/*
+ * Fills the free slots of the decode group from consecutive pcs. The cycle
+ * after a taken branch fetches nothing, as in the scalar pipeline.
+ */
+static void
+wide_fetch(APEX_CPU *cpu)
+{
+    CPU_Group *dec = &cpu->decode_group;
+
+    cpu->pfetch_group.count = 0;
+    while (dec->count < cpu->config.width && cpu->fetch.has_insn)
+    {
+        int skip = cpu->fetch_from_next_cycle;
+
+        APEX_fetch(cpu);
+        if (skip || !cpu->fp)
+        {
+            break;
+        }
+        dec->slot[dec->count++] = cpu->decode;
+        cpu->pfetch_group.slot[cpu->pfetch_group.count++] = cpu->pfetch;
+    }
+    cpu->fp = cpu->pfetch_group.count > 0;
+}
+
+/*
+ * One cycle of a pipeline config.width wide. Every stage works on a group
+ * of instructions with the scalar stage functions, one slot after the
+ * other; groups move on together, except that decode issues only the
+ * oldest ready part of its group and memory holds the part behind a data
+ * cache miss.
+ */
+static int
+wide_cycle(APEX_CPU *cpu)
+{
+    int stop = wide_writeback(cpu);
+
+    if (wide_memory(cpu))
+    {
+        cpu->mem_stall_cycles++;
+        cpu->pexecute_group = cpu->execute_group;
+        cpu->pdecode_group = cpu->decode_group;
+        cpu->pfetch_group.count = 0;
+        cpu->ep = cpu->execute_group.count > 0;
+        cpu->dp = cpu->decode_group.count > 0;
+        cpu->fp = 0;
+        return stop;
+    }
+    wide_execute(cpu);
+    wide_decode(cpu);
+    wide_fetch(cpu);
+    return stop;
+}
+
+/*
+ * Swaps the architectural state of SMT thread thread into the APEX_CPU
+ * fields the stages work on, saving that of the thread held so far
+ */
+static void
+smt_switch(APEX_CPU *cpu, int thread)
+{
+    APEX_Thread *t = &cpu->threads[cpu->thread];
+
+    if (thread == cpu->thread)
+    {
+        return;
+    }
+    t->pc = cpu->pc;
+    memcpy(t->regs, cpu->regs, sizeof(t->regs));
+    t->zero_flag = cpu->zero_flag;
+    t->positive_flag = cpu->positive_flag;
+    t->fetch_from_next_cycle = cpu->fetch_from_next_cycle;
+    t->fetching = cpu->fetch.has_insn;
+    memcpy(t->reg_ready, cpu->reg_ready, sizeof(t->reg_ready));
+    memcpy(t->reg_unit, cpu->reg_unit, sizeof(t->reg_unit));
+    t->flags_ready = cpu->flags_ready;
+    t->flags_unit = cpu->flags_unit;
+    t->link_addr = cpu->link_addr;
+    t->code_memory_size = cpu->code_memory_size;
+    t->code_memory = cpu->code_memory;
+
+    t = &cpu->threads[thread];
+    cpu->pc = t->pc;
+    memcpy(cpu->regs, t->regs, sizeof(t->regs));
+    cpu->zero_flag = t->zero_flag;
+    cpu->positive_flag = t->positive_flag;
+    cpu->fetch_from_next_cycle = t->fetch_from_next_cycle;
+    cpu->fetch.has_insn = t->fetching;
+    memcpy(cpu->reg_ready, t->reg_ready, sizeof(t->reg_ready));
+    memcpy(cpu->reg_unit, t->reg_unit, sizeof(t->reg_unit));
+    cpu->flags_ready = t->flags_ready;
+    cpu->flags_unit = t->flags_unit;
+    cpu->link_addr = t->link_addr;
+    cpu->code_memory_size = t->code_memory_size;
+    cpu->code_memory = t->code_memory;
+    cpu->thread = thread;
+}
+
+/* Instructions of thread that will be in execute, memory or writeback */
+static int
+smt_in_flight(const APEX_CPU *cpu, int thread)
+{
+    return (cpu->execute.has_insn && cpu->execute.thread == thread)
+           + (cpu->memory.has_insn && cpu->memory.thread == thread)
+           + (cpu->writeback.has_insn && cpu->writeback.thread == thread);
+}
+
+/*
+ * Fetch of an SMT run. Each cycle one thread is fetched, chosen among those
+ * still fetching by config.smt_fetch: ICOUNT takes the thread with the
+ * fewest instructions in flight, round robin the next one after the
+ * thread fetched last, which also breaks ICOUNT ties. A thread redirected
+ * by a taken branch sits out the cycle its own fetch would have skipped,
+ * leaving the slot to the others.
+ */
+static void
+smt_fetch(APEX_CPU *cpu)
+{
+    int n = cpu->config.smt_threads;
+    int best = -1;
+    int best_count = 0;
+
+    for (int k = 1; k <= n; ++k)
+    {
+        int thread = (cpu->fetch_thread + k) % n;
+        APEX_Thread *t = &cpu->threads[thread];
+        int fetching = thread == cpu->thread ? cpu->fetch.has_insn : t->fetching;
+        int *skip = thread == cpu->thread ? &cpu->fetch_from_next_cycle
+                                          : &t->fetch_from_next_cycle;
+        int count;
+
+        if (!fetching)
+        {
+            continue;
+        }
+        if (*skip)
+        {
+            *skip = FALSE;
+            continue;
+        }
+        count = smt_in_flight(cpu, thread);
+        if (best < 0 || (cpu->config.smt_fetch == SMT_FETCH_ICOUNT && count < best_count))
+        {
+            best = thread;
+            best_count = count;
+        }
+    }
+
+    if (best < 0)
+    {
+        cpu->fp = 0;
+        return;
+    }
+    smt_switch(cpu, best);
+    cpu->fetch_thread = best;
+    APEX_fetch(cpu);
+}
+
+/*
+ * Writeback of an SMT run, done in the thread of the retiring instruction.
+ * Returns TRUE once the HALT of every thread retired.
+ */
+static int
+smt_writeback(APEX_CPU *cpu)
+{
+    APEX_Thread *t;
+
+    if (!cpu->writeback.has_insn)
+    {
+        return APEX_writeback(cpu);
+    }
+    smt_switch(cpu, cpu->writeback.thread);
+    t = &cpu->threads[cpu->thread];
+    t->insn_completed++;
+    if (!APEX_writeback(cpu))
+    {
+        return FALSE;
+    }
+    t->halt_cycle = cpu->clock;
+    return ++cpu->halted_threads == cpu->config.smt_threads;
+}
+
+/*
+ * Switches to the thread of the instruction in stage, if any, before the
+ * stage works on it
+ */
+static void
+smt_stage(APEX_CPU *cpu, const CPU_Stage *stage)
+{
+    if (stage->has_insn)
+    {
+        smt_switch(cpu, stage->thread);
+    }
+}
+
+/*
+ * Advances the pipeline by one clock cycle. Stages are called in reverse
+ * order, so every stage sees the latch contents of the previous cycle.
+ *
+ * cpu->clock holds the number of the cycle being simulated, so after the
+ * call it counts the cycles completed so far. Returns TRUE once HALT has
+ * retired from writeback, in an SMT run that of every thread.
+ */
+int
+APEX_cpu_cycle(APEX_CPU *cpu)
+{
+    int smt = cpu->config.smt_threads > 1;
+    int stop;
+
+    cpu->clock++;
+    cpu->wp=1;
+    cpu->mp=1;
+    cpu->ep=1;
+    cpu->dp=1;
+    cpu->fp=1;
+
+    for (int i = 0; i < REG_FILE_SIZE; ++i)
+    {
+        cpu->regf[i]=0;
+    }
+
+    /* The predictor of a decoupled front end runs ahead of fetch */
+    if (cpu->config.frontend == FRONTEND_DECOUPLED)
+    {
+        APEX_frontend_cycle(cpu);
+    }
+
+    if (cpu->config.width > 1)
+    {
+        return wide_cycle(cpu);
+    }
+
+    if (!smt)
+    {
+        stop=APEX_writeback(cpu);
+    }
+    else
+    {
+        stop = smt_writeback(cpu);
+        smt_stage(cpu, &cpu->memory);
+    }
+
+    if (APEX_memory(cpu))
+    {
+        cpu->mem_stall_cycles++;
+        hold_front(cpu);
+        return stop;
+    }
+
+    get_mem_dest(cpu);
+
+    /* Only the instructions of the thread in decode forward to it */
+    if (smt && cpu->memory.thread != cpu->decode.thread)
+    {
+        cpu->mem_dest = -1;
+        cpu->mem_dest1 = -1;
+    }
+    if (smt)
+    {
+        smt_stage(cpu, &cpu->execute);
+    }
+
+    APEX_execute(cpu);
+
+    get_ex_dest(cpu);
+
+    if (smt && cpu->execute.thread != cpu->decode.thread)
+    {
+        cpu->ex_dest = -1;
+        cpu->ex_dest1 = -1;
+    }
+    if (smt)
+    {
+        smt_stage(cpu, &cpu->decode);
+    }
+
+    check_stalling(cpu);
+
+    if(cpu->stall_count==0){
+        APEX_decode(cpu);
+        decode_resolve(cpu);
+        if (smt)
+        {
+            smt_fetch(cpu);
+        }
+        else
+        {
+            APEX_fetch(cpu);
+        }
+    }
+    else{
+        stall_fetch(cpu);
+    }
+
+    return stop;
+}
+
+/*
+ * APEX CPU simulation loop
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+void
+APEX_cpu_run(APEX_CPU *cpu,const char func[],const char cycle[])
+{
+    char user_prompt_val;
+    while (TRUE)
+    {
+        int stop=APEX_cpu_cycle(cpu);
+
+        if(strcmp(func, "display") == 0 || strcmp(func, "single_step") == 0){
+            APEX_cpu_print_pipeline(cpu);
         }
         
         if(strcmp(func, "simulate") == 0 || strcmp(func, "display") == 0){
@@ -1344,13 +2854,12 @@ APEX_cpu_run(APEX_CPU *cpu,char func[],char cycle[])
             }
         }
 
-        //print_reg_file(cpu);
-
         if(stop==TRUE){
 
             if(strcmp(func, "show_mem") == 0){
                 int memloc=atoi(cycle);
-                printf("| MEM[%-4d] | Data Value=%-4d |\n", memloc, cpu->data_memory[memloc]);
+                printf("| MEM[%-4d] | Data Value=%-4d |\n", memloc,
+                       APEX_mem_read(&cpu->data_memory, memloc));
                 break;
             }
 
@@ -1361,9 +2870,7 @@ APEX_cpu_run(APEX_CPU *cpu,char func[],char cycle[])
             }
 
             if(strcmp(func, "display") == 0){
-                printf("\n-----Flag Registers-----\nZero Flag:%d\nPositive Flag:%d\n",cpu->zero_flag,cpu->positive_flag);
-                print_reg_file(cpu);
-                print_data_mem(cpu,10);
+                APEX_cpu_print_state(cpu,10);
                 break;
             }
             
@@ -1371,9 +2878,6 @@ APEX_cpu_run(APEX_CPU *cpu,char func[],char cycle[])
             //printf("APEX_CPU: Simulation Complete, cycles = %d instructions = %d\n", cpu->clock, cpu->insn_completed);
             break;
         }
-        //print_data_mem(cpu);
-
-        cpu->clock++;
 
         if (strcmp(func, "single_step") == 0)
         {
@@ -1388,11 +2892,112 @@ APEX_cpu_run(APEX_CPU *cpu,char func[],char cycle[])
                 break;
             }
         }
+    }
 
-        
+    if (cpu->data_memory.faults)
+    {
+        fprintf(stderr, "APEX_Error: %lld data memory accesses outside [0, %lld) were ignored\n",
+                cpu->data_memory.faults, MEM_WORDS);
     }
 }
 
+/*
+ * Returns the PC of the oldest instruction still in flight, i.e. the next
+ * one to retire. Taken branches flush younger instructions in execute, so
+ * the latches never hold wrong-path instructions at the end of a cycle.
+ */
+int
+APEX_cpu_commit_pc(const APEX_CPU *cpu)
+{
+    if (cpu->config.width > 1)
+    {
+        const CPU_Group *groups[] = { &cpu->writeback_group, &cpu->memory_group,
+                                      &cpu->execute_group, &cpu->decode_group };
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (groups[i]->count)
+            {
+                return groups[i]->slot[0].pc;
+            }
+        }
+        return cpu->pc;
+    }
+    if (cpu->writeback.has_insn)
+    {
+        return cpu->writeback.pc;
+    }
+    if (cpu->memory.has_insn)
+    {
+        return cpu->memory.pc;
+    }
+    if (cpu->execute.has_insn)
+    {
+        return cpu->execute.pc;
+    }
+    if (cpu->decode.has_insn)
+    {
+        return cpu->decode.pc;
+    }
+    return cpu->pc;
+}
+
+/* Counts cpu, a plain struct copy, as one more holder of its tables */
+static void
+cpu_tables_clone(APEX_CPU *cpu)
+{
+    for (int level = 0; level < CACHE_LEVELS; ++level)
+    {
+        APEX_table_clone(cpu->caches.lines[level]);
+    }
+    APEX_table_clone(cpu->frontend.l1i);
+    APEX_table_clone(cpu->frontend.btb);
+    APEX_table_clone(cpu->frontend.itc);
+}
+
+static void
+cpu_tables_release(APEX_CPU *cpu)
+{
+    for (int level = 0; level < CACHE_LEVELS; ++level)
+    {
+        APEX_table_release(&cpu->caches.lines[level]);
+    }
+    APEX_table_release(&cpu->frontend.l1i);
+    APEX_table_release(&cpu->frontend.btb);
+    APEX_table_release(&cpu->frontend.itc);
+}
+
+/*
+ * Copies the complete simulator state, pipeline latches included, so that
+ * dst resumes exactly where src stands. Code memory is read-only after
+ * init and stays shared between the copies, data memory pages and the
+ * cache and predictor tables are shared until either side writes them.
+ *
+ * dst must be zeroed or hold an earlier copy, which is released first.
+ * Copies are given back with APEX_cpu_release.
+ */
+void
+APEX_cpu_copy(APEX_CPU *dst, const APEX_CPU *src)
+{
+    if (dst == src)
+    {
+        return;
+    }
+    APEX_mem_release(&dst->data_memory);
+    cpu_tables_release(dst);
+    *dst = *src;
+    APEX_mem_clone(&dst->data_memory);
+    cpu_tables_clone(dst);
+}
+
+/* Frees the data memory and tables of a copy made with APEX_cpu_copy */
+void
+APEX_cpu_release(APEX_CPU *cpu)
+{
+    APEX_mem_release(&cpu->data_memory);
+    cpu_tables_release(cpu);
+}
+
 /*
  * This function deallocates APEX CPU.
  *
@@ -1401,6 +3006,7 @@ APEX_cpu_run(APEX_CPU *cpu,char func[],char cycle[])
 void
 APEX_cpu_stop(APEX_CPU *cpu)
 {
+    APEX_cpu_release(cpu);
     free(cpu->code_memory);
     free(cpu);
 }
\ No newline at end of file
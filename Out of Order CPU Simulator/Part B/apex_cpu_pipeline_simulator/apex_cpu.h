@@ -37,9 +37,346 @@ typedef struct CPU_Stage
     int result_buffer;
     int result_buffer1;
     int memory_address;
+    int zero_flag;                 /* Flags as left by this instruction in execute */
+    int positive_flag;
+    int trace_info;                /* APEX_TraceRecord.info in trace mode */
+    long trace_index;              /* Trace record fetched, -1 on the wrong path */
+    int thread;                    /* SMT thread it was fetched for */
+    int fused;                     /* A conditional branch was fused into
+                                    * it, one micro-op resolving it in
+                                    * execute once the flags are set */
+    int fused_pc;                  /* pc, opcode and offset of that branch */
+    int fused_opcode;
+    int fused_imm;
+    int pred_pc;                   /* pc fetch went on at behind it */
+    int resolved;                  /* Branch or JUMP resolved in decode */
     int has_insn;
 } CPU_Stage;
 
+/* Architectural effects of one retired instruction */
+typedef struct APEX_Retire
+{
+    int pc;
+    int opcode;
+    int rd;                        /* Register written, -1 if none */
+    int rd_value;
+    int rd1;                       /* Second register written by LDI, -1 if none */
+    int rd1_value;
+    int zero_flag;
+    int positive_flag;
+    int mem_addr;                  /* Data memory word written, -1 if none */
+    int mem_value;
+    int mem_read;                  /* Data memory word read, -1 if none */
+} APEX_Retire;
+
+/* One instruction of a dynamic trace recorded by the functional engine */
+typedef struct APEX_TraceRecord
+{
+    int pc;
+    int info;                      /* Data memory word of loads and stores,
+                                    * TRUE for a taken conditional branch,
+                                    * target of JUMP */
+} APEX_TraceRecord;
+
+/* Sparse data memory: a two-level table of pages allocated on the first
+ * write, shared copy-on-write between copies of the CPU */
+typedef struct APEX_Memory
+{
+    struct APEX_MemPage **dir[MEM_DIRS]; /* MEM_DIR_PAGES pages each, NULL
+                                    * until one of them is written */
+    unsigned read_page;            /* Page of read_words, ~0 if none */
+    const int *read_words;
+    unsigned write_page;           /* Page of write_page_ptr, ~0 if none */
+    struct APEX_MemPage *write_page_ptr; /* Last page written, writable in
+                                    * place while no copy shares it */
+    long long faults;              /* Accesses outside the address space */
+} APEX_Memory;
+
+/* Instructions in one stage of a pipeline wider than 1, oldest first */
+typedef struct CPU_Group
+{
+    int count;
+    CPU_Stage slot[SUPERSCALAR_MAX_WIDTH];
+} CPU_Group;
+
+/* Forwarding path from one slot of a wide pipeline, what mem_dest,
+ * ex_dest and their *1 second destinations are to a single slot */
+typedef struct APEX_Bypass
+{
+    int dest;
+    int value;
+    int dest1;
+    int value1;
+    int load;                      /* dest is loaded, not known yet */
+} APEX_Bypass;
+
+/* Simulator configuration, set from key=value command line options */
+typedef struct APEX_Config
+{
+    int bypass;                    /* BYPASS_* paths forwarding into decode */
+    int cache_line;                /* Data cache line size in bytes */
+    int profile_window;            /* Cycles per working-set sample */
+    int cache_size[CACHE_LEVELS];  /* Bytes, 0 for no such level; no L1D
+                                    * means single-cycle data memory */
+    int cache_ways[CACHE_LEVELS];
+    int cache_latency[CACHE_LEVELS]; /* Cycles of a hit */
+    int mem_latency;               /* Cycles added by a miss in the last
+                                    * level with MEMORY_FLAT */
+    int memory;                    /* MEMORY_* model behind the caches */
+    int dram_channels;
+    int dram_ranks;                /* Per channel */
+    int dram_banks;                /* Per rank */
+    int dram_row_size;             /* Bytes of a row buffer */
+    int dram_tcas;                 /* DRAM timings, in cycles */
+    int dram_trcd;
+    int dram_trp;
+    int dram_tburst;
+    int dram_trefi;
+    int dram_trfc;
+    int prefetch;                  /* PREFETCH_* */
+    int prefetch_level;            /* CACHE_* level the prefetcher fills */
+    int prefetch_degree;           /* Lines fetched ahead */
+    int cores;                     /* Cores of the multicore command */
+    int quantum;                   /* Cycles the cores run between two
+                                    * synchronisations */
+    int coherence;                 /* COHERENCE_* between the L1Ds */
+    int interconnect_latency;      /* Cycles of one hop between an L1D and
+                                    * the directory or another L1D */
+    int smt_threads;               /* Threads of the smt command */
+    int smt_fetch;                 /* SMT_FETCH_* */
+    int width;                     /* Instructions fetched, decoded, issued
+                                    * and retired per cycle */
+    int pairing;                   /* Issue by the pairing rules of an
+                                    * in-order dual-issue pipeline */
+    int fu_latency[OPCODE_COUNT];  /* Cycles until the result of an opcode
+                                    * done in execute can be forwarded */
+    int fu_interval[OPCODE_COUNT]; /* Cycles until its unit takes the next
+                                    * one, 1 if pipelined */
+    int flag_rename;               /* Every flags write has its own copy, so
+                                    * a branch only waits on the last one */
+    int fuse[OPCODE_COUNT];        /* FUSE_* branches an opcode followed by
+                                    * them is fused with */
+    int frontend;                  /* FRONTEND_* */
+    int ftq_size;                  /* Fetch blocks the predictor runs ahead */
+    int btb_entries;
+    int l1i_size;                  /* Bytes, 0 for no instruction cache */
+    int l1i_ways;
+    int l1i_miss_latency;          /* Cycles of an instruction cache fill */
+    int indirect;                  /* INDIRECT_* predictor of JUMP targets */
+    int itc_entries;               /* Entries of its target cache */
+    int ras_reg;                   /* Link register of calls and returns,
+                                    * -1 for no return address stack */
+    int ras_size;
+    int branch_resolve;            /* RESOLVE_* */
+} APEX_Config;
+
+/* One line of a timing-only data cache, the data stays in data_memory */
+typedef struct APEX_CacheLine
+{
+    int line;                      /* Address / cache_line, -1 if invalid */
+    int ready;                     /* Cycle the fill completes */
+    unsigned lru;                  /* Stamp of the last use */
+    char dirty;
+    char prefetched;               /* Filled by the prefetcher, not used yet */
+    char shared;                   /* Other L1Ds may hold it too: S, or O
+                                    * if dirty; a store must upgrade it */
+} APEX_CacheLine;
+
+/* Geometry and counters of one data cache level */
+typedef struct APEX_Cache
+{
+    int num_sets;
+    int ways;
+    unsigned stamp;
+    long long accesses;
+    long long misses;
+    long long writebacks;          /* Dirty lines evicted */
+} APEX_Cache;
+
+/* Reference prediction table entry of the stride prefetcher */
+typedef struct APEX_RptEntry
+{
+    int pc;                        /* 0 if unused */
+    int prev_addr;
+    int stride;
+    int state;
+} APEX_RptEntry;
+
+/* FIFO of lines fetched ahead of a miss stream */
+typedef struct APEX_StreamBuffer
+{
+    int num;                       /* Valid entries, oldest first */
+    int line[PREFETCH_MAX_DEGREE];
+    int ready[PREFETCH_MAX_DEGREE];
+    unsigned lru;
+} APEX_StreamBuffer;
+
+/* Prefetcher state and effectiveness counters */
+typedef struct APEX_Prefetcher
+{
+    APEX_RptEntry rpt[PREFETCH_RPT_SIZE];
+    APEX_StreamBuffer stream[PREFETCH_STREAMS];
+    unsigned stamp;
+    long long issued;              /* Lines requested */
+    long long useful;              /* Prefetched lines later used by a demand access */
+    long long late;                /* Useful ones still in flight at that access */
+    long long late_cycles;         /* Cycles demand accesses waited on them */
+    int late_from;                 /* Cycle the demand access waiting on a
+                                    * DRAM read would have completed, 0 if none */
+} APEX_Prefetcher;
+
+/* Read or write waiting in the DRAM controller queue */
+typedef struct APEX_DramRequest
+{
+    int line;
+    int arrival;                   /* Cycle it reaches the controller */
+    char is_write;
+    char demand;                   /* The memory stage waits for it */
+} APEX_DramRequest;
+
+typedef struct APEX_DramBank
+{
+    int open_row;                  /* -1 if precharged */
+    int ready;                     /* Cycle it can take the next command */
+} APEX_DramBank;
+
+/* DRAM channels behind one FR-FCFS controller queue */
+typedef struct APEX_Dram
+{
+    int time;                      /* Scheduling is decided for every
+                                    * earlier cycle */
+    int num_queued;                /* Oldest first */
+    APEX_DramRequest queue[DRAM_QUEUE_SIZE];
+    APEX_DramBank bank[DRAM_MAX_CHANNELS * DRAM_MAX_RANKS * DRAM_MAX_BANKS];
+    int bus_free[DRAM_MAX_CHANNELS]; /* Cycle each data bus is free */
+    int next_refresh[DRAM_MAX_CHANNELS * DRAM_MAX_RANKS];
+    int demand_done;               /* Cycle the demand read completes */
+    int max_queued;
+    long long reads;
+    long long writes;
+    long long row_hits;
+    long long row_empty;           /* Accesses to a precharged bank */
+    long long row_conflicts;       /* Accesses closing another open row */
+    long long refreshes;
+    long long read_cycles;         /* Arrival to data of every read */
+    long long dropped;             /* Requests refused by a full queue */
+} APEX_Dram;
+
+/* Data cache hierarchy. Only the lines are outside, allocated on the first
+ * access and shared between copies of the CPU (see apex_table.c). */
+typedef struct APEX_Caches
+{
+    int ready;                     /* Geometry taken from the configuration */
+    int line_shift;
+    APEX_Cache level[CACHE_LEVELS];
+    APEX_Prefetcher prefetch;
+    long long mem_reads;           /* Lines read from memory */
+    long long mem_writes;          /* Lines written back to memory */
+    APEX_Dram dram;
+    struct APEX_Table *lines[CACHE_LEVELS]; /* APEX_CacheLine of every level,
+                                    * NULL for none */
+} APEX_Caches;
+
+/* Branch target buffer entry of the decoupled front end */
+typedef struct APEX_BtbEntry
+{
+    int pc;                        /* 0 if unused */
+    int target;                    /* Last target taken */
+    int counter;                   /* 2-bit counter, taken from 2 up */
+    int kind;                      /* BTB_* */
+} APEX_BtbEntry;
+
+/* Indirect target cache entry */
+typedef struct APEX_ItcEntry
+{
+    int pc;                        /* JUMP it holds the target of, 0 if unused */
+    int target;
+} APEX_ItcEntry;
+
+/* Path history and return address stack of the predictor, kept as
+ * predicted ahead of fetch and as resolved in execute */
+typedef struct APEX_PredictState
+{
+    unsigned path;                 /* Targets of the last taken branches */
+    int ras[FRONTEND_RAS_MAX];
+    int ras_top;
+    int ras_count;
+} APEX_PredictState;
+
+/* Outcomes of the JUMP at one pc */
+typedef struct APEX_JumpSite
+{
+    int pc;
+    int kind;                      /* BTB_JUMP, BTB_CALL or BTB_RETURN */
+    long long executed;
+    long long mispredicts;
+} APEX_JumpSite;
+
+/* Fetch target queue entry: consecutive instructions of one instruction
+ * cache line at most, and the pc predicted to follow the last one */
+typedef struct APEX_FetchBlock
+{
+    int pc;                        /* Next one to fetch */
+    int end;                       /* pc of the last one */
+    int next;
+} APEX_FetchBlock;
+
+/* Instruction cache, and the predictor and fetch target queue of the
+ * decoupled front end in front of it. The cache lines and the predictor
+ * tables are allocated on the first cycle, see apex_table.c. */
+typedef struct APEX_Frontend
+{
+    int ready;                     /* Geometry taken from the configuration */
+    int num_sets;
+    unsigned stamp;
+    struct APEX_Table *l1i;        /* APEX_CacheLine, NULL without l1i_size */
+    struct APEX_Table *btb;        /* APEX_BtbEntry, NULL unless decoupled */
+    struct APEX_Table *itc;        /* APEX_ItcEntry, NULL unless decoupled
+                                    * with the target cache */
+    APEX_PredictState spec;        /* Ahead of fetch */
+    APEX_PredictState resolved;    /* Up to the last branch resolved, what
+                                    * spec starts over from on a redirect */
+    APEX_JumpSite jumps[FRONTEND_JUMP_SITES];
+    int num_jumps;
+    APEX_FetchBlock ftq[FRONTEND_FTQ_MAX];
+    int ftq_head;
+    int ftq_count;
+    int predict_pc;                /* pc of the next block to predict */
+    long long l1i_accesses;
+    long long l1i_misses;
+    long long prefetches;          /* Lines filled ahead of fetch */
+    long long prefetch_useful;     /* Of them, later fetched from */
+    long long prefetch_late;       /* Useful ones still in flight then */
+    long long branches;            /* Branches and JUMPs resolved */
+    long long mispredicts;         /* Of them, those fetch went past wrong */
+    int icache_bubbles;            /* Cycles fetch waited on a line */
+    int redirect_bubbles;          /* Cycles fetch had no pc to go on at */
+} APEX_Frontend;
+
+/*
+ * Architectural state of one thread of an SMT run. The state of the thread
+ * a stage works on is swapped into the APEX_CPU fields of the same name,
+ * so only the other threads are current here.
+ */
+typedef struct APEX_Thread
+{
+    int pc;
+    int regs[REG_FILE_SIZE];
+    int zero_flag;
+    int positive_flag;
+    int fetch_from_next_cycle;
+    int fetching;                  /* fetch.has_insn of the thread */
+    int reg_ready[REG_FILE_SIZE];
+    int reg_unit[REG_FILE_SIZE];
+    int flags_ready;
+    int flags_unit;
+    int link_addr;
+    int code_memory_size;
+    APEX_Instruction *code_memory;
+    int insn_completed;            /* Always current, never swapped */
+    int halt_cycle;                /* Cycle its HALT retired, 0 before */
+} APEX_Thread;
+
 /* Model of APEX CPU */
 typedef struct APEX_CPU
 {
@@ -50,7 +387,7 @@ typedef struct APEX_CPU
     int regf[REG_FILE_SIZE];
     int code_memory_size;          /* Number of instruction in the input file */
     APEX_Instruction *code_memory; /* Code Memory */
-    int data_memory[DATA_MEMORY_SIZE]; /* Data Memory */
+    APEX_Memory data_memory;       /* Data Memory */
     int single_step;               /* Wait for user input after every cycle */
     int zero_flag;                 /* {TRUE, FALSE} Used by BZ and BNZ to branch */
     int fetch_from_next_cycle;
@@ -65,11 +402,34 @@ typedef struct APEX_CPU
     int ex_dest1_value;
     int load_in_ex;
     int stall_count;
+    int stall_cycles;              /* Cycles decode spent waiting on operands
+                                    * or a functional unit */
+    int mem_pending;               /* The data access in memory has started */
+    int mem_done;                  /* Cycle it completes, or CACHE_PENDING */
+    int mem_stall_cycles;          /* Cycles memory held the pipeline */
+    int link_addr;                 /* Word reserved by the last LL for SC,
+                                    * -1 if none */
     int wp;
     int mp;
     int ep;
     int dp;
     int fp;
+    APEX_Config config;
+    const APEX_TraceRecord *trace; /* Replayed trace, NULL to execute */
+    long trace_mask;               /* Index mask of a trace ring, ~0 when
+                                    * the whole trace is in memory */
+    long trace_len;                /* Records available to fetch */
+    long trace_pos;                /* Next record to fetch */
+    struct APEX_TraceQueue *trace_queue; /* Live trace source, or NULL */
+    APEX_Caches caches;
+    struct APEX_Core *core;        /* Core of a multicore run, whose L1D
+                                    * misses and stores go to the shared
+                                    * levels; NULL for a single CPU */
+    int thread;                    /* SMT thread whose state is in pc,
+                                    * regs, flags and code_memory */
+    int fetch_thread;              /* SMT thread fetched last */
+    int halted_threads;            /* SMT threads whose HALT retired */
+    APEX_Thread threads[SMT_MAX_THREADS];
 
     /* Pipeline stages */
     CPU_Stage fetch;
@@ -82,10 +442,84 @@ typedef struct APEX_CPU
     CPU_Stage pexecute;
     CPU_Stage pmemory;
     CPU_Stage pwriteback;
+
+    /* Stages of a pipeline wider than 1. The latches above then only hold
+     * the instruction of a group a stage works on. */
+    CPU_Group decode_group;
+    CPU_Group execute_group;
+    CPU_Group memory_group;
+    CPU_Group writeback_group;
+    CPU_Group pfetch_group;        /* What every stage worked on last cycle */
+    CPU_Group pdecode_group;
+    CPU_Group pexecute_group;
+    CPU_Group pmemory_group;
+    CPU_Group pwriteback_group;
+    APEX_Bypass ex_bypass[SUPERSCALAR_MAX_WIDTH]; /* Per slot of execute */
+    int ex_slots;
+    APEX_Bypass mem_bypass[SUPERSCALAR_MAX_WIDTH]; /* Per slot of memory */
+    int mem_slots;
+    APEX_Bypass issue_dests[SUPERSCALAR_MAX_WIDTH]; /* Written by the older
+                                    * slots issuing from decode this cycle */
+    int issue_slots;
+    int issue_limit;               /* ISSUE_LIMIT_* of the last operand found
+                                    * not ready */
+    long long issued[SUPERSCALAR_MAX_WIDTH + 1]; /* Cycles decode issued
+                                    * that many instructions */
+    long long issue_limits[ISSUE_LIMITS]; /* Cycles decode issued fewer
+                                    * than width, by ISSUE_LIMIT_* */
+    int redirects;                 /* Taken branches and JUMPs, those
+                                    * mispredicted with the decoupled
+                                    * front end */
+    int early_resolved;            /* Those resolved in decode */
+    int fetch_resume;              /* First cycle fetch takes the target of
+                                    * one resolved past execute */
+    APEX_Frontend frontend;
+
+    /* Functional units of the opcodes given a latency or interval above 1 */
+    int reg_ready[REG_FILE_SIZE];  /* Cycle decode can have a register
+                                    * written by such a unit from */
+    int reg_unit[REG_FILE_SIZE];   /* Opcode of the unit writing it */
+    int flags_ready;               /* The same for the flags, or with
+                                    * flag_rename for the last write of
+                                    * them by any instruction */
+    int flags_unit;
+    int fu_done;                   /* Cycle every unit has drained */
+    int fu_done_unit;
+    int fu_free[OPCODE_COUNT];     /* Cycle a unit takes the next instruction */
+    int fu_waiting;                /* Unit whose result decode waits on, -1
+                                    * if none */
+    long long fu_issued[OPCODE_COUNT]; /* Instructions executed, by opcode */
+    long long fu_unit_stalls[OPCODE_COUNT]; /* Cycles decode held one for its
+                                    * busy unit */
+    long long fu_result_stalls[OPCODE_COUNT]; /* Cycles decode waited on a
+                                    * result of one */
+    int flag_stall_cycles;         /* Cycles decode held a branch for its
+                                    * flags */
+    long long fused[OPCODE_COUNT][FUSE_BRANCHES]; /* Pairs retired fused */
+    long long fuse_missed[OPCODE_COUNT][FUSE_BRANCHES]; /* Pairs retired
+                                    * one after the other, unfused */
+    int last_retired_pc;           /* pc and opcode of the last one retired */
+    int last_retired_op;
 } APEX_CPU;
 
 APEX_Instruction *create_code_memory(const char *filename, int *size);
-APEX_CPU *APEX_cpu_init(const char *filename);
-void APEX_cpu_run(APEX_CPU *cpu,char func[],char cycle[]);
+void APEX_config_init(APEX_Config *config);
+int APEX_config_set(APEX_Config *config, const char *option);
+const char *APEX_config_bypass_name(int bypass);
+const char *APEX_config_resolve_name(int stage);
+int APEX_config_target(const char **option);
+int APEX_config_check(const APEX_Config *config);
+const char *APEX_config_prefetch_name(int prefetch);
+const char *APEX_config_fu_name(int opcode);
+const char *APEX_config_branch_name(int branch);
+void APEX_config_format(const APEX_Config *config, char *buf, int size);
+APEX_CPU *APEX_cpu_init(const char *filename, const char *data_image, int data_base);
+int APEX_cpu_cycle(APEX_CPU *cpu);
+void APEX_cpu_run(APEX_CPU *cpu,const char func[],const char cycle[]);
+void APEX_cpu_copy(APEX_CPU *dst, const APEX_CPU *src);
+void APEX_cpu_release(APEX_CPU *cpu);
+int APEX_cpu_commit_pc(const APEX_CPU *cpu);
+void APEX_cpu_print_pipeline(const APEX_CPU *cpu);
+void APEX_cpu_print_state(const APEX_CPU *cpu, int mem_size);
 void APEX_cpu_stop(APEX_CPU *cpu);
 #endif
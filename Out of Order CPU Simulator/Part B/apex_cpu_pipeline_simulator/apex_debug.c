@@ -0,0 +1,504 @@
+/*
+ * apex_debug.c
+ * Interactive debugger for the APEX pipeline with breakpoints, watchpoints
+ * and reverse execution
+ *
+ * Reverse execution relies on the simulator being deterministic: the
+ * debugger keeps periodic checkpoints of APEX_CPU and reaches an earlier
+ * cycle by restoring the closest checkpoint before it and replaying
+ * forward. Checkpoints are thinned out as the run grows, so at most
+ * DEBUG_MAX_CHECKPOINTS copies are kept and any cycle is at most one
+ * checkpoint interval of replay away.
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_debug.h"
+#include "apex_macros.h"
+#include "apex_mem.h"
+
+/* Reasons for the debugger to hand control back to the user */
+#define DEBUG_STOP_NONE 0
+#define DEBUG_STOP_BREAK 1
+#define DEBUG_STOP_HALT 2
+
+typedef struct APEX_Debugger
+{
+    APEX_CPU *cpu;
+
+    int pc_bp[DEBUG_MAX_POINTS];     /* Stop when an insn at pc retires */
+    int num_pc_bp;
+    int cycle_bp[DEBUG_MAX_POINTS];  /* Stop after the given cycle */
+    int num_cycle_bp;
+    int mem_bp[DEBUG_MAX_POINTS];    /* Stop when memory stage accesses addr */
+    int num_mem_bp;
+    int watch_addr[DEBUG_MAX_POINTS]; /* Stop when the word at addr changes */
+    int watch_value[DEBUG_MAX_POINTS];
+    int num_watch;
+    int armed;                       /* Total of all the above */
+
+    APEX_CPU *checkpoints;           /* Sorted by clock, checkpoints[0] is cycle 0 */
+    int num_checkpoints;
+    int interval;
+
+    int halt_clock;                  /* Cycle in which HALT retired, -1 if not yet seen */
+    char reason[128];
+} APEX_Debugger;
+
+static int
+debug_halted(const APEX_Debugger *dbg)
+{
+    return dbg->halt_clock >= 0 && dbg->cpu->clock >= dbg->halt_clock;
+}
+
+static void
+debug_sync_watch(APEX_Debugger *dbg)
+{
+    for (int i = 0; i < dbg->num_watch; ++i)
+    {
+        dbg->watch_value[i] = APEX_mem_peek(&dbg->cpu->data_memory, dbg->watch_addr[i]);
+    }
+}
+
+/*
+ * Checks the cycle that just completed against every breakpoint and
+ * watchpoint. Only called when at least one of them is set.
+ */
+static int
+debug_hit(APEX_Debugger *dbg)
+{
+    const APEX_CPU *cpu = dbg->cpu;
+    int hit = FALSE;
+
+    for (int i = 0; i < dbg->num_watch; ++i)
+    {
+        int value = APEX_mem_peek(&cpu->data_memory, dbg->watch_addr[i]);
+
+        if (value != dbg->watch_value[i])
+        {
+            snprintf(dbg->reason, sizeof(dbg->reason),
+                     "Watchpoint MEM[%d]: %d -> %d", dbg->watch_addr[i],
+                     dbg->watch_value[i], value);
+            dbg->watch_value[i] = value;
+            hit = TRUE;
+        }
+    }
+
+    if (cpu->wp == 1)
+    {
+        for (int i = 0; i < dbg->num_pc_bp; ++i)
+        {
+            if (cpu->pwriteback.pc == dbg->pc_bp[i])
+            {
+                snprintf(dbg->reason, sizeof(dbg->reason),
+                         "Breakpoint at pc %d (retired)", dbg->pc_bp[i]);
+                hit = TRUE;
+            }
+        }
+    }
+
+    if (cpu->mp == 1)
+    {
+        switch (cpu->pmemory.opcode)
+        {
+            case OPCODE_LOAD:
+            case OPCODE_LDI:
+            case OPCODE_STORE:
+            case OPCODE_STI:
+            case OPCODE_LL:
+            case OPCODE_SC:
+            case OPCODE_FAA:
+            {
+                for (int i = 0; i < dbg->num_mem_bp; ++i)
+                {
+                    if (cpu->pmemory.memory_address == dbg->mem_bp[i])
+                    {
+                        snprintf(dbg->reason, sizeof(dbg->reason),
+                                 "Memory breakpoint MEM[%d] accessed by pc %d",
+                                 dbg->mem_bp[i], cpu->pmemory.pc);
+                        hit = TRUE;
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < dbg->num_cycle_bp; ++i)
+    {
+        if (cpu->clock == dbg->cycle_bp[i])
+        {
+            snprintf(dbg->reason, sizeof(dbg->reason),
+                     "Breakpoint at cycle %d", dbg->cycle_bp[i]);
+            hit = TRUE;
+        }
+    }
+
+    return hit;
+}
+
+/*
+ * Records a checkpoint every dbg->interval cycles. When the store is full,
+ * every other checkpoint is dropped and the interval doubles.
+ */
+static void
+debug_checkpoint(APEX_Debugger *dbg)
+{
+    const APEX_CPU *last = &dbg->checkpoints[dbg->num_checkpoints - 1];
+
+    if (dbg->cpu->clock % dbg->interval != 0 || dbg->cpu->clock <= last->clock)
+    {
+        return;
+    }
+
+    if (dbg->num_checkpoints == DEBUG_MAX_CHECKPOINTS)
+    {
+        int kept = 0;
+
+        for (int i = 0; i < dbg->num_checkpoints; ++i)
+        {
+            if (dbg->checkpoints[i].clock % (2 * dbg->interval) == 0)
+            {
+                APEX_cpu_copy(&dbg->checkpoints[kept++], &dbg->checkpoints[i]);
+            }
+        }
+        for (int i = kept; i < dbg->num_checkpoints; ++i)
+        {
+            APEX_cpu_release(&dbg->checkpoints[i]);
+        }
+        dbg->num_checkpoints = kept;
+        dbg->interval *= 2;
+
+        if (dbg->cpu->clock % dbg->interval != 0)
+        {
+            return;
+        }
+    }
+
+    APEX_cpu_copy(&dbg->checkpoints[dbg->num_checkpoints++], dbg->cpu);
+}
+
+/*
+ * Simulates forward until cpu->clock reaches target, HALT retires or, when
+ * check is set, a breakpoint or watchpoint fires.
+ */
+static int
+debug_forward(APEX_Debugger *dbg, int target, int check)
+{
+    APEX_CPU *cpu = dbg->cpu;
+
+    while (cpu->clock < target)
+    {
+        if (debug_halted(dbg))
+        {
+            return DEBUG_STOP_HALT;
+        }
+
+        if (APEX_cpu_cycle(cpu))
+        {
+            dbg->halt_clock = cpu->clock;
+        }
+        debug_checkpoint(dbg);
+
+        if (dbg->armed && debug_hit(dbg) && check)
+        {
+            return DEBUG_STOP_BREAK;
+        }
+    }
+
+    return DEBUG_STOP_NONE;
+}
+
+/* Restores the newest checkpoint at or before target and replays up to it */
+static void
+debug_goto(APEX_Debugger *dbg, int target)
+{
+    int i = dbg->num_checkpoints - 1;
+
+    if (target < dbg->cpu->clock)
+    {
+        while (i > 0 && dbg->checkpoints[i].clock > target)
+        {
+            i--;
+        }
+        APEX_cpu_copy(dbg->cpu, &dbg->checkpoints[i]);
+        debug_sync_watch(dbg);
+    }
+
+    debug_forward(dbg, target, FALSE);
+}
+
+/*
+ * Finds the latest cycle before the current one at which a breakpoint or
+ * watchpoint fired, replaying one checkpoint interval at a time backwards.
+ */
+static int
+debug_reverse_continue(APEX_Debugger *dbg)
+{
+    int seg_end = dbg->cpu->clock;
+
+    for (int i = dbg->num_checkpoints - 1; i >= 0; --i)
+    {
+        int found = -1;
+        char reason[sizeof(dbg->reason)];
+
+        if (dbg->checkpoints[i].clock >= seg_end)
+        {
+            continue;
+        }
+
+        APEX_cpu_copy(dbg->cpu, &dbg->checkpoints[i]);
+        debug_sync_watch(dbg);
+
+        while (dbg->cpu->clock < seg_end - 1)
+        {
+            if (debug_forward(dbg, seg_end - 1, TRUE) != DEBUG_STOP_BREAK)
+            {
+                break;
+            }
+            found = dbg->cpu->clock;
+            strcpy(reason, dbg->reason);
+        }
+
+        if (found >= 0)
+        {
+            debug_goto(dbg, found);
+            strcpy(dbg->reason, reason);
+            return DEBUG_STOP_BREAK;
+        }
+        seg_end = dbg->checkpoints[i].clock + 1;
+    }
+
+    debug_goto(dbg, 0);
+    return DEBUG_STOP_NONE;
+}
+
+static int
+debug_add_point(int *points, int *count, int value)
+{
+    if (*count == DEBUG_MAX_POINTS)
+    {
+        printf("Too many breakpoints of this kind (max %d)\n", DEBUG_MAX_POINTS);
+        return FALSE;
+    }
+    points[(*count)++] = value;
+    return TRUE;
+}
+
+static int
+debug_valid_address(int addr)
+{
+    if (!APEX_mem_valid(addr))
+    {
+        printf("Address %d outside data memory [0, %lld)\n", addr, MEM_WORDS);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+debug_print_points(const APEX_Debugger *dbg)
+{
+    for (int i = 0; i < dbg->num_pc_bp; ++i)
+    {
+        printf("break pc %d\n", dbg->pc_bp[i]);
+    }
+    for (int i = 0; i < dbg->num_cycle_bp; ++i)
+    {
+        printf("break cycle %d\n", dbg->cycle_bp[i]);
+    }
+    for (int i = 0; i < dbg->num_mem_bp; ++i)
+    {
+        printf("break mem %d\n", dbg->mem_bp[i]);
+    }
+    for (int i = 0; i < dbg->num_watch; ++i)
+    {
+        printf("watch %d (value %d)\n", dbg->watch_addr[i], dbg->watch_value[i]);
+    }
+    printf("%d checkpoints, one every %d cycles\n", dbg->num_checkpoints,
+           dbg->interval);
+}
+
+static void
+debug_print_help(void)
+{
+    printf("Commands:\n"
+           "  break <pc> | break cycle <n> | break mem <addr>\n"
+           "  watch <addr>          stop when MEM[addr] changes\n"
+           "  delete                remove all breakpoints and watchpoints\n"
+           "  info                  list breakpoints and checkpoints\n"
+           "  step [n]              advance n cycles (default 1)\n"
+           "  continue              run to the next breakpoint or HALT\n"
+           "  rstep [n]             go back n cycles (default 1)\n"
+           "  rcontinue             go back to the previous breakpoint\n"
+           "  goto <cycle>          jump to the end of the given cycle\n"
+           "  pipe | regs | mem <addr> [count]\n"
+           "  quit\n");
+}
+
+static void
+debug_report(APEX_Debugger *dbg, int status)
+{
+    if (dbg->cpu->clock > 0)
+    {
+        APEX_cpu_print_pipeline(dbg->cpu);
+    }
+
+    if (status == DEBUG_STOP_BREAK)
+    {
+        printf("%s\n", dbg->reason);
+    }
+    else if (debug_halted(dbg))
+    {
+        printf("Program halted at cycle %d, instructions retired = %d\n",
+               dbg->halt_clock, dbg->cpu->insn_completed);
+    }
+    else if (dbg->cpu->clock == 0)
+    {
+        printf("At start of program\n");
+    }
+}
+
+/*
+ * Debugger command loop, reads one command per line from stdin
+ */
+void
+APEX_debug_run(APEX_CPU *cpu)
+{
+    APEX_Debugger dbg;
+    char line[256];
+
+    memset(&dbg, 0, sizeof(dbg));
+    dbg.cpu = cpu;
+    dbg.interval = DEBUG_CHECKPOINT_INTERVAL;
+    dbg.halt_clock = -1;
+    dbg.checkpoints = calloc(DEBUG_MAX_CHECKPOINTS, sizeof(APEX_CPU));
+    if (!dbg.checkpoints)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate debugger checkpoints\n");
+        return;
+    }
+    APEX_cpu_copy(&dbg.checkpoints[dbg.num_checkpoints++], cpu);
+
+    printf("APEX debugger, type 'help' for commands\n");
+
+    while (TRUE)
+    {
+        char cmd[32] = "", arg1[32] = "", arg2[32] = "";
+        int status = DEBUG_STOP_NONE;
+
+        printf("(apex %d) ", cpu->clock);
+        fflush(stdout);
+        if (!fgets(line, sizeof(line), stdin))
+        {
+            break;
+        }
+        if (sscanf(line, "%31s %31s %31s", cmd, arg1, arg2) < 1)
+        {
+            continue;
+        }
+
+        if (strcmp(cmd, "break") == 0 || strcmp(cmd, "b") == 0)
+        {
+            if (strcmp(arg1, "cycle") == 0)
+            {
+                dbg.armed += debug_add_point(dbg.cycle_bp, &dbg.num_cycle_bp,
+                                             atoi(arg2));
+            }
+            else if (strcmp(arg1, "mem") == 0)
+            {
+                if (debug_valid_address(atoi(arg2)))
+                {
+                    dbg.armed += debug_add_point(dbg.mem_bp, &dbg.num_mem_bp,
+                                                 atoi(arg2));
+                }
+            }
+            else
+            {
+                dbg.armed += debug_add_point(dbg.pc_bp, &dbg.num_pc_bp, atoi(arg1));
+            }
+        }
+        else if (strcmp(cmd, "watch") == 0 || strcmp(cmd, "w") == 0)
+        {
+            if (debug_valid_address(atoi(arg1))
+                && debug_add_point(dbg.watch_addr, &dbg.num_watch, atoi(arg1)))
+            {
+                dbg.watch_value[dbg.num_watch - 1] = APEX_mem_peek(&cpu->data_memory, atoi(arg1));
+                dbg.armed++;
+            }
+        }
+        else if (strcmp(cmd, "delete") == 0 || strcmp(cmd, "d") == 0)
+        {
+            dbg.num_pc_bp = dbg.num_cycle_bp = dbg.num_mem_bp = dbg.num_watch = 0;
+            dbg.armed = 0;
+        }
+        else if (strcmp(cmd, "info") == 0 || strcmp(cmd, "i") == 0)
+        {
+            debug_print_points(&dbg);
+        }
+        else if (strcmp(cmd, "step") == 0 || strcmp(cmd, "s") == 0)
+        {
+            int n = arg1[0] ? atoi(arg1) : 1;
+
+            status = debug_forward(&dbg, cpu->clock + n, TRUE);
+            debug_report(&dbg, status);
+        }
+        else if (strcmp(cmd, "continue") == 0 || strcmp(cmd, "c") == 0)
+        {
+            status = debug_forward(&dbg, INT_MAX, TRUE);
+            debug_report(&dbg, status);
+        }
+        else if (strcmp(cmd, "rstep") == 0 || strcmp(cmd, "rs") == 0)
+        {
+            int n = arg1[0] ? atoi(arg1) : 1;
+
+            debug_goto(&dbg, cpu->clock > n ? cpu->clock - n : 0);
+            debug_report(&dbg, status);
+        }
+        else if (strcmp(cmd, "rcontinue") == 0 || strcmp(cmd, "rc") == 0)
+        {
+            status = debug_reverse_continue(&dbg);
+            debug_report(&dbg, status);
+        }
+        else if (strcmp(cmd, "goto") == 0 || strcmp(cmd, "g") == 0)
+        {
+            debug_goto(&dbg, atoi(arg1) > 0 ? atoi(arg1) : 0);
+            debug_report(&dbg, status);
+        }
+        else if (strcmp(cmd, "pipe") == 0 || strcmp(cmd, "p") == 0)
+        {
+            debug_report(&dbg, status);
+        }
+        else if (strcmp(cmd, "regs") == 0 || strcmp(cmd, "r") == 0)
+        {
+            APEX_cpu_print_state(cpu, 10);
+        }
+        else if (strcmp(cmd, "mem") == 0 || strcmp(cmd, "x") == 0)
+        {
+            int addr = atoi(arg1);
+            int count = arg2[0] ? atoi(arg2) : 1;
+
+            for (int i = addr; i < addr + count && debug_valid_address(i); ++i)
+            {
+                printf("| MEM[%-4d] | Data Value=%-4d |\n", i, APEX_mem_peek(&cpu->data_memory, i));
+            }
+        }
+        else if (strcmp(cmd, "quit") == 0 || strcmp(cmd, "q") == 0)
+        {
+            break;
+        }
+        else
+        {
+            debug_print_help();
+        }
+    }
+
+    for (int i = 0; i < DEBUG_MAX_CHECKPOINTS; ++i)
+    {
+        APEX_cpu_release(&dbg.checkpoints[i]);
+    }
+    free(dbg.checkpoints);
+}
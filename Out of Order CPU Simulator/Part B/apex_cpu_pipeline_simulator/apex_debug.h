@@ -0,0 +1,11 @@
+/*
+ * apex_debug.h
+ * Contains declarations of the interactive APEX debugger
+ */
+#ifndef _APEX_DEBUG_H_
+#define _APEX_DEBUG_H_
+
+#include "apex_cpu.h"
+
+void APEX_debug_run(APEX_CPU *cpu);
+#endif
@@ -0,0 +1,358 @@
+/*
+ * apex_dram.c
+ * DRAM timing model behind the last data cache level: channels with their
+ * own data bus, ranks and banks with an open row buffer each, periodic
+ * refresh of every rank, and one controller queue scheduled FR-FCFS (the
+ * oldest request that hits an open row first, otherwise the oldest one).
+ *
+ * Lines are mapped row:rank:bank:channel:column, so consecutive lines fill
+ * a row buffer before moving on to the next channel and bank.
+ *
+ * Scheduling is decided lazily: requests only wait in the queue until some
+ * caller needs a later cycle, then every decision up to that cycle is made
+ * in order. A read is only known to complete once it is scheduled; until
+ * then the cache lines waiting for it hold CACHE_PENDING.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "apex_cache.h"
+#include "apex_dram.h"
+#include "apex_macros.h"
+
+static int
+rank_index(int channel, int rank)
+{
+    return channel * DRAM_MAX_RANKS + rank;
+}
+
+/* Splits line into its channel, bank (index into APEX_Dram.bank) and row */
+static void
+dram_map(const APEX_Config *config, int line, int *channel, int *bank, int *row)
+{
+    int rest = line / (config->dram_row_size / config->cache_line);
+    int rank;
+
+    *channel = rest % config->dram_channels;
+    rest /= config->dram_channels;
+    *bank = rest % config->dram_banks;
+    rest /= config->dram_banks;
+    rank = rest % config->dram_ranks;
+    *row = rest / config->dram_ranks;
+    *bank += rank_index(*channel, rank) * DRAM_MAX_BANKS;
+}
+
+void
+APEX_dram_init(APEX_CPU *cpu)
+{
+    APEX_Dram *d = &cpu->caches.dram;
+
+    for (int i = 0; i < DRAM_MAX_CHANNELS * DRAM_MAX_RANKS * DRAM_MAX_BANKS; ++i)
+    {
+        d->bank[i].open_row = -1;
+    }
+    /* Ranks of a channel refresh in turn */
+    for (int ch = 0; ch < DRAM_MAX_CHANNELS; ++ch)
+    {
+        for (int rank = 0; rank < DRAM_MAX_RANKS; ++rank)
+        {
+            d->next_refresh[rank_index(ch, rank)]
+                = cpu->config.dram_trefi
+                  + rank * cpu->config.dram_trefi / cpu->config.dram_ranks;
+        }
+    }
+    d->demand_done = CACHE_PENDING;
+}
+
+/* Refreshes every rank due by cycle t, closing all of its rows */
+static void
+dram_refresh(APEX_CPU *cpu, int t)
+{
+    const APEX_Config *config = &cpu->config;
+    APEX_Dram *d = &cpu->caches.dram;
+
+    if (!config->dram_trefi)
+    {
+        return;
+    }
+    for (int ch = 0; ch < config->dram_channels; ++ch)
+    {
+        for (int rank = 0; rank < config->dram_ranks; ++rank)
+        {
+            int *next = &d->next_refresh[rank_index(ch, rank)];
+
+            while (*next <= t)
+            {
+                APEX_DramBank *bank = &d->bank[rank_index(ch, rank) * DRAM_MAX_BANKS];
+
+                for (int b = 0; b < config->dram_banks; ++b)
+                {
+                    bank[b].ready = (bank[b].ready > *next ? bank[b].ready : *next)
+                                    + config->dram_trfc;
+                    bank[b].open_row = -1;
+                }
+                d->refreshes++;
+                *next += config->dram_trefi;
+            }
+        }
+    }
+}
+
+/*
+ * Issues at most one request of channel at cycle t: the oldest row hit
+ * among the requests whose bank is free, or else the oldest of them.
+ */
+static void
+dram_schedule(APEX_CPU *cpu, int channel, int t)
+{
+    const APEX_Config *config = &cpu->config;
+    APEX_Dram *d = &cpu->caches.dram;
+    APEX_DramRequest req;
+    APEX_DramBank *bank;
+    int best = -1;
+    int best_hit = FALSE;
+    int best_bank = 0, best_row = 0;
+    int latency, start, done;
+
+    for (int i = 0; i < d->num_queued && !best_hit; ++i)
+    {
+        int ch, b, row;
+
+        if (d->queue[i].arrival > t)
+        {
+            continue;
+        }
+        dram_map(config, d->queue[i].line, &ch, &b, &row);
+        if (ch != channel || d->bank[b].ready > t)
+        {
+            continue;
+        }
+        if (best < 0 || d->bank[b].open_row == row)
+        {
+            best = i;
+            best_hit = d->bank[b].open_row == row;
+            best_bank = b;
+            best_row = row;
+        }
+    }
+    if (best < 0)
+    {
+        return;
+    }
+
+    req = d->queue[best];
+    for (int i = best + 1; i < d->num_queued; ++i)
+    {
+        d->queue[i - 1] = d->queue[i];
+    }
+    d->num_queued--;
+
+    bank = &d->bank[best_bank];
+    if (best_hit)
+    {
+        latency = config->dram_tcas;
+        d->row_hits++;
+    }
+    else if (bank->open_row < 0)
+    {
+        latency = config->dram_trcd + config->dram_tcas;
+        d->row_empty++;
+    }
+    else
+    {
+        latency = config->dram_trp + config->dram_trcd + config->dram_tcas;
+        d->row_conflicts++;
+    }
+    bank->open_row = best_row;
+    /* The next column command may follow one burst after this one */
+    bank->ready = t + latency - config->dram_tcas + config->dram_tburst;
+
+    start = t + latency;
+    if (start < d->bus_free[channel])
+    {
+        start = d->bus_free[channel];
+    }
+    done = start + config->dram_tburst;
+    d->bus_free[channel] = done;
+
+    if (req.is_write)
+    {
+        d->writes++;
+        return;
+    }
+    d->reads++;
+    d->read_cycles += done - req.arrival;
+    APEX_cache_resolve(cpu, req.line, done);
+    if (req.demand)
+    {
+        d->demand_done = done;
+    }
+}
+
+/*
+ * Makes every scheduling decision of the cycles before until. Requests
+ * are only added with an arrival cycle no earlier than the current one, so
+ * those decisions are final.
+ */
+void
+APEX_dram_advance(APEX_CPU *cpu, int until)
+{
+    const APEX_Config *config = &cpu->config;
+    APEX_Dram *d = &cpu->caches.dram;
+
+    while (d->time < until)
+    {
+        int t = d->time;
+        int next = until;
+
+        dram_refresh(cpu, t);
+        for (int ch = 0; ch < config->dram_channels; ++ch)
+        {
+            dram_schedule(cpu, ch, t);
+        }
+
+        /* Skip to the next cycle a request could issue */
+        for (int i = 0; i < d->num_queued; ++i)
+        {
+            int ch, b, row;
+            int when = d->queue[i].arrival;
+
+            dram_map(config, d->queue[i].line, &ch, &b, &row);
+            if (d->bank[b].ready > when)
+            {
+                when = d->bank[b].ready;
+            }
+            if (when <= t)
+            {
+                when = t + 1;
+            }
+            if (when < next)
+            {
+                next = when;
+            }
+        }
+        if (d->num_queued && config->dram_trefi)
+        {
+            for (int ch = 0; ch < config->dram_channels; ++ch)
+            {
+                for (int rank = 0; rank < config->dram_ranks; ++rank)
+                {
+                    if (d->next_refresh[rank_index(ch, rank)] < next)
+                    {
+                        next = d->next_refresh[rank_index(ch, rank)];
+                    }
+                }
+            }
+        }
+        d->time = next;
+    }
+}
+
+static int
+dram_enqueue(APEX_CPU *cpu, int line, int arrival, int is_write, int reserve)
+{
+    APEX_Dram *d = &cpu->caches.dram;
+    APEX_DramRequest *req;
+
+    if (d->num_queued >= DRAM_QUEUE_SIZE - reserve)
+    {
+        d->dropped++;
+        return FALSE;
+    }
+    req = &d->queue[d->num_queued++];
+    req->line = line;
+    req->arrival = arrival;
+    req->is_write = is_write;
+    req->demand = FALSE;
+    if (d->num_queued > d->max_queued)
+    {
+        d->max_queued = d->num_queued;
+    }
+    return TRUE;
+}
+
+/*
+ * Queues a read of line reaching the controller at cycle arrival. Its
+ * completion is handed to APEX_cache_resolve once it is scheduled.
+ *
+ * Returns FALSE if the queue is full; prefetches keep DRAM_QUEUE_RESERVE
+ * entries free for demand reads.
+ */
+int
+APEX_dram_read(APEX_CPU *cpu, int line, int arrival, int prefetch)
+{
+    return dram_enqueue(cpu, line, arrival, FALSE, prefetch ? DRAM_QUEUE_RESERVE : 0);
+}
+
+/* Queues the write back of a dirty line, which nothing waits for */
+void
+APEX_dram_write(APEX_CPU *cpu, int line, int arrival)
+{
+    dram_enqueue(cpu, line, arrival, TRUE, DRAM_QUEUE_RESERVE);
+}
+
+/*
+ * Returns the cycles a read of line would take if it issued right away:
+ * the row activation it needs given the open rows, then the data burst.
+ */
+int
+APEX_dram_latency(const APEX_CPU *cpu, int line)
+{
+    const APEX_Config *config = &cpu->config;
+    int channel, b, row;
+    int open_row;
+
+    dram_map(config, line, &channel, &b, &row);
+    open_row = cpu->caches.dram.bank[b].open_row;
+    if (open_row == row)
+    {
+        return config->dram_tcas + config->dram_tburst;
+    }
+    if (open_row < 0)
+    {
+        return config->dram_trcd + config->dram_tcas + config->dram_tburst;
+    }
+    return config->dram_trp + config->dram_trcd + config->dram_tcas + config->dram_tburst;
+}
+
+/*
+ * Marks the oldest queued read of line as the one the memory stage waits
+ * for; demand_done gets its completion cycle once it is scheduled.
+ */
+void
+APEX_dram_demand(APEX_CPU *cpu, int line)
+{
+    APEX_Dram *d = &cpu->caches.dram;
+
+    for (int i = 0; i < d->num_queued; ++i)
+    {
+        if (d->queue[i].line == line && !d->queue[i].is_write)
+        {
+            d->queue[i].demand = TRUE;
+            d->demand_done = CACHE_PENDING;
+            return;
+        }
+    }
+    d->demand_done = cpu->clock;
+}
+
+static double
+ratio(long long part, long long whole)
+{
+    return whole ? (double)part / whole : 0.0;
+}
+
+void
+APEX_dram_print_stats(const APEX_CPU *cpu)
+{
+    const APEX_Dram *d = &cpu->caches.dram;
+    long long accesses = d->row_hits + d->row_empty + d->row_conflicts;
+
+    printf("dram: %lld reads, %lld writes, row hits %.2f%%, empty %.2f%%, "
+           "conflicts %.2f%%, %lld refreshes\n",
+           d->reads, d->writes, 100.0 * ratio(d->row_hits, accesses),
+           100.0 * ratio(d->row_empty, accesses),
+           100.0 * ratio(d->row_conflicts, accesses), d->refreshes);
+    printf("dram: average read latency %.1f cycles, peak queue %d, %lld dropped\n",
+           ratio(d->read_cycles, d->reads), d->max_queued, d->dropped);
+}
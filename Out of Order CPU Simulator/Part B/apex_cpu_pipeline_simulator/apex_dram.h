@@ -0,0 +1,17 @@
+/*
+ * apex_dram.h
+ * Contains declarations of the DRAM timing model behind the data caches
+ */
+#ifndef _APEX_DRAM_H_
+#define _APEX_DRAM_H_
+
+#include "apex_cpu.h"
+
+void APEX_dram_init(APEX_CPU *cpu);
+void APEX_dram_advance(APEX_CPU *cpu, int until);
+int APEX_dram_read(APEX_CPU *cpu, int line, int arrival, int prefetch);
+void APEX_dram_write(APEX_CPU *cpu, int line, int arrival);
+int APEX_dram_latency(const APEX_CPU *cpu, int line);
+void APEX_dram_demand(APEX_CPU *cpu, int line);
+void APEX_dram_print_stats(const APEX_CPU *cpu);
+#endif
@@ -0,0 +1,688 @@
+/*
+ * apex_frontend.c
+ * Front end of the pipeline: an instruction cache in front of fetch and,
+ * with FRONTEND_DECOUPLED, a branch predictor running ahead of fetch.
+ *
+ * The coupled front end is the original one: fetch goes on at the next pc
+ * and a taken branch sends it to its target from the cycle after it
+ * resolves. The decoupled one predicts a fetch block every cycle, the
+ * instructions up to the end of a cache line or the first branch its
+ * branch target buffer takes, and queues them in a fetch target queue of
+ * config.ftq_size blocks. Fetch works down the queue, and the lines of the
+ * blocks queued behind the one it fetches from are prefetched into the
+ * instruction cache. A branch resolved in execute only redirects fetch
+ * when fetch went on at the wrong pc behind it; the queue is then flushed
+ * and the predictor starts over at the right one.
+ *
+ * The target of a JUMP is the last one the branch target buffer saw, or
+ * with INDIRECT_TARGET_CACHE the one a target cache holds for the JUMP
+ * reached by the path of the last taken branches. With config.ras_reg, a
+ * JUMP through that register is a return, predicted by a return address
+ * stack, and a JUMP right behind a MOVC to it a call, pushing the pc after
+ * it. Path and stack are kept as predicted and as resolved, and a redirect
+ * starts the predicted ones over from the resolved ones.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "apex_cpu.h"
+#include "apex_frontend.h"
+#include "apex_macros.h"
+#include "apex_table.h"
+
+/* Code memory index of pc, -1 outside the program */
+static int
+code_index(const APEX_CPU *cpu, int pc)
+{
+    int index = (pc - 4000) / 4;
+
+    return pc >= 4000 && index < cpu->code_memory_size ? index : -1;
+}
+
+/*
+ * Kind of the branch at pc, told apart with the ras_reg convention: a
+ * return jumps through ras_reg, a call is the JUMP right behind a MOVC
+ * loading it with the return address
+ */
+static int
+branch_kind(const APEX_CPU *cpu, int pc)
+{
+    int index = code_index(cpu, pc);
+    const APEX_Instruction *insn;
+
+    if (index < 0 || cpu->code_memory[index].opcode != OPCODE_JUMP)
+    {
+        return BTB_BRANCH;
+    }
+    insn = &cpu->code_memory[index];
+    if (cpu->config.ras_reg < 0)
+    {
+        return BTB_JUMP;
+    }
+    if (insn->rs1 == cpu->config.ras_reg)
+    {
+        return BTB_RETURN;
+    }
+    if (index > 0 && cpu->code_memory[index - 1].opcode == OPCODE_MOVC
+        && cpu->code_memory[index - 1].rd == cpu->config.ras_reg)
+    {
+        return BTB_CALL;
+    }
+    return BTB_JUMP;
+}
+
+/* Sets the geometry up from the configuration, done on the first cycle */
+static void
+frontend_init(APEX_CPU *cpu)
+{
+    APEX_Frontend *f = &cpu->frontend;
+    int num_lines = cpu->config.l1i_size / cpu->config.cache_line;
+    APEX_CacheLine *lines = APEX_table_alloc(&f->l1i, num_lines * sizeof(APEX_CacheLine));
+
+    f->num_sets = num_lines / cpu->config.l1i_ways;
+    for (int i = 0; i < num_lines; ++i)
+    {
+        lines[i].line = -1;
+    }
+    if (cpu->config.frontend == FRONTEND_DECOUPLED)
+    {
+        APEX_table_alloc(&f->btb, cpu->config.btb_entries * sizeof(APEX_BtbEntry));
+    }
+    if (cpu->config.frontend == FRONTEND_DECOUPLED
+        && cpu->config.indirect == INDIRECT_TARGET_CACHE)
+    {
+        APEX_table_alloc(&f->itc, cpu->config.itc_entries * sizeof(APEX_ItcEntry));
+    }
+    f->predict_pc = cpu->pc;
+    f->ready = TRUE;
+}
+
+/* Instruction cache line holding line, NULL if it is not there */
+static APEX_CacheLine *
+l1i_lookup(APEX_CPU *cpu, int line)
+{
+    APEX_Frontend *f = &cpu->frontend;
+    APEX_CacheLine *set = (APEX_CacheLine *)APEX_table_write(&f->l1i)
+                          + (line & (f->num_sets - 1)) * cpu->config.l1i_ways;
+
+    for (int way = 0; way < cpu->config.l1i_ways; ++way)
+    {
+        if (set[way].line == line)
+        {
+            return &set[way];
+        }
+    }
+    return NULL;
+}
+
+/* Way line is filled into: an invalid one, or the least recently used */
+static APEX_CacheLine *
+l1i_victim(APEX_CPU *cpu, int line)
+{
+    APEX_Frontend *f = &cpu->frontend;
+    APEX_CacheLine *set = (APEX_CacheLine *)APEX_table_write(&f->l1i)
+                          + (line & (f->num_sets - 1)) * cpu->config.l1i_ways;
+    APEX_CacheLine *victim = &set[0];
+
+    for (int way = 1; way < cpu->config.l1i_ways; ++way)
+    {
+        if (set[way].line == -1 || (victim->line != -1 && set[way].lru < victim->lru))
+        {
+            victim = &set[way];
+        }
+    }
+    return victim;
+}
+
+/* Starts the fill of line into way victim */
+static APEX_CacheLine *
+l1i_fill(APEX_CPU *cpu, APEX_CacheLine *victim, int line, int prefetched)
+{
+    victim->line = line;
+    victim->ready = cpu->clock + cpu->config.l1i_miss_latency;
+    victim->lru = ++cpu->frontend.stamp;
+    victim->prefetched = prefetched;
+    return victim;
+}
+
+/* Branch target buffer entry pc maps to */
+static APEX_BtbEntry *
+btb_slot(APEX_CPU *cpu, int pc)
+{
+    APEX_BtbEntry *btb = APEX_table_write(&cpu->frontend.btb);
+
+    return &btb[(pc / 4) & (cpu->config.btb_entries - 1)];
+}
+
+/* Branch target buffer entry of the branch at pc, NULL if it has none */
+static APEX_BtbEntry *
+btb_lookup(APEX_CPU *cpu, int pc)
+{
+    APEX_BtbEntry *e = btb_slot(cpu, pc);
+
+    return e->pc == pc ? e : NULL;
+}
+
+/* Target cache entry of the JUMP at pc reached by path */
+static APEX_ItcEntry *
+itc_entry(APEX_CPU *cpu, int pc, unsigned path)
+{
+    APEX_ItcEntry *itc = APEX_table_write(&cpu->frontend.itc);
+
+    return &itc[((pc / 4) ^ path) & (cpu->config.itc_entries - 1)];
+}
+
+static void
+ras_push(APEX_CPU *cpu, APEX_PredictState *state, int pc)
+{
+    state->ras_top = (state->ras_top + 1) % cpu->config.ras_size;
+    state->ras[state->ras_top] = pc;
+    state->ras_count += state->ras_count < cpu->config.ras_size;
+}
+
+static void
+ras_pop(APEX_CPU *cpu, APEX_PredictState *state)
+{
+    if (state->ras_count)
+    {
+        state->ras_top = (state->ras_top + cpu->config.ras_size - 1) % cpu->config.ras_size;
+        state->ras_count--;
+    }
+}
+
+/*
+ * Moves state past the taken branch at pc of the given kind going to
+ * target: the call or return done on the stack, the target into the path
+ */
+static void
+follow_branch(APEX_CPU *cpu, APEX_PredictState *state, int pc, int kind, int target)
+{
+    if (kind == BTB_CALL)
+    {
+        ras_push(cpu, state, pc + 4);
+    }
+    else if (kind == BTB_RETURN)
+    {
+        ras_pop(cpu, state);
+    }
+    state->path = ((state->path << 3) ^ (unsigned)(target / 4)) & 0xffff;
+}
+
+/*
+ * Target predicted for the branch at pc with entry e: the top of the
+ * return address stack for a return, the target cache's for a JUMP or a
+ * call when it has one, the one in the entry otherwise
+ */
+static int
+predict_target(APEX_CPU *cpu, const APEX_BtbEntry *e, int pc)
+{
+    APEX_Frontend *f = &cpu->frontend;
+
+    if (e->kind == BTB_RETURN && f->spec.ras_count)
+    {
+        return f->spec.ras[f->spec.ras_top];
+    }
+    if (e->kind != BTB_BRANCH && cpu->config.indirect == INDIRECT_TARGET_CACHE)
+    {
+        const APEX_ItcEntry *t = itc_entry(cpu, pc, f->spec.path);
+
+        if (t->pc == pc)
+        {
+            return t->target;
+        }
+    }
+    return e->target;
+}
+
+/* Outcomes of the JUMP at pc, NULL once FRONTEND_JUMP_SITES are counted */
+static APEX_JumpSite *
+jump_site(APEX_CPU *cpu, int pc, int kind)
+{
+    APEX_Frontend *f = &cpu->frontend;
+
+    for (int i = 0; i < f->num_jumps; ++i)
+    {
+        if (f->jumps[i].pc == pc)
+        {
+            return &f->jumps[i];
+        }
+    }
+    if (f->num_jumps == FRONTEND_JUMP_SITES)
+    {
+        return NULL;
+    }
+    f->jumps[f->num_jumps].pc = pc;
+    f->jumps[f->num_jumps].kind = kind;
+    return &f->jumps[f->num_jumps++];
+}
+
+/*
+ * Predicts the block from predict_pc on: the instructions up to the end of
+ * its line, the end of the program or the first branch predicted taken.
+ * Stalls while the queue is full or the predictor ran off the program.
+ */
+static void
+predict_block(APEX_CPU *cpu)
+{
+    APEX_Frontend *f = &cpu->frontend;
+    APEX_FetchBlock *block;
+    int pc = f->predict_pc;
+
+    if (f->ftq_count == cpu->config.ftq_size || code_index(cpu, pc) < 0)
+    {
+        return;
+    }
+    block = &f->ftq[(f->ftq_head + f->ftq_count++) % FRONTEND_FTQ_MAX];
+    block->pc = pc;
+    for (;;)
+    {
+        const APEX_BtbEntry *e = btb_lookup(cpu, pc);
+
+        block->end = pc;
+        if (e && e->counter >= 2)
+        {
+            block->next = predict_target(cpu, e, pc);
+            follow_branch(cpu, &f->spec, pc, e->kind, block->next);
+            break;
+        }
+        block->next = pc + 4;
+        if (code_index(cpu, pc + 4) < 0
+            || (pc + 4) / cpu->config.cache_line != pc / cpu->config.cache_line)
+        {
+            break;
+        }
+        pc += 4;
+    }
+    f->predict_pc = block->next;
+}
+
+/*
+ * Starts the fill of the first line of a queued block not in the cache
+ * yet. It waits while it would evict a line still being filled or the one
+ * fetch works on, so that the two cannot keep evicting each other.
+ */
+static void
+prefetch_ahead(APEX_CPU *cpu)
+{
+    APEX_Frontend *f = &cpu->frontend;
+    int head = f->ftq[f->ftq_head].pc / cpu->config.cache_line;
+
+    for (int i = 0; i < f->ftq_count; ++i)
+    {
+        int line = f->ftq[(f->ftq_head + i) % FRONTEND_FTQ_MAX].pc / cpu->config.cache_line;
+        APEX_CacheLine *victim;
+
+        if (l1i_lookup(cpu, line))
+        {
+            continue;
+        }
+        victim = l1i_victim(cpu, line);
+        if (victim->line == -1 || (victim->ready <= cpu->clock && victim->line != head))
+        {
+            l1i_fill(cpu, victim, line, TRUE);
+            f->prefetches++;
+        }
+        return;
+    }
+}
+
+/*
+ * Work of the decoupled front end ahead of fetch in a cycle: the next
+ * block predicted, then one instruction cache line prefetched. After a
+ * branch resolved past execute the predictor waits with fetch.
+ */
+void
+APEX_frontend_cycle(APEX_CPU *cpu)
+{
+    if (!cpu->frontend.ready)
+    {
+        frontend_init(cpu);
+    }
+    if (cpu->clock < cpu->fetch_resume)
+    {
+        return;
+    }
+    predict_block(cpu);
+    if (cpu->config.l1i_size)
+    {
+        prefetch_ahead(cpu);
+    }
+}
+
+/*
+ * Returns TRUE when fetch can take an instruction this cycle, setting pc
+ * to it with the decoupled front end. Counts the cycle as a bubble
+ * otherwise: fetch waits on the instruction cache line of pc, or has no
+ * block queued after a redirect.
+ */
+int
+APEX_frontend_fetch(APEX_CPU *cpu)
+{
+    APEX_Frontend *f = &cpu->frontend;
+    APEX_CacheLine *entry;
+    int line;
+
+    if (!f->ready)
+    {
+        frontend_init(cpu);
+    }
+    if (cpu->config.frontend == FRONTEND_DECOUPLED)
+    {
+        if (!f->ftq_count)
+        {
+            f->redirect_bubbles++;
+            return FALSE;
+        }
+        cpu->pc = f->ftq[f->ftq_head].pc;
+    }
+    if (!cpu->config.l1i_size)
+    {
+        return TRUE;
+    }
+
+    line = cpu->pc / cpu->config.cache_line;
+    entry = l1i_lookup(cpu, line);
+    if (!entry)
+    {
+        f->l1i_misses++;
+        entry = l1i_fill(cpu, l1i_victim(cpu, line), line, FALSE);
+    }
+    else if (entry->prefetched)
+    {
+        f->prefetch_useful++;
+        f->prefetch_late += entry->ready > cpu->clock;
+        entry->prefetched = FALSE;
+    }
+    if (entry->ready > cpu->clock)
+    {
+        f->icache_bubbles++;
+        return FALSE;
+    }
+    f->l1i_accesses++;
+    entry->lru = ++f->stamp;
+    return TRUE;
+}
+
+/*
+ * Returns TRUE when the instruction at pc, right behind the one just
+ * fetched, can be fetched in the same cycle without a bubble
+ */
+int
+APEX_frontend_ready(APEX_CPU *cpu)
+{
+    const APEX_Frontend *f = &cpu->frontend;
+    const APEX_CacheLine *entry;
+
+    if (cpu->config.frontend == FRONTEND_DECOUPLED
+        && (!f->ftq_count || f->ftq[f->ftq_head].pc != cpu->pc))
+    {
+        return FALSE;
+    }
+    if (!cpu->config.l1i_size)
+    {
+        return TRUE;
+    }
+    entry = l1i_lookup(cpu, cpu->pc / cpu->config.cache_line);
+    return entry && entry->ready <= cpu->clock;
+}
+
+/*
+ * Moves fetch past the instruction at pc, returning the pc it goes on at:
+ * the next one, or with the decoupled front end the one predicted
+ */
+int
+APEX_frontend_next(APEX_CPU *cpu)
+{
+    APEX_Frontend *f = &cpu->frontend;
+    APEX_FetchBlock *block = &f->ftq[f->ftq_head];
+
+    if (cpu->config.frontend != FRONTEND_DECOUPLED)
+    {
+        return cpu->pc + 4;
+    }
+    if (block->pc != block->end)
+    {
+        block->pc += 4;
+        return block->pc;
+    }
+    f->ftq_head = (f->ftq_head + 1) % FRONTEND_FTQ_MAX;
+    f->ftq_count--;
+    return block->next;
+}
+
+/*
+ * Flushes the blocks predicted and starts the predictor over at target,
+ * with the path and return address stack of the branches resolved
+ */
+void
+APEX_frontend_redirect(APEX_CPU *cpu, int target)
+{
+    cpu->frontend.ftq_count = 0;
+    cpu->frontend.predict_pc = target;
+    cpu->frontend.spec = cpu->frontend.resolved;
+}
+
+/*
+ * Counts the branch or JUMP at pc resolved in execute and trains the
+ * predictor with it: a taken one gets a branch target buffer entry, weakly
+ * taken, a JUMP the target cache entry of the path that led to it
+ */
+void
+APEX_frontend_resolve(APEX_CPU *cpu, int pc, int taken, int target, int mispredicted)
+{
+    APEX_Frontend *f = &cpu->frontend;
+    int kind = branch_kind(cpu, pc);
+    APEX_JumpSite *site;
+    APEX_BtbEntry *e;
+
+    f->branches++;
+    f->mispredicts += mispredicted;
+    if (kind != BTB_BRANCH && (site = jump_site(cpu, pc, kind)))
+    {
+        site->executed++;
+        site->mispredicts += mispredicted;
+    }
+    if (cpu->config.frontend != FRONTEND_DECOUPLED)
+    {
+        return;
+    }
+    if (kind != BTB_BRANCH && cpu->config.indirect == INDIRECT_TARGET_CACHE)
+    {
+        APEX_ItcEntry *t = itc_entry(cpu, pc, f->resolved.path);
+
+        t->pc = pc;
+        t->target = target;
+    }
+    if (taken)
+    {
+        follow_branch(cpu, &f->resolved, pc, kind, target);
+    }
+    e = btb_lookup(cpu, pc);
+    if (!e)
+    {
+        if (taken)
+        {
+            e = btb_slot(cpu, pc);
+            e->pc = pc;
+            e->target = target;
+            e->counter = 2;
+            e->kind = kind;
+        }
+        return;
+    }
+    if (taken)
+    {
+        e->target = target;
+        e->counter += e->counter < 3;
+    }
+    else
+    {
+        e->counter -= e->counter > 0;
+    }
+}
+
+static void
+run_until_halt(APEX_CPU *cpu, int max_cycles)
+{
+    while (!APEX_cpu_cycle(cpu) && cpu->clock != max_cycles)
+    {
+    }
+}
+
+static void
+print_run(const char *name, const APEX_CPU *cpu)
+{
+    const APEX_Frontend *f = &cpu->frontend;
+
+    printf("%-10s %10d %10d %8.3f %10lld %10lld %10d %10d\n", name, cpu->clock,
+           cpu->insn_completed, cpu->clock ? (double)cpu->insn_completed / cpu->clock : 0.0,
+           f->branches, f->mispredicts, f->icache_bubbles, f->redirect_bubbles);
+}
+
+/*
+ * Runs until HALT, or for the given number of cycles, with the coupled and
+ * the decoupled front end in front of the same instruction cache, and
+ * reports the fetch bubbles of each, on a line or after a redirect, the
+ * predictor's accuracy and what prefetching from the queue did.
+ */
+void
+APEX_frontend_run(APEX_CPU *cpu, const char *cycles)
+{
+    int max_cycles = cycles ? atoi(cycles) : 0;
+    APEX_CPU *coupled = calloc(1, sizeof(APEX_CPU));
+    const APEX_Frontend *f = &cpu->frontend;
+    const APEX_Frontend *c = &coupled->frontend;
+    int bubbles, hidden;
+
+    if (!coupled)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate the coupled run\n");
+        return;
+    }
+    APEX_cpu_copy(coupled, cpu);
+    coupled->config.frontend = FRONTEND_COUPLED;
+    cpu->config.frontend = FRONTEND_DECOUPLED;
+    run_until_halt(coupled, max_cycles);
+    run_until_halt(cpu, max_cycles);
+
+    printf("%-10s %10s %10s %8s %10s %10s %10s %10s\n", "frontend", "cycles", "insns", "IPC",
+           "branches", "redirects", "l1i_wait", "redir_wait");
+    print_run("coupled", coupled);
+    print_run("decoupled", cpu);
+
+    printf("\npredictor: %.2f%% of %lld branches and JUMPs predicted, ftq_size=%d "
+           "btb_entries=%d\n",
+           f->branches ? 100.0 * (f->branches - f->mispredicts) / f->branches : 0.0,
+           f->branches, cpu->config.ftq_size, cpu->config.btb_entries);
+    if (cpu->config.l1i_size)
+    {
+        printf("l1i: %lld misses on demand coupled, %lld decoupled, %lld prefetches, "
+               "%.2f%% useful, %.2f%% of those late\n",
+               c->l1i_misses, f->l1i_misses, f->prefetches,
+               f->prefetches ? 100.0 * f->prefetch_useful / f->prefetches : 0.0,
+               f->prefetch_useful ? 100.0 * f->prefetch_late / f->prefetch_useful : 0.0);
+    }
+
+    bubbles = c->icache_bubbles + c->redirect_bubbles;
+    hidden = bubbles - f->icache_bubbles - f->redirect_bubbles;
+    printf("decoupling hides %d of %d front end bubble cycles (%.2f%%): %d cycles (%.2f%%) "
+           "under the coupled run\n",
+           hidden, bubbles, bubbles ? 100.0 * hidden / bubbles : 0.0,
+           coupled->clock - cpu->clock,
+           coupled->clock ? 100.0 * (coupled->clock - cpu->clock) / coupled->clock : 0.0);
+
+    APEX_cpu_release(coupled);
+    free(coupled);
+}
+
+static const char *kind_names[] = { "branch", "jump", "call", "return" };
+
+/* Outcomes of the JUMP at pc in the run of cpu, NULL if it has none */
+static const APEX_JumpSite *
+find_site(const APEX_CPU *cpu, int pc)
+{
+    for (int i = 0; i < cpu->frontend.num_jumps; ++i)
+    {
+        if (cpu->frontend.jumps[i].pc == pc)
+        {
+            return &cpu->frontend.jumps[i];
+        }
+    }
+    return NULL;
+}
+
+static double
+accuracy(long long executed, long long mispredicts)
+{
+    return executed ? 100.0 * (executed - mispredicts) / executed : 0.0;
+}
+
+/*
+ * Runs until HALT, or for the given number of cycles, with the decoupled
+ * front end predicting JUMP targets as configured and with its branch
+ * target buffer alone, and reports how well each JUMP site was predicted
+ * by both.
+ */
+void
+APEX_frontend_indirect_run(APEX_CPU *cpu, const char *cycles)
+{
+    int max_cycles = cycles ? atoi(cycles) : 0;
+    APEX_CPU *btb = calloc(1, sizeof(APEX_CPU));
+    const APEX_Frontend *f = &cpu->frontend;
+    long long executed = 0, mispredicts = 0, btb_executed = 0, btb_mispredicts = 0;
+
+    if (!btb)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate the branch target buffer run\n");
+        return;
+    }
+    cpu->config.frontend = FRONTEND_DECOUPLED;
+    APEX_cpu_copy(btb, cpu);
+    btb->config.indirect = INDIRECT_BTB;
+    btb->config.ras_reg = -1;
+    run_until_halt(btb, max_cycles);
+    run_until_halt(cpu, max_cycles);
+
+    printf("%-8s %-8s %10s %12s %10s %10s\n", "pc", "kind", "executed", "mispredicts",
+           "accuracy", "btb_only");
+    for (int i = 0; i < f->num_jumps; ++i)
+    {
+        const APEX_JumpSite *site = &f->jumps[i];
+        const APEX_JumpSite *b = find_site(btb, site->pc);
+
+        printf("%-8d %-8s %10lld %12lld %9.2f%% %9.2f%%\n", site->pc, kind_names[site->kind],
+               site->executed, site->mispredicts,
+               accuracy(site->executed, site->mispredicts),
+               b ? accuracy(b->executed, b->mispredicts) : 0.0);
+        executed += site->executed;
+        mispredicts += site->mispredicts;
+    }
+    for (int i = 0; i < btb->frontend.num_jumps; ++i)
+    {
+        btb_executed += btb->frontend.jumps[i].executed;
+        btb_mispredicts += btb->frontend.jumps[i].mispredicts;
+    }
+
+    printf("\n%-10s %10s %10s %8s %10s %12s\n", "predictor", "cycles", "insns", "IPC", "jumps",
+           "mispredicts");
+    printf("%-10s %10d %10d %8.3f %10lld %12lld\n", "btb_only", btb->clock, btb->insn_completed,
+           btb->clock ? (double)btb->insn_completed / btb->clock : 0.0, btb_executed,
+           btb_mispredicts);
+    printf("%-10s %10d %10d %8.3f %10lld %12lld\n", "configured", cpu->clock,
+           cpu->insn_completed, cpu->clock ? (double)cpu->insn_completed / cpu->clock : 0.0,
+           executed, mispredicts);
+    printf("JUMP targets %.2f%% predicted against %.2f%% by the branch target buffer, "
+           "indirect=%s itc_entries=%d ras_reg=%d ras_size=%d: %d cycles (%.2f%%) saved\n",
+           accuracy(executed, mispredicts), accuracy(btb_executed, btb_mispredicts),
+           cpu->config.indirect == INDIRECT_TARGET_CACHE ? "target_cache" : "btb",
+           cpu->config.itc_entries, cpu->config.ras_reg, cpu->config.ras_size,
+           btb->clock - cpu->clock,
+           btb->clock ? 100.0 * (btb->clock - cpu->clock) / btb->clock : 0.0);
+    if (f->num_jumps == FRONTEND_JUMP_SITES)
+    {
+        printf("only the first %d JUMP sites are counted\n", FRONTEND_JUMP_SITES);
+    }
+
+    APEX_cpu_release(btb);
+    free(btb);
+}
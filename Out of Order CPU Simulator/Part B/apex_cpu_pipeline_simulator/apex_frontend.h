@@ -0,0 +1,19 @@
+/*
+ * apex_frontend.h
+ * Contains declarations of the instruction cache and the decoupled front
+ * end feeding the fetch stage
+ */
+#ifndef _APEX_FRONTEND_H_
+#define _APEX_FRONTEND_H_
+
+#include "apex_cpu.h"
+
+void APEX_frontend_cycle(APEX_CPU *cpu);
+int APEX_frontend_fetch(APEX_CPU *cpu);
+int APEX_frontend_ready(APEX_CPU *cpu);
+int APEX_frontend_next(APEX_CPU *cpu);
+void APEX_frontend_redirect(APEX_CPU *cpu, int target);
+void APEX_frontend_resolve(APEX_CPU *cpu, int pc, int taken, int target, int mispredicted);
+void APEX_frontend_run(APEX_CPU *cpu, const char *cycles);
+void APEX_frontend_indirect_run(APEX_CPU *cpu, const char *cycles);
+#endif
@@ -0,0 +1,87 @@
+/*
+ * apex_fu.c
+ * Functional unit report: the latency and initiation interval of every
+ * opcode done in execute, what they cost in decode stalls, and the run
+ * against the same pipeline with every unit taking a single cycle
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "apex_cpu.h"
+#include "apex_fu.h"
+#include "apex_macros.h"
+
+static void
+run_until_halt(APEX_CPU *cpu, int max_cycles)
+{
+    while (!APEX_cpu_cycle(cpu) && cpu->clock != max_cycles)
+    {
+    }
+}
+
+static void
+print_run(const char *name, const APEX_CPU *cpu)
+{
+    printf("%-8s %12d %12d %8.3f %12d %12d\n", name, cpu->clock, cpu->insn_completed,
+           cpu->clock ? (double)cpu->insn_completed / cpu->clock : 0.0, cpu->stall_cycles,
+           cpu->mem_stall_cycles);
+}
+
+/*
+ * Runs until HALT, or for the given number of cycles, with the functional
+ * units of the configuration and with single-cycle ones, then reports the
+ * units used and the decode stalls they caused: cycles an instruction
+ * waited for its busy unit, and cycles one waited for a unit's result.
+ */
+void
+APEX_fu_run(APEX_CPU *cpu, const char *cycles)
+{
+    int max_cycles = cycles ? atoi(cycles) : 0;
+    APEX_CPU *single = calloc(1, sizeof(APEX_CPU));
+    long long unit_stalls = 0;
+    long long result_stalls = 0;
+
+    if (!single)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate the single-cycle run\n");
+        return;
+    }
+    APEX_cpu_copy(single, cpu);
+    for (int op = 0; op < OPCODE_COUNT; ++op)
+    {
+        single->config.fu_latency[op] = 1;
+        single->config.fu_interval[op] = 1;
+    }
+    run_until_halt(single, max_cycles);
+    run_until_halt(cpu, max_cycles);
+
+    printf("%-8s %8s %8s %12s %12s %12s\n", "opcode", "latency", "interval", "executed",
+           "unit_stalls", "result_stalls");
+    for (int op = 0; op < OPCODE_COUNT; ++op)
+    {
+        const char *name = APEX_config_fu_name(op);
+
+        if (!name || (!cpu->fu_issued[op] && cpu->config.fu_latency[op] == 1
+                      && cpu->config.fu_interval[op] == 1))
+        {
+            continue;
+        }
+        printf("%-8s %8d %8d %12lld %12lld %12lld\n", name, cpu->config.fu_latency[op],
+               cpu->config.fu_interval[op], cpu->fu_issued[op], cpu->fu_unit_stalls[op],
+               cpu->fu_result_stalls[op]);
+        unit_stalls += cpu->fu_unit_stalls[op];
+        result_stalls += cpu->fu_result_stalls[op];
+    }
+
+    printf("\n%-8s %12s %12s %8s %12s %12s\n", "run", "cycles", "insns", "IPC", "stalls",
+           "mem_stalls");
+    print_run("units", cpu);
+    print_run("single", single);
+    printf("%lld cycles held for a busy unit, %lld waiting on a result: %d cycles (%.2f%%) "
+           "over single-cycle units\n",
+           unit_stalls, result_stalls, cpu->clock - single->clock,
+           single->clock ? 100.0 * (cpu->clock - single->clock) / single->clock : 0.0);
+
+    APEX_cpu_release(single);
+    free(single);
+}
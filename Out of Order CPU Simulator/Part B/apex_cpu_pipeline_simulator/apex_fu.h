@@ -0,0 +1,11 @@
+/*
+ * apex_fu.h
+ * Contains declarations of the functional unit report
+ */
+#ifndef _APEX_FU_H_
+#define _APEX_FU_H_
+
+#include "apex_cpu.h"
+
+void APEX_fu_run(APEX_CPU *cpu, const char *cycles);
+#endif
@@ -0,0 +1,288 @@
+/*
+ * apex_func.c
+ * Functional APEX engine: executes one instruction per call directly on the
+ * architectural state of APEX_CPU, without modelling the pipeline
+ *
+ * The semantics mirror APEX_execute, APEX_memory and APEX_writeback, so a
+ * program leaves the same registers, flags and data memory behind on both
+ * engines. Only pc, regs, zero_flag, positive_flag, data_memory, link_addr
+ * and insn_completed are touched.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_func.h"
+#include "apex_macros.h"
+#include "apex_mem.h"
+
+static void
+set_flags(APEX_CPU *cpu, int result)
+{
+    cpu->zero_flag = (result == 0) ? TRUE : FALSE;
+    cpu->positive_flag = (result > 0) ? TRUE : FALSE;
+}
+
+/*
+ * Executes the instruction at cpu->pc and, when rec is not NULL, reports
+ * its architectural effects there.
+ *
+ * Returns TRUE when the instruction was HALT, or when pc left code memory,
+ * in which case nothing is executed.
+ */
+int
+APEX_func_step(APEX_CPU *cpu, APEX_Retire *rec)
+{
+    const APEX_Instruction *ins;
+    APEX_Retire local;
+    int index = (cpu->pc - 4000) / 4;
+    int next_pc = cpu->pc + 4;
+
+    if (cpu->pc < 4000 || index >= cpu->code_memory_size)
+    {
+        return TRUE;
+    }
+    ins = &cpu->code_memory[index];
+
+    if (!rec)
+    {
+        rec = &local;
+    }
+    rec->pc = cpu->pc;
+    rec->opcode = ins->opcode;
+    rec->rd = -1;
+    rec->rd1 = -1;
+    rec->mem_addr = -1;
+    rec->mem_read = -1;
+
+    switch (ins->opcode)
+    {
+        case OPCODE_ADD:
+        {
+            rec->rd_value = cpu->regs[ins->rs1] + cpu->regs[ins->rs2];
+            break;
+        }
+
+        case OPCODE_SUB:
+        {
+            rec->rd_value = cpu->regs[ins->rs1] - cpu->regs[ins->rs2];
+            break;
+        }
+
+        case OPCODE_MUL:
+        {
+            rec->rd_value = cpu->regs[ins->rs1] * cpu->regs[ins->rs2];
+            break;
+        }
+
+        case OPCODE_DIV:
+        {
+            rec->rd_value = cpu->regs[ins->rs1] / cpu->regs[ins->rs2];
+            break;
+        }
+
+        case OPCODE_AND:
+        {
+            rec->rd_value = cpu->regs[ins->rs1] & cpu->regs[ins->rs2];
+            break;
+        }
+
+        case OPCODE_OR:
+        {
+            rec->rd_value = cpu->regs[ins->rs1] | cpu->regs[ins->rs2];
+            break;
+        }
+
+        case OPCODE_XOR:
+        {
+            rec->rd_value = cpu->regs[ins->rs1] ^ cpu->regs[ins->rs2];
+            break;
+        }
+
+        case OPCODE_ADDL:
+        {
+            rec->rd_value = cpu->regs[ins->rs1] + ins->imm;
+            break;
+        }
+
+        case OPCODE_SUBL:
+        {
+            rec->rd_value = cpu->regs[ins->rs1] - ins->imm;
+            break;
+        }
+
+        case OPCODE_MOVC:
+        {
+            rec->rd = ins->rd;
+            rec->rd_value = ins->imm;
+            break;
+        }
+
+        case OPCODE_LOAD:
+        {
+            rec->rd = ins->rd;
+            rec->mem_read = cpu->regs[ins->rs1] + ins->imm;
+            rec->rd_value = APEX_mem_read(&cpu->data_memory, rec->mem_read);
+            break;
+        }
+
+        case OPCODE_LDI:
+        {
+            rec->rd = ins->rd;
+            rec->mem_read = cpu->regs[ins->rs1] + ins->imm;
+            rec->rd_value = APEX_mem_read(&cpu->data_memory, rec->mem_read);
+            rec->rd1 = ins->rs1;
+            rec->rd1_value = cpu->regs[ins->rs1] + 4;
+            break;
+        }
+
+        case OPCODE_STORE:
+        {
+            rec->mem_addr = cpu->regs[ins->rs2] + ins->imm;
+            rec->mem_value = cpu->regs[ins->rs1];
+            break;
+        }
+
+        case OPCODE_STI:
+        {
+            rec->mem_addr = cpu->regs[ins->rs2] + ins->imm;
+            rec->mem_value = cpu->regs[ins->rs1];
+            rec->rd = ins->rs2;
+            rec->rd_value = cpu->regs[ins->rs2] + 4;
+            break;
+        }
+
+        case OPCODE_LL:
+        {
+            rec->rd = ins->rd;
+            rec->mem_read = cpu->regs[ins->rs1] + ins->imm;
+            rec->rd_value = APEX_mem_read(&cpu->data_memory, rec->mem_read);
+            cpu->link_addr = rec->mem_read;
+            break;
+        }
+
+        case OPCODE_SC:
+        {
+            rec->mem_read = cpu->regs[ins->rs2] + ins->imm;
+            rec->rd_value = cpu->link_addr == rec->mem_read;
+            if (rec->rd_value)
+            {
+                rec->mem_addr = rec->mem_read;
+                rec->mem_value = cpu->regs[ins->rs1];
+            }
+            cpu->link_addr = -1;
+            break;
+        }
+
+        case OPCODE_FAA:
+        {
+            rec->rd = ins->rd;
+            rec->mem_read = cpu->regs[ins->rs2] + ins->imm;
+            rec->rd_value = APEX_mem_read(&cpu->data_memory, rec->mem_read);
+            rec->mem_addr = rec->mem_read;
+            rec->mem_value = rec->rd_value + cpu->regs[ins->rs1];
+            break;
+        }
+
+        case OPCODE_CMP:
+        {
+            cpu->zero_flag = (cpu->regs[ins->rs1] == cpu->regs[ins->rs2]) ? TRUE : FALSE;
+            cpu->positive_flag = (cpu->regs[ins->rs1] > cpu->regs[ins->rs2]) ? TRUE : FALSE;
+            break;
+        }
+
+        case OPCODE_BZ:
+        {
+            if (cpu->zero_flag == TRUE)
+            {
+                next_pc = cpu->pc + ins->imm;
+            }
+            break;
+        }
+
+        case OPCODE_BNZ:
+        {
+            if (cpu->zero_flag == FALSE)
+            {
+                next_pc = cpu->pc + ins->imm;
+            }
+            break;
+        }
+
+        case OPCODE_BP:
+        {
+            if (cpu->positive_flag == TRUE)
+            {
+                next_pc = cpu->pc + ins->imm;
+            }
+            break;
+        }
+
+        case OPCODE_BNP:
+        {
+            if (cpu->positive_flag == FALSE)
+            {
+                next_pc = cpu->pc + ins->imm;
+            }
+            break;
+        }
+
+        case OPCODE_JUMP:
+        {
+            next_pc = cpu->regs[ins->rs1] + ins->imm;
+            break;
+        }
+
+        case OPCODE_HALT:
+        case OPCODE_NOP:
+        case OPCODE_FENCE:
+        {
+            break;
+        }
+    }
+
+    switch (ins->opcode)
+    {
+        case OPCODE_ADD:
+        case OPCODE_SUB:
+        case OPCODE_MUL:
+        case OPCODE_DIV:
+        case OPCODE_AND:
+        case OPCODE_OR:
+        case OPCODE_XOR:
+        case OPCODE_ADDL:
+        case OPCODE_SUBL:
+        case OPCODE_SC:
+        {
+            rec->rd = ins->rd;
+            set_flags(cpu, rec->rd_value);
+            break;
+        }
+    }
+
+    /* Commit in the order of APEX_memory and APEX_writeback: LDI writes
+     * rs1 after rd */
+    if (rec->mem_addr >= 0)
+    {
+        APEX_mem_write(&cpu->data_memory, rec->mem_addr, rec->mem_value);
+    }
+    if (rec->rd >= 0)
+    {
+        cpu->regs[rec->rd] = rec->rd_value;
+    }
+    if (rec->rd1 >= 0)
+    {
+        cpu->regs[rec->rd1] = rec->rd1_value;
+    }
+    rec->zero_flag = cpu->zero_flag;
+    rec->positive_flag = cpu->positive_flag;
+
+    cpu->insn_completed++;
+    if (ins->opcode == OPCODE_HALT)
+    {
+        return TRUE;
+    }
+    cpu->pc = next_pc;
+    return FALSE;
+}
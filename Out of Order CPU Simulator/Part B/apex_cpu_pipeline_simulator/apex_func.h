@@ -0,0 +1,12 @@
+/*
+ * apex_func.h
+ * Contains declarations of the functional (instruction-at-a-time) APEX
+ * engine
+ */
+#ifndef _APEX_FUNC_H_
+#define _APEX_FUNC_H_
+
+#include "apex_cpu.h"
+
+int APEX_func_step(APEX_CPU *cpu, APEX_Retire *rec);
+#endif
@@ -0,0 +1,103 @@
+/*
+ * apex_fusion.c
+ * Macro-op fusion report: the compare and branch pairs of config.fuse
+ * taken through the pipeline as one micro-op, the adjacent pairs that were
+ * not, and the run against the same pipeline fusing nothing
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_fusion.h"
+#include "apex_macros.h"
+
+static void
+run_until_halt(APEX_CPU *cpu, int max_cycles)
+{
+    while (!APEX_cpu_cycle(cpu) && cpu->clock != max_cycles)
+    {
+    }
+}
+
+/* Micro-ops of a run: the instructions retired less the branches fused */
+static long long
+run_uops(const APEX_CPU *cpu)
+{
+    long long uops = cpu->insn_completed;
+
+    for (int op = 0; op < OPCODE_COUNT; ++op)
+    {
+        for (int b = 0; b < FUSE_BRANCHES; ++b)
+        {
+            uops -= cpu->fused[op][b];
+        }
+    }
+    return uops;
+}
+
+static void
+print_run(const char *name, const APEX_CPU *cpu)
+{
+    printf("%-8s %12d %12d %12lld %8.3f %12d\n", name, cpu->clock, cpu->insn_completed,
+           run_uops(cpu), cpu->clock ? (double)cpu->insn_completed / cpu->clock : 0.0,
+           cpu->stall_cycles);
+}
+
+/*
+ * Runs until HALT, or for the given number of cycles, fusing the pairs of
+ * the configuration and fusing none, then reports every pair met: how
+ * often it went through as one micro-op, and how often a branch retired
+ * right behind the instruction setting its flags without being fused.
+ */
+void
+APEX_fusion_run(APEX_CPU *cpu, const char *cycles)
+{
+    int max_cycles = cycles ? atoi(cycles) : 0;
+    APEX_CPU *unfused = calloc(1, sizeof(APEX_CPU));
+    long long fused = 0;
+    long long missed = 0;
+
+    if (!unfused)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate the unfused run\n");
+        return;
+    }
+    APEX_cpu_copy(unfused, cpu);
+    memset(unfused->config.fuse, 0, sizeof(unfused->config.fuse));
+    run_until_halt(unfused, max_cycles);
+    run_until_halt(cpu, max_cycles);
+
+    printf("%-12s %12s %12s %8s\n", "pair", "fused", "missed", "rate");
+    for (int op = 0; op < OPCODE_COUNT; ++op)
+    {
+        for (int b = 0; b < FUSE_BRANCHES; ++b)
+        {
+            char pair[32];
+            long long pairs = cpu->fused[op][b] + cpu->fuse_missed[op][b];
+
+            if (!pairs)
+            {
+                continue;
+            }
+            snprintf(pair, sizeof(pair), "%s+%s", APEX_config_fu_name(op),
+                     APEX_config_branch_name(b));
+            printf("%-12s %12lld %12lld %7.2f%%\n", pair, cpu->fused[op][b],
+                   cpu->fuse_missed[op][b], 100.0 * cpu->fused[op][b] / pairs);
+            fused += cpu->fused[op][b];
+            missed += cpu->fuse_missed[op][b];
+        }
+    }
+
+    printf("\n%-8s %12s %12s %12s %8s %12s\n", "run", "cycles", "insns", "uops", "IPC",
+           "stalls");
+    print_run("fused", cpu);
+    print_run("unfused", unfused);
+    printf("%lld of %lld pairs fused (%.2f%%): %d cycles (%.2f%%) under the unfused run\n",
+           fused, fused + missed, fused + missed ? 100.0 * fused / (fused + missed) : 0.0,
+           unfused->clock - cpu->clock,
+           unfused->clock ? 100.0 * (unfused->clock - cpu->clock) / unfused->clock : 0.0);
+
+    APEX_cpu_release(unfused);
+    free(unfused);
+}
@@ -0,0 +1,11 @@
+/*
+ * apex_fusion.h
+ * Contains declarations of the macro-op fusion report
+ */
+#ifndef _APEX_FUSION_H_
+#define _APEX_FUSION_H_
+
+#include "apex_cpu.h"
+
+void APEX_fusion_run(APEX_CPU *cpu, const char *cycles);
+#endif
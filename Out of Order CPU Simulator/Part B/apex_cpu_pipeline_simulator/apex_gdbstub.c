@@ -0,0 +1,1015 @@
+/*
+ * apex_gdbstub.c
+ * GDB remote serial protocol server for APEX programs
+ *
+ * The target is presented to GDB as a 32-bit RISC-V so a stock
+ * gdb-multiarch can attach without a custom architecture: x0-x15 are APEX
+ * R0-R15, x16-x31 read as zero, and zf/pf are exposed as extra registers.
+ * Data memory is word addressed in APEX, MEM[a] appears to GDB as the
+ * little-endian word at byte address 4*a. Code addresses (4000 series) are
+ * only meaningful as breakpoint locations.
+ *
+ * Execution is driven either by the functional engine (one instruction per
+ * step) or by the pipeline (cycles until an instruction retires). In the
+ * pipeline, registers and pc are precise at retirement while the flags and
+ * data memory already include the effects of younger in-flight
+ * instructions.
+ */
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+#include "apex_func.h"
+#include "apex_gdbstub.h"
+#include "apex_macros.h"
+#include "apex_mem.h"
+
+/* Register numbers as seen by GDB */
+#define GDB_NUM_X_REGS 32
+#define GDB_REG_PC 32
+#define GDB_REG_ZF 33
+#define GDB_REG_PF 34
+#define GDB_NUM_REGS 35
+
+#define GDB_PACKET_SIZE 4096
+
+/* Check the socket for a Ctrl-C once every this many steps */
+#define GDB_POLL_INTERVAL (1 << 16)
+
+/* Why execution stopped, turned into a stop reply packet */
+#define GDB_STOP_TRAP 0
+#define GDB_STOP_WATCH 1
+#define GDB_STOP_EXITED 2
+#define GDB_STOP_INTERRUPT 3
+
+static const char target_xml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\">"
+    "<architecture>riscv:rv32</architecture>"
+    "<feature name=\"org.gnu.gdb.riscv.cpu\">"
+    "<reg name=\"zero\" bitsize=\"32\" type=\"int\" regnum=\"0\"/>"
+    "<reg name=\"ra\" bitsize=\"32\" type=\"code_ptr\"/>"
+    "<reg name=\"sp\" bitsize=\"32\" type=\"data_ptr\"/>"
+    "<reg name=\"gp\" bitsize=\"32\" type=\"data_ptr\"/>"
+    "<reg name=\"tp\" bitsize=\"32\" type=\"data_ptr\"/>"
+    "<reg name=\"t0\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"t1\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"t2\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"fp\" bitsize=\"32\" type=\"data_ptr\"/>"
+    "<reg name=\"s1\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"a0\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"a1\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"a2\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"a3\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"a4\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"a5\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"a6\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"a7\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"s2\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"s3\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"s4\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"s5\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"s6\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"s7\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"s8\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"s9\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"s10\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"s11\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"t3\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"t4\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"t5\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"t6\" bitsize=\"32\" type=\"int\"/>"
+    "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>"
+    "</feature>"
+    "<feature name=\"org.apex.flags\">"
+    "<reg name=\"zf\" bitsize=\"32\" type=\"int\" regnum=\"33\"/>"
+    "<reg name=\"pf\" bitsize=\"32\" type=\"int\"/>"
+    "</feature>"
+    "</target>";
+
+typedef struct APEX_GdbStub
+{
+    APEX_CPU *cpu;
+    int detailed;                 /* Drive the pipeline instead of the functional engine */
+    int fd;
+    int no_ack;
+    int halted;
+
+    char *bp_map;                 /* One byte per code memory slot */
+    int watch_addr[DEBUG_MAX_POINTS]; /* Data memory words, not GDB addresses */
+    int watch_value[DEBUG_MAX_POINTS];
+    int watch_type[DEBUG_MAX_POINTS]; /* Z packet type: 2 write, 3 read, 4 access */
+    int num_watch;
+    int hit_addr;
+    int hit_type;
+} APEX_GdbStub;
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static int
+hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/* Encodes a 32-bit value as 8 hex digits in target (little-endian) order */
+static void
+put_word(char *out, unsigned int value)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        out[2 * i] = hex_digits[(value >> (8 * i + 4)) & 0xf];
+        out[2 * i + 1] = hex_digits[(value >> (8 * i)) & 0xf];
+    }
+}
+
+static unsigned int
+get_word(const char *in)
+{
+    unsigned int value = 0;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        value |= (unsigned int)((hex_value(in[2 * i]) << 4) | hex_value(in[2 * i + 1]))
+                 << (8 * i);
+    }
+    return value;
+}
+
+static int
+gdb_send(APEX_GdbStub *stub, const char *payload)
+{
+    static char packet[2 * GDB_PACKET_SIZE + 8];
+    unsigned char checksum = 0;
+    size_t len = strlen(payload);
+    char ack;
+
+    packet[0] = '$';
+    memcpy(packet + 1, payload, len);
+    for (size_t i = 0; i < len; ++i)
+    {
+        checksum += (unsigned char)payload[i];
+    }
+    packet[len + 1] = '#';
+    packet[len + 2] = hex_digits[checksum >> 4];
+    packet[len + 3] = hex_digits[checksum & 0xf];
+
+    do
+    {
+        if (write(stub->fd, packet, len + 4) != (ssize_t)(len + 4))
+        {
+            return FALSE;
+        }
+        if (stub->no_ack)
+        {
+            return TRUE;
+        }
+        if (read(stub->fd, &ack, 1) != 1)
+        {
+            return FALSE;
+        }
+    } while (ack == '-');
+
+    return TRUE;
+}
+
+/*
+ * Reads the next packet payload into buf. A lone Ctrl-C outside a packet
+ * is returned as the payload "\003".
+ */
+static int
+gdb_receive(APEX_GdbStub *stub, char *buf, int size)
+{
+    char c;
+
+    while (TRUE)
+    {
+        int len = 0;
+        char sum[2];
+
+        do
+        {
+            if (read(stub->fd, &c, 1) != 1)
+            {
+                return FALSE;
+            }
+            if (c == 0x03)
+            {
+                strcpy(buf, "\003");
+                return TRUE;
+            }
+        } while (c != '$');
+
+        while (read(stub->fd, &c, 1) == 1 && c != '#')
+        {
+            if (len < size - 1)
+            {
+                buf[len++] = c;
+            }
+        }
+        buf[len] = '\0';
+
+        if (read(stub->fd, sum, 1) != 1 || read(stub->fd, sum + 1, 1) != 1)
+        {
+            return FALSE;
+        }
+
+        if (!stub->no_ack)
+        {
+            unsigned char checksum = 0;
+
+            for (int i = 0; i < len; ++i)
+            {
+                checksum += (unsigned char)buf[i];
+            }
+            if (checksum != ((hex_value(sum[0]) << 4) | hex_value(sum[1])))
+            {
+                if (write(stub->fd, "-", 1) != 1)
+                {
+                    return FALSE;
+                }
+                continue;
+            }
+            if (write(stub->fd, "+", 1) != 1)
+            {
+                return FALSE;
+            }
+        }
+        return TRUE;
+    }
+}
+
+/* Returns TRUE when GDB sent a Ctrl-C while the target was running */
+static int
+gdb_interrupted(APEX_GdbStub *stub)
+{
+    struct pollfd pfd = { stub->fd, POLLIN, 0 };
+    char c;
+
+    if (poll(&pfd, 1, 0) <= 0)
+    {
+        return FALSE;
+    }
+    return read(stub->fd, &c, 1) == 1 && c == 0x03;
+}
+
+static int
+gdb_pc(const APEX_GdbStub *stub)
+{
+    return stub->detailed ? APEX_cpu_commit_pc(stub->cpu) : stub->cpu->pc;
+}
+
+static int
+gdb_read_reg(const APEX_GdbStub *stub, int regnum)
+{
+    if (regnum < REG_FILE_SIZE)
+    {
+        return stub->cpu->regs[regnum];
+    }
+    switch (regnum)
+    {
+        case GDB_REG_PC:
+        {
+            return gdb_pc(stub);
+        }
+        case GDB_REG_ZF:
+        {
+            return stub->cpu->zero_flag;
+        }
+        case GDB_REG_PF:
+        {
+            return stub->cpu->positive_flag;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Writes a register. Redirecting the pc is only supported on the
+ * functional engine, the pipeline would have to be flushed.
+ */
+static int
+gdb_write_reg(APEX_GdbStub *stub, int regnum, int value)
+{
+    if (regnum < REG_FILE_SIZE)
+    {
+        stub->cpu->regs[regnum] = value;
+        return TRUE;
+    }
+    switch (regnum)
+    {
+        case GDB_REG_PC:
+        {
+            if (stub->detailed)
+            {
+                return FALSE;
+            }
+            stub->cpu->pc = value;
+            return TRUE;
+        }
+        case GDB_REG_ZF:
+        {
+            stub->cpu->zero_flag = value ? TRUE : FALSE;
+            return TRUE;
+        }
+        case GDB_REG_PF:
+        {
+            stub->cpu->positive_flag = value ? TRUE : FALSE;
+            return TRUE;
+        }
+    }
+    /* x16-x31 do not exist on APEX, writes are ignored */
+    return regnum < GDB_NUM_X_REGS;
+}
+
+static int
+gdb_bp_index(const APEX_GdbStub *stub, int pc)
+{
+    int index = (pc - 4000) / 4;
+
+    if (pc < 4000 || (pc - 4000) % 4 || index >= stub->cpu->code_memory_size)
+    {
+        return -1;
+    }
+    return index;
+}
+
+static int
+gdb_at_breakpoint(const APEX_GdbStub *stub)
+{
+    int index = gdb_bp_index(stub, gdb_pc(stub));
+
+    return index >= 0 && stub->bp_map[index];
+}
+
+/*
+ * Only called while at least one watchpoint is set. A write watchpoint
+ * stops when its word changed, a read one when read_addr is its word, an
+ * access one on either.
+ */
+static int
+gdb_watch_hit(APEX_GdbStub *stub, int read_addr)
+{
+    for (int i = 0; i < stub->num_watch; ++i)
+    {
+        int value = APEX_mem_peek(&stub->cpu->data_memory, stub->watch_addr[i]);
+        int written = value != stub->watch_value[i];
+        int read = read_addr == stub->watch_addr[i];
+
+        stub->watch_value[i] = value;
+        if ((written && stub->watch_type[i] != 3) || (read && stub->watch_type[i] != 2))
+        {
+            stub->hit_addr = stub->watch_addr[i];
+            stub->hit_type = stub->watch_type[i];
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* Returns the data memory word read by the instruction at pc, -1 if none */
+static int
+gdb_load_address(const APEX_CPU *cpu)
+{
+    int index = (cpu->pc - 4000) / 4;
+    const APEX_Instruction *ins;
+
+    if (cpu->pc < 4000 || index >= cpu->code_memory_size)
+    {
+        return -1;
+    }
+    ins = &cpu->code_memory[index];
+    if (ins->opcode == OPCODE_LOAD || ins->opcode == OPCODE_LDI || ins->opcode == OPCODE_LL)
+    {
+        return cpu->regs[ins->rs1] + ins->imm;
+    }
+    if (ins->opcode == OPCODE_FAA)
+    {
+        return cpu->regs[ins->rs2] + ins->imm;
+    }
+    return -1;
+}
+
+/*
+ * Executes one instruction on the functional engine, or cycles the
+ * pipeline until one instruction retires.
+ */
+static int
+gdb_step_one(APEX_GdbStub *stub)
+{
+    APEX_CPU *cpu = stub->cpu;
+
+    if (stub->halted)
+    {
+        return GDB_STOP_EXITED;
+    }
+
+    if (!stub->detailed)
+    {
+        int load_addr = stub->num_watch ? gdb_load_address(cpu) : -1;
+
+        stub->halted = APEX_func_step(cpu, NULL);
+        if (stub->num_watch && gdb_watch_hit(stub, load_addr))
+        {
+            return GDB_STOP_WATCH;
+        }
+    }
+    else
+    {
+        int retired = cpu->insn_completed;
+        int watched = FALSE;
+
+        while (cpu->insn_completed == retired && !stub->halted)
+        {
+            stub->halted = APEX_cpu_cycle(cpu);
+            if (stub->num_watch && cpu->mp == 1)
+            {
+                int is_load = cpu->pmemory.opcode == OPCODE_LOAD
+                              || cpu->pmemory.opcode == OPCODE_LDI
+                              || cpu->pmemory.opcode == OPCODE_LL
+                              || cpu->pmemory.opcode == OPCODE_FAA;
+
+                watched |= gdb_watch_hit(stub,
+                                         is_load ? cpu->pmemory.memory_address : -1);
+            }
+        }
+        if (watched)
+        {
+            return GDB_STOP_WATCH;
+        }
+    }
+
+    return stub->halted ? GDB_STOP_EXITED : GDB_STOP_TRAP;
+}
+
+static int
+gdb_continue(APEX_GdbStub *stub)
+{
+    long steps = 0;
+
+    do
+    {
+        int status = gdb_step_one(stub);
+
+        if (status != GDB_STOP_TRAP)
+        {
+            return status;
+        }
+        if (++steps % GDB_POLL_INTERVAL == 0 && gdb_interrupted(stub))
+        {
+            return GDB_STOP_INTERRUPT;
+        }
+    } while (!gdb_at_breakpoint(stub));
+
+    return GDB_STOP_TRAP;
+}
+
+static void
+gdb_stop_reply(APEX_GdbStub *stub, int status, char *out)
+{
+    switch (status)
+    {
+        case GDB_STOP_EXITED:
+        {
+            strcpy(out, "W00");
+            break;
+        }
+        case GDB_STOP_WATCH:
+        {
+            static const char *kinds[] = { "watch", "rwatch", "awatch" };
+
+            sprintf(out, "T05%s:%x;", kinds[stub->hit_type - 2], 4 * stub->hit_addr);
+            break;
+        }
+        case GDB_STOP_INTERRUPT:
+        {
+            strcpy(out, "S02");
+            break;
+        }
+        default:
+        {
+            strcpy(out, "S05");
+            break;
+        }
+    }
+}
+
+static void
+gdb_read_memory(const APEX_GdbStub *stub, unsigned int addr, unsigned int len,
+                char *out)
+{
+    if (len > GDB_PACKET_SIZE / 2 - 1)
+    {
+        len = GDB_PACKET_SIZE / 2 - 1;
+    }
+
+    for (unsigned int i = 0; i < len; ++i)
+    {
+        unsigned int word = (addr + i) / 4;
+        unsigned int value;
+
+        if (!APEX_mem_valid(word))
+        {
+            if (i == 0)
+            {
+                strcpy(out, "E14");
+                return;
+            }
+            break;
+        }
+        value = (unsigned int)APEX_mem_peek(&stub->cpu->data_memory, word) >> (8 * ((addr + i) % 4));
+        *out++ = hex_digits[(value >> 4) & 0xf];
+        *out++ = hex_digits[value & 0xf];
+    }
+    *out = '\0';
+}
+
+static int
+gdb_write_memory(APEX_GdbStub *stub, unsigned int addr, unsigned int len,
+                 const char *data)
+{
+    for (unsigned int i = 0; i < len; ++i)
+    {
+        unsigned int word = (addr + i) / 4;
+        unsigned int shift = 8 * ((addr + i) % 4);
+        unsigned int value;
+
+        if (!APEX_mem_valid(word))
+        {
+            return FALSE;
+        }
+        value = (unsigned int)APEX_mem_peek(&stub->cpu->data_memory, word);
+        value &= ~(0xffu << shift);
+        value |= (unsigned int)((hex_value(data[2 * i]) << 4) | hex_value(data[2 * i + 1]))
+                 << shift;
+        APEX_mem_write(&stub->cpu->data_memory, word, (int)value);
+    }
+
+    for (int i = 0; i < stub->num_watch; ++i)
+    {
+        stub->watch_value[i] = APEX_mem_peek(&stub->cpu->data_memory, stub->watch_addr[i]);
+    }
+    return TRUE;
+}
+
+/* Handles Z/z packets: type 0/1 breakpoints, 2/3/4 watchpoints */
+static int
+gdb_set_point(APEX_GdbStub *stub, const char *packet)
+{
+    int insert = packet[0] == 'Z';
+    int type;
+    unsigned int addr;
+
+    if (sscanf(packet + 1, "%d,%x", &type, &addr) != 2)
+    {
+        return FALSE;
+    }
+
+    if (type == 0 || type == 1)
+    {
+        int index = gdb_bp_index(stub, (int)addr);
+
+        if (index < 0)
+        {
+            return FALSE;
+        }
+        stub->bp_map[index] = insert;
+        return TRUE;
+    }
+
+    if (type >= 2 && type <= 4 && APEX_mem_valid(addr / 4))
+    {
+        int word = addr / 4;
+
+        for (int i = 0; i < stub->num_watch; ++i)
+        {
+            if (stub->watch_addr[i] == word && stub->watch_type[i] == type)
+            {
+                if (!insert)
+                {
+                    stub->num_watch--;
+                    stub->watch_addr[i] = stub->watch_addr[stub->num_watch];
+                    stub->watch_value[i] = stub->watch_value[stub->num_watch];
+                    stub->watch_type[i] = stub->watch_type[stub->num_watch];
+                }
+                return TRUE;
+            }
+        }
+        if (!insert)
+        {
+            return TRUE;
+        }
+        if (stub->num_watch == DEBUG_MAX_POINTS)
+        {
+            return FALSE;
+        }
+        stub->watch_addr[stub->num_watch] = word;
+        stub->watch_value[stub->num_watch] = APEX_mem_peek(&stub->cpu->data_memory, word);
+        stub->watch_type[stub->num_watch] = type;
+        stub->num_watch++;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+gdb_read_target_xml(const char *annex, char *out)
+{
+    unsigned int offset, len;
+    size_t total = sizeof(target_xml) - 1;
+
+    if (strncmp(annex, "target.xml:", 11) != 0
+        || sscanf(annex + 11, "%x,%x", &offset, &len) != 2)
+    {
+        strcpy(out, "E00");
+        return;
+    }
+    if (len > GDB_PACKET_SIZE - 2)
+    {
+        len = GDB_PACKET_SIZE - 2;
+    }
+    if (offset >= total)
+    {
+        strcpy(out, "l");
+        return;
+    }
+    if (offset + len >= total)
+    {
+        len = total - offset;
+        out[0] = 'l';
+    }
+    else
+    {
+        out[0] = 'm';
+    }
+    memcpy(out + 1, target_xml + offset, len);
+    out[len + 1] = '\0';
+}
+
+/*
+ * Serves one GDB connection until it detaches, kills the target or the
+ * program exits.
+ */
+static void
+gdb_session(APEX_GdbStub *stub)
+{
+    static char packet[GDB_PACKET_SIZE];
+    static char reply[2 * GDB_PACKET_SIZE];
+
+    while (gdb_receive(stub, packet, sizeof(packet)))
+    {
+        reply[0] = '\0';
+
+        switch (packet[0])
+        {
+            case '?':
+            {
+                gdb_stop_reply(stub, stub->halted ? GDB_STOP_EXITED : GDB_STOP_TRAP,
+                               reply);
+                break;
+            }
+
+            case 'g':
+            {
+                for (int i = 0; i < GDB_NUM_REGS; ++i)
+                {
+                    put_word(reply + 8 * i, gdb_read_reg(stub, i));
+                }
+                reply[8 * GDB_NUM_REGS] = '\0';
+                break;
+            }
+
+            case 'G':
+            {
+                int ok = strlen(packet + 1) >= 8 * GDB_NUM_REGS;
+
+                for (int i = 0; ok && i < GDB_NUM_REGS; ++i)
+                {
+                    if (i != GDB_REG_PC || !stub->detailed)
+                    {
+                        ok = gdb_write_reg(stub, i, get_word(packet + 1 + 8 * i));
+                    }
+                }
+                strcpy(reply, ok ? "OK" : "E01");
+                break;
+            }
+
+            case 'p':
+            {
+                int regnum = (int)strtol(packet + 1, NULL, 16);
+
+                if (regnum < GDB_NUM_REGS)
+                {
+                    put_word(reply, gdb_read_reg(stub, regnum));
+                    reply[8] = '\0';
+                }
+                else
+                {
+                    strcpy(reply, "E01");
+                }
+                break;
+            }
+
+            case 'P':
+            {
+                char *value;
+                int regnum = (int)strtol(packet + 1, &value, 16);
+
+                if (*value == '=' && strlen(value + 1) >= 8
+                    && gdb_write_reg(stub, regnum, get_word(value + 1)))
+                {
+                    strcpy(reply, "OK");
+                }
+                else
+                {
+                    strcpy(reply, "E01");
+                }
+                break;
+            }
+
+            case 'm':
+            {
+                unsigned int addr, len;
+
+                if (sscanf(packet + 1, "%x,%x", &addr, &len) == 2)
+                {
+                    gdb_read_memory(stub, addr, len, reply);
+                }
+                else
+                {
+                    strcpy(reply, "E01");
+                }
+                break;
+            }
+
+            case 'M':
+            {
+                unsigned int addr, len;
+                char *data = strchr(packet, ':');
+
+                if (data && sscanf(packet + 1, "%x,%x", &addr, &len) == 2
+                    && strlen(data + 1) >= 2 * len
+                    && gdb_write_memory(stub, addr, len, data + 1))
+                {
+                    strcpy(reply, "OK");
+                }
+                else
+                {
+                    strcpy(reply, "E01");
+                }
+                break;
+            }
+
+            case 'c':
+            {
+                gdb_stop_reply(stub, gdb_continue(stub), reply);
+                break;
+            }
+
+            case 's':
+            {
+                gdb_stop_reply(stub, gdb_step_one(stub), reply);
+                break;
+            }
+
+            case 'Z':
+            case 'z':
+            {
+                strcpy(reply, gdb_set_point(stub, packet) ? "OK" : "E01");
+                break;
+            }
+
+            case 'H':
+            {
+                strcpy(reply, "OK");
+                break;
+            }
+
+            case 'q':
+            {
+                if (strncmp(packet, "qSupported", 10) == 0)
+                {
+                    sprintf(reply, "PacketSize=%x;qXfer:features:read+;QStartNoAckMode+",
+                            GDB_PACKET_SIZE);
+                }
+                else if (strncmp(packet, "qXfer:features:read:", 20) == 0)
+                {
+                    gdb_read_target_xml(packet + 20, reply);
+                }
+                else if (strcmp(packet, "qAttached") == 0)
+                {
+                    strcpy(reply, "1");
+                }
+                break;
+            }
+
+            case 'Q':
+            {
+                if (strcmp(packet, "QStartNoAckMode") == 0)
+                {
+                    gdb_send(stub, "OK");
+                    stub->no_ack = TRUE;
+                    continue;
+                }
+                break;
+            }
+
+            case 'D':
+            {
+                gdb_send(stub, "OK");
+                return;
+            }
+
+            case 'k':
+            {
+                return;
+            }
+
+            case 0x03:
+            {
+                gdb_stop_reply(stub, GDB_STOP_INTERRUPT, reply);
+                break;
+            }
+        }
+
+        if (!gdb_send(stub, reply))
+        {
+            return;
+        }
+    }
+}
+
+/* TRUE when port names a TCP port rather than a Unix socket path */
+static int
+gdb_tcp_port(const char *port)
+{
+    return strspn(port, "0123456789") == strlen(port);
+}
+
+/*
+ * Makes room for a Unix socket at path. Only a socket left over by an
+ * earlier server is removed; anything else there is refused, so that a
+ * mistyped path does not delete a file.
+ */
+static int
+gdb_socket_path_free(const char *path)
+{
+    struct stat st;
+
+    if (lstat(path, &st) < 0)
+    {
+        return TRUE;
+    }
+    if (!S_ISSOCK(st.st_mode))
+    {
+        fprintf(stderr, "APEX_Error: %s exists and is not a socket, not replacing it\n", path);
+        return FALSE;
+    }
+    unlink(path);
+    return TRUE;
+}
+
+/*
+ * Creates the listening socket: a TCP port on localhost when port is a
+ * number, otherwise a Unix socket at that path.
+ */
+static int
+gdb_listen(const char *port)
+{
+    int fd;
+    int one = 1;
+
+    if (gdb_tcp_port(port))
+    {
+        struct sockaddr_in addr;
+
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            return -1;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(atoi(port));
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            close(fd);
+            return -1;
+        }
+    }
+    else
+    {
+        struct sockaddr_un addr;
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            return -1;
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, port, sizeof(addr.sun_path) - 1);
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            close(fd);
+            return -1;
+        }
+    }
+
+    if (listen(fd, 1) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Waits for one GDB connection on port and serves it. detailed selects
+ * the pipeline instead of the functional engine.
+ */
+int
+APEX_gdb_serve(APEX_CPU *cpu, const char *port, int detailed)
+{
+    APEX_GdbStub stub;
+    int listen_fd;
+    int one = 1;
+
+    if (!port)
+    {
+        fprintf(stderr, "APEX_Error: gdb server needs a port or socket path\n");
+        return FALSE;
+    }
+
+    memset(&stub, 0, sizeof(stub));
+    stub.cpu = cpu;
+    stub.detailed = detailed;
+    stub.bp_map = calloc(cpu->code_memory_size, 1);
+    if (!stub.bp_map)
+    {
+        return FALSE;
+    }
+
+    if (!gdb_tcp_port(port) && !gdb_socket_path_free(port))
+    {
+        free(stub.bp_map);
+        return FALSE;
+    }
+    listen_fd = gdb_listen(port);
+    if (listen_fd < 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to listen on %s: %s\n", port,
+                strerror(errno));
+        free(stub.bp_map);
+        return FALSE;
+    }
+
+    printf("APEX gdb server (%s engine) listening on %s\n",
+           detailed ? "pipeline" : "functional", port);
+    fflush(stdout);
+
+    stub.fd = accept(listen_fd, NULL, NULL);
+    close(listen_fd);
+    if (!gdb_tcp_port(port))
+    {
+        /* Only one connection is served, nobody can connect any more */
+        unlink(port);
+    }
+    if (stub.fd < 0)
+    {
+        free(stub.bp_map);
+        return FALSE;
+    }
+    setsockopt(stub.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    gdb_session(&stub);
+
+    close(stub.fd);
+    free(stub.bp_map);
+    return TRUE;
+}
@@ -0,0 +1,11 @@
+/*
+ * apex_gdbstub.h
+ * Contains declarations of the GDB remote serial protocol server
+ */
+#ifndef _APEX_GDBSTUB_H_
+#define _APEX_GDBSTUB_H_
+
+#include "apex_cpu.h"
+
+int APEX_gdb_serve(APEX_CPU *cpu, const char *port, int detailed);
+#endif
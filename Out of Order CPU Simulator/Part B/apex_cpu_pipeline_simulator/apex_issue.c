@@ -0,0 +1,75 @@
+/*
+ * apex_issue.c
+ * Issue report of a pipeline wider than 1: how many instructions decode
+ * issued per cycle, how often it paired them, and what held back the
+ * first instruction that did not issue
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "apex_cpu.h"
+#include "apex_issue.h"
+#include "apex_macros.h"
+
+static const char *limit_names[ISSUE_LIMITS] = {
+    "empty", "operand", "group", "flags", "memory", "multiply", "branch", "unit",
+};
+
+static double
+percent(long long part, long long whole)
+{
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+/*
+ * Runs until HALT, or for the given number of cycles, then reports the
+ * issue width reached in every cycle decode worked in and the reasons it
+ * fell short of config.width.
+ */
+void
+APEX_issue_run(APEX_CPU *cpu, const char *cycles)
+{
+    int max_cycles = cycles ? atoi(cycles) : 0;
+    long long decode_cycles = 0;
+    long long short_cycles = 0;
+    long long paired = 0;
+
+    if (cpu->config.width == 1)
+    {
+        fprintf(stderr, "APEX_Error: issue_stats needs a width above 1\n");
+        return;
+    }
+    while (!APEX_cpu_cycle(cpu) && cpu->clock != max_cycles)
+    {
+    }
+
+    for (int i = 0; i <= cpu->config.width; ++i)
+    {
+        decode_cycles += cpu->issued[i];
+        paired += i > 1 ? cpu->issued[i] : 0;
+    }
+    for (int i = 0; i < ISSUE_LIMITS; ++i)
+    {
+        short_cycles += cpu->issue_limits[i];
+    }
+
+    printf("width %d, pairing %s: %d cycles, %d insns, IPC %.3f, %d cycles held by memory\n",
+           cpu->config.width, cpu->config.pairing ? "on" : "off", cpu->clock,
+           cpu->insn_completed, cpu->clock ? (double)cpu->insn_completed / cpu->clock : 0.0,
+           cpu->mem_stall_cycles);
+    printf("\n%-10s %12s %8s\n", "issued", "cycles", "share");
+    for (int i = 0; i <= cpu->config.width; ++i)
+    {
+        printf("%-10d %12lld %7.2f%%\n", i, cpu->issued[i],
+               percent(cpu->issued[i], decode_cycles));
+    }
+    printf("paired %lld of %lld cycles issuing (%.2f%%)\n", paired,
+           decode_cycles - cpu->issued[0], percent(paired, decode_cycles - cpu->issued[0]));
+
+    printf("\n%-10s %12s %8s\n", "held by", "cycles", "share");
+    for (int i = 0; i < ISSUE_LIMITS; ++i)
+    {
+        printf("%-10s %12lld %7.2f%%\n", limit_names[i], cpu->issue_limits[i],
+               percent(cpu->issue_limits[i], short_cycles));
+    }
+}
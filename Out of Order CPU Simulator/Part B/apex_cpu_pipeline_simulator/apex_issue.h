@@ -0,0 +1,11 @@
+/*
+ * apex_issue.h
+ * Contains declarations of the issue report of superscalar pipelines
+ */
+#ifndef _APEX_ISSUE_H_
+#define _APEX_ISSUE_H_
+
+#include "apex_cpu.h"
+
+void APEX_issue_run(APEX_CPU *cpu, const char *cycles);
+#endif
@@ -12,9 +12,19 @@
 #define FALSE 0x0
 #define TRUE 0x1
 
-/* Integers */
+/* Words of data memory printed by simulate, the size of the original
+ * flat data memory */
 #define DATA_MEMORY_SIZE 4096
 
+/* Data memory: word addresses 0 to 2^31 - 1 (8GB) in lazily allocated
+ * pages of 4KB, MEM_DIR_PAGES pages per directory */
+#define MEM_WORDS (1LL << 31)
+#define MEM_PAGE_SHIFT 10
+#define MEM_PAGE_WORDS (1 << MEM_PAGE_SHIFT)
+#define MEM_DIR_SHIFT 10
+#define MEM_DIR_PAGES (1 << MEM_DIR_SHIFT)
+#define MEM_DIRS (int)(MEM_WORDS >> (MEM_PAGE_SHIFT + MEM_DIR_SHIFT))
+
 /* Size of integer register file */
 #define REG_FILE_SIZE 16
 
@@ -41,6 +51,144 @@
 #define OPCODE_CMP 0x13
 #define OPCODE_NOP 0x14
 #define OPCODE_JUMP 0x15
+#define OPCODE_LL 0x16
+#define OPCODE_SC 0x17
+#define OPCODE_FAA 0x18
+#define OPCODE_FENCE 0x19
+
+/* Size of the tables indexed by opcode */
+#define OPCODE_COUNT 0x1a
+
+/* Longest latency and initiation interval of a functional unit, in cycles */
+#define FU_MAX_LATENCY 100
+
+/* Bypass paths into decode, combined in APEX_Config.bypass */
+#define BYPASS_NONE 0x0
+#define BYPASS_EX 0x1
+#define BYPASS_MEM 0x2
+#define BYPASS_FULL (BYPASS_EX | BYPASS_MEM)
+
+/* Configurations given with c<n>. option prefixes, c0 being the plain
+ * options */
+#define APEX_MAX_CONFIGS 32
+
+/* Data cache levels, indexes of APEX_Caches.level */
+#define CACHE_L1D 0
+#define CACHE_L2 1
+#define CACHE_LEVELS 2
+
+/* Largest cache the model can hold, in lines */
+#define CACHE_L1D_MAX_LINES 1024
+#define CACHE_L2_MAX_LINES 8192
+
+/* Ready cycle of a line whose DRAM read is not scheduled yet */
+#define CACHE_PENDING 0x7fffffff
+
+/* Memory behind the last cache level */
+#define MEMORY_FLAT 0x0
+#define MEMORY_DRAM 0x1
+
+/* DRAM organisation limits and controller queue size; prefetches are
+ * dropped once fewer than DRAM_QUEUE_RESERVE entries are left */
+#define DRAM_MAX_CHANNELS 4
+#define DRAM_MAX_RANKS 4
+#define DRAM_MAX_BANKS 16
+#define DRAM_QUEUE_SIZE 64
+#define DRAM_QUEUE_RESERVE 8
+
+/* Prefetchers attached to a data cache level */
+#define PREFETCH_NONE 0x0
+#define PREFETCH_NEXT_LINE 0x1
+#define PREFETCH_STRIDE 0x2
+#define PREFETCH_STREAM 0x3
+
+/* Prefetcher limits: lines ahead, reference prediction table entries and
+ * stream buffers */
+#define PREFETCH_MAX_DEGREE 16
+#define PREFETCH_RPT_SIZE 64
+#define PREFETCH_STREAMS 4
+
+/* Cores of a multicore run; core n starts with n in MULTICORE_ID_REG and
+ * the number of cores in MULTICORE_COUNT_REG */
+#define MULTICORE_MAX_CORES 16
+#define MULTICORE_ID_REG (REG_FILE_SIZE - 1)
+#define MULTICORE_COUNT_REG (REG_FILE_SIZE - 2)
+
+/* Coherence protocols between the L1Ds of a multicore run */
+#define COHERENCE_MESI 0x0
+#define COHERENCE_MOESI 0x1
+
+/* Instructions a stage of the superscalar pipeline holds at most */
+#define SUPERSCALAR_MAX_WIDTH 8
+
+/* Why decode of a superscalar pipeline issued fewer instructions than its
+ * width: the first instruction held back found */
+#define ISSUE_LIMIT_EMPTY 0x0      /* nothing, decode ran out of them */
+#define ISSUE_LIMIT_OPERAND 0x1    /* an operand of execute or memory not ready */
+#define ISSUE_LIMIT_GROUP 0x2      /* an operand written by an older slot */
+#define ISSUE_LIMIT_FLAGS 0x3      /* an older SC, setting the flags in memory */
+#define ISSUE_LIMIT_MEMORY 0x4     /* a second memory access */
+#define ISSUE_LIMIT_MULTIPLY 0x5   /* a second MUL or DIV */
+#define ISSUE_LIMIT_BRANCH 0x6     /* an older branch */
+#define ISSUE_LIMIT_UNIT 0x7       /* a functional unit still busy */
+#define ISSUE_LIMITS 8
+
+/* Conditional branches an opcode fuses with, combined in APEX_Config.fuse */
+#define FUSE_BZ 0x1
+#define FUSE_BNZ 0x2
+#define FUSE_BP 0x4
+#define FUSE_BNP 0x8
+#define FUSE_BRANCHES 4
+#define FUSE_ANY 0xf
+
+/* Front ends: fetch going on at the next pc, or a branch predictor running
+ * ahead of it through a fetch target queue */
+#define FRONTEND_COUPLED 0x0
+#define FRONTEND_DECOUPLED 0x1
+
+/* Front end limits: fetch target queue entries, branch target buffer
+ * entries and instruction cache lines */
+#define FRONTEND_FTQ_MAX 64
+#define FRONTEND_BTB_MAX 4096
+#define CACHE_L1I_MAX_LINES 1024
+
+/* Branches a branch target buffer entry predicts: conditional ones, and
+ * JUMPs, told apart by the ras_reg convention into calls, the JUMP right
+ * behind a MOVC to ras_reg, returns, a JUMP through ras_reg, and the
+ * others */
+#define BTB_BRANCH 0x0
+#define BTB_JUMP 0x1
+#define BTB_CALL 0x2
+#define BTB_RETURN 0x3
+
+/* Predictors of the target of JUMP: the last one taken, kept in the branch
+ * target buffer, or a target cache indexed with the path taken to it */
+#define INDIRECT_BTB 0x0
+#define INDIRECT_TARGET_CACHE 0x1
+
+/* Target cache entries, return address stack entries and JUMP sites
+ * counted apart, at most */
+#define FRONTEND_ITC_MAX 4096
+#define FRONTEND_RAS_MAX 32
+#define FRONTEND_JUMP_SITES 64
+
+/* Stage branches and JUMP resolve in: decode for those whose flags or
+ * register it can already read, the others in execute, or execute and a
+ * stage later for each stage a deeper pipeline takes to redirect fetch */
+#define RESOLVE_DECODE 0x0
+#define RESOLVE_EXECUTE 0x1
+#define RESOLVE_MEMORY 0x2
+#define RESOLVE_WRITEBACK 0x3
+#define RESOLVE_STAGES 4
+
+/* Threads of an SMT run sharing one pipeline; thread n starts with n in
+ * MULTICORE_ID_REG and the number of threads in MULTICORE_COUNT_REG, like
+ * the cores of a multicore run */
+#define SMT_MAX_THREADS 4
+
+/* Policies choosing the thread fetched in a cycle of an SMT run */
+#define SMT_FETCH_ICOUNT 0x0
+#define SMT_FETCH_ROUND_ROBIN 0x1
 
 /* Set this flag to 1 to enable debug messages */
 #define ENABLE_DEBUG_MESSAGES 1
@@ -48,4 +196,12 @@
 /* Set this flag to 1 to enable cycle single-step mode */
 #define ENABLE_SINGLE_STEP 1
 
+/* Debugger limits: breakpoints of each kind and retained checkpoints */
+#define DEBUG_MAX_POINTS 32
+#define DEBUG_MAX_CHECKPOINTS 256
+
+/* Initial distance in cycles between two debugger checkpoints, doubled
+ * every time the checkpoint store fills up */
+#define DEBUG_CHECKPOINT_INTERVAL 1024
+
 #endif
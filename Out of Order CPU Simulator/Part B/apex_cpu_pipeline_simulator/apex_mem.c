@@ -0,0 +1,381 @@
+/*
+ * apex_mem.c
+ * Sparse data memory: word addresses are split into a directory, a page and
+ * a word within the page. Directories and pages are only allocated when a
+ * non-zero word is written into them, everything else reads as 0.
+ *
+ * Every copy of the CPU owns its directories but shares the pages, each
+ * page counting its holders; a write to a shared page copies it first. The
+ * holders may run on different threads, hence the atomic counts.
+ *
+ * A data image is mapped rather than read: its whole pages point into the
+ * mapping and are only copied when written.
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "apex_macros.h"
+#include "apex_mem.h"
+
+/* A mapped data image, unmapped once no page points into it */
+typedef struct APEX_MemImage
+{
+    _Atomic int refs;
+    void *base;
+    size_t len;
+} APEX_MemImage;
+
+static const int zero_words[MEM_PAGE_WORDS];
+
+static void
+mem_out_of_memory(void)
+{
+    fprintf(stderr, "APEX_Error: Unable to allocate data memory\n");
+    exit(1);
+}
+
+static void
+mem_forget_pages(APEX_Memory *mem)
+{
+    mem->read_page = ~0u;
+    mem->read_words = NULL;
+    mem->write_page = ~0u;
+    mem->write_page_ptr = NULL;
+}
+
+static void
+image_release(APEX_MemImage *image)
+{
+    if (atomic_fetch_sub_explicit(&image->refs, 1, memory_order_acq_rel) == 1)
+    {
+        munmap(image->base, image->len);
+        free(image);
+    }
+}
+
+/* Returns a page of its own words, copied from words or all zero */
+static APEX_MemPage *
+page_new(const int *words)
+{
+    APEX_MemPage *page = malloc(sizeof(APEX_MemPage) + MEM_PAGE_WORDS * sizeof(int));
+
+    if (!page)
+    {
+        mem_out_of_memory();
+    }
+    atomic_init(&page->refs, 1);
+    page->words = page->data;
+    page->image = NULL;
+    memcpy(page->data, words, MEM_PAGE_WORDS * sizeof(int));
+    return page;
+}
+
+static void
+page_release(APEX_MemPage *page)
+{
+    if (atomic_fetch_sub_explicit(&page->refs, 1, memory_order_acq_rel) == 1)
+    {
+        if (page->image)
+        {
+            image_release(page->image);
+        }
+        free(page);
+    }
+}
+
+/*
+ * Returns the slot of the page holding addr, allocating its directory if
+ * create is set, NULL if there is none.
+ */
+static APEX_MemPage **
+mem_slot(APEX_Memory *mem, int addr, int create)
+{
+    APEX_MemPage ***dir = &mem->dir[addr >> (MEM_PAGE_SHIFT + MEM_DIR_SHIFT)];
+
+    if (!*dir)
+    {
+        if (!create)
+        {
+            return NULL;
+        }
+        *dir = calloc(MEM_DIR_PAGES, sizeof(APEX_MemPage *));
+        if (!*dir)
+        {
+            mem_out_of_memory();
+        }
+    }
+    return &(*dir)[(addr >> MEM_PAGE_SHIFT) & (MEM_DIR_PAGES - 1)];
+}
+
+/* Returns the page holding addr, NULL if none was allocated */
+static APEX_MemPage *
+mem_page(const APEX_Memory *mem, int addr)
+{
+    APEX_MemPage **dir = mem->dir[addr >> (MEM_PAGE_SHIFT + MEM_DIR_SHIFT)];
+
+    return dir ? dir[(addr >> MEM_PAGE_SHIFT) & (MEM_DIR_PAGES - 1)] : NULL;
+}
+
+/* Starts with every word 0 and nothing allocated */
+void
+APEX_mem_init(APEX_Memory *mem)
+{
+    memset(mem, 0, sizeof(APEX_Memory));
+    mem_forget_pages(mem);
+}
+
+/*
+ * Gives mem, a plain struct copy of another memory, its own directories
+ * sharing all pages of the original.
+ */
+void
+APEX_mem_clone(APEX_Memory *mem)
+{
+    for (int d = 0; d < MEM_DIRS; ++d)
+    {
+        APEX_MemPage **dir = mem->dir[d];
+
+        if (!dir)
+        {
+            continue;
+        }
+        mem->dir[d] = malloc(MEM_DIR_PAGES * sizeof(APEX_MemPage *));
+        if (!mem->dir[d])
+        {
+            mem_out_of_memory();
+        }
+        memcpy(mem->dir[d], dir, MEM_DIR_PAGES * sizeof(APEX_MemPage *));
+        for (int p = 0; p < MEM_DIR_PAGES; ++p)
+        {
+            if (dir[p])
+            {
+                atomic_fetch_add_explicit(&dir[p]->refs, 1, memory_order_relaxed);
+            }
+        }
+    }
+    mem_forget_pages(mem);
+}
+
+/* Drops every page and directory, leaving an all-zero memory */
+void
+APEX_mem_release(APEX_Memory *mem)
+{
+    for (int d = 0; d < MEM_DIRS; ++d)
+    {
+        if (!mem->dir[d])
+        {
+            continue;
+        }
+        for (int p = 0; p < MEM_DIR_PAGES; ++p)
+        {
+            if (mem->dir[d][p])
+            {
+                page_release(mem->dir[d][p]);
+            }
+        }
+        free(mem->dir[d]);
+        mem->dir[d] = NULL;
+    }
+    mem_forget_pages(mem);
+}
+
+/* Read of a page other than the last one read */
+int
+APEX_mem_read_slow(APEX_Memory *mem, int addr)
+{
+    APEX_MemPage *page;
+
+    if (addr < 0)
+    {
+        mem->faults++;
+        return 0;
+    }
+    page = mem_page(mem, addr);
+    mem->read_page = (unsigned)addr >> MEM_PAGE_SHIFT;
+    mem->read_words = page ? page->words : zero_words;
+    return mem->read_words[addr & (MEM_PAGE_WORDS - 1)];
+}
+
+/*
+ * Write to a page other than the last one written, or to a shared one:
+ * allocates the page, or copies it while other memories or an image hold
+ * it.
+ */
+void
+APEX_mem_write_slow(APEX_Memory *mem, int addr, int value)
+{
+    APEX_MemPage **slot;
+    APEX_MemPage *page;
+
+    if (addr < 0)
+    {
+        mem->faults++;
+        return;
+    }
+
+    slot = mem_slot(mem, addr, value != 0);
+    page = slot ? *slot : NULL;
+    if (!page)
+    {
+        if (value == 0)
+        {
+            return;
+        }
+        *slot = page = page_new(zero_words);
+    }
+    else if (page->image || atomic_load_explicit(&page->refs, memory_order_acquire) > 1)
+    {
+        APEX_MemPage *copy = page_new(page->words);
+
+        page_release(page);
+        *slot = page = copy;
+    }
+
+    mem->read_page = mem->write_page = (unsigned)addr >> MEM_PAGE_SHIFT;
+    mem->read_words = page->words;
+    mem->write_page_ptr = page;
+    page->words[addr & (MEM_PAGE_WORDS - 1)] = value;
+}
+
+/*
+ * Maps the data image in filename, raw 32-bit words in host byte order,
+ * into mem starting at word base. Whole pages of it are shared with the
+ * mapping, the words of a partial page are copied.
+ *
+ * Returns FALSE, after printing why, when the image cannot be mapped.
+ */
+int
+APEX_mem_map(APEX_Memory *mem, const char *filename, int base)
+{
+    APEX_MemImage *image;
+    struct stat st;
+    long long words;
+    long long mapped;
+    const int *data;
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open data image '%s'\n", filename);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return FALSE;
+    }
+    words = st.st_size / (long long)sizeof(int);
+    if (st.st_size % sizeof(int) != 0 || base < 0 || base + words > MEM_WORDS)
+    {
+        fprintf(stderr, "APEX_Error: Data image '%s' of %lld bytes does not fit at word %d\n",
+                filename, (long long)st.st_size, base);
+        close(fd);
+        return FALSE;
+    }
+    if (words == 0)
+    {
+        close(fd);
+        return TRUE;
+    }
+
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    image = malloc(sizeof(APEX_MemImage));
+    if (data == MAP_FAILED || !image)
+    {
+        fprintf(stderr, "APEX_Error: Unable to map data image '%s'\n", filename);
+        if (data != MAP_FAILED)
+        {
+            munmap((void *)data, st.st_size);
+        }
+        free(image);
+        return FALSE;
+    }
+    atomic_init(&image->refs, 1);
+    image->base = (void *)data;
+    image->len = st.st_size;
+
+    /* Pages are only shared when base is page aligned */
+    mapped = base % MEM_PAGE_WORDS ? 0 : words - words % MEM_PAGE_WORDS;
+    for (long long i = 0; i < mapped; i += MEM_PAGE_WORDS)
+    {
+        APEX_MemPage **slot = mem_slot(mem, base + i, TRUE);
+        APEX_MemPage *page = malloc(sizeof(APEX_MemPage));
+
+        if (!page)
+        {
+            mem_out_of_memory();
+        }
+        if (*slot)
+        {
+            page_release(*slot);
+        }
+        atomic_init(&page->refs, 1);
+        page->words = (int *)data + i;
+        page->image = image;
+        atomic_fetch_add_explicit(&image->refs, 1, memory_order_relaxed);
+        *slot = page;
+    }
+    mem_forget_pages(mem);
+    for (long long i = mapped; i < words; ++i)
+    {
+        APEX_mem_write(mem, base + i, data[i]);
+    }
+    image_release(image);
+    return TRUE;
+}
+
+/* Reads the word at addr without touching the last-page shortcuts */
+int
+APEX_mem_peek(const APEX_Memory *mem, int addr)
+{
+    APEX_MemPage *page = addr >= 0 ? mem_page(mem, addr) : NULL;
+
+    return page ? page->words[addr & (MEM_PAGE_WORDS - 1)] : 0;
+}
+
+/* Returns TRUE if every word of a and b is the same */
+int
+APEX_mem_equal(const APEX_Memory *a, const APEX_Memory *b)
+{
+    for (int d = 0; d < MEM_DIRS; ++d)
+    {
+        if (!a->dir[d] && !b->dir[d])
+        {
+            continue;
+        }
+        for (int p = 0; p < MEM_DIR_PAGES; ++p)
+        {
+            APEX_MemPage *pa = a->dir[d] ? a->dir[d][p] : NULL;
+            APEX_MemPage *pb = b->dir[d] ? b->dir[d][p] : NULL;
+
+            if (pa != pb
+                && memcmp(pa ? pa->words : zero_words, pb ? pb->words : zero_words,
+                          sizeof(zero_words)) != 0)
+            {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+/* Returns the number of pages allocated */
+long long
+APEX_mem_pages(const APEX_Memory *mem)
+{
+    long long pages = 0;
+
+    for (int d = 0; d < MEM_DIRS; ++d)
+    {
+        for (int p = 0; mem->dir[d] && p < MEM_DIR_PAGES; ++p)
+        {
+            pages += mem->dir[d][p] != NULL;
+        }
+    }
+    return pages;
+}
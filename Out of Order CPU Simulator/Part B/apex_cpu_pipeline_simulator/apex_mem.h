@@ -0,0 +1,62 @@
+/*
+ * apex_mem.h
+ * Contains declarations of the sparse, paged data memory. Reads and writes
+ * to the page used last are inlined, everything else goes through
+ * apex_mem.c.
+ */
+#ifndef _APEX_MEM_H_
+#define _APEX_MEM_H_
+
+#include <stdatomic.h>
+
+#include "apex_cpu.h"
+
+/* One page of data memory */
+typedef struct APEX_MemPage
+{
+    _Atomic int refs;              /* Memories holding the page */
+    int *words;                    /* data, or MEM_PAGE_WORDS words of image */
+    struct APEX_MemImage *image;   /* Mapped data image holding the words */
+    int data[];
+} APEX_MemPage;
+
+void APEX_mem_init(APEX_Memory *mem);
+void APEX_mem_clone(APEX_Memory *mem);
+void APEX_mem_release(APEX_Memory *mem);
+int APEX_mem_read_slow(APEX_Memory *mem, int addr);
+void APEX_mem_write_slow(APEX_Memory *mem, int addr, int value);
+int APEX_mem_peek(const APEX_Memory *mem, int addr);
+int APEX_mem_map(APEX_Memory *mem, const char *filename, int base);
+int APEX_mem_equal(const APEX_Memory *a, const APEX_Memory *b);
+long long APEX_mem_pages(const APEX_Memory *mem);
+
+static inline int
+APEX_mem_valid(long long addr)
+{
+    return addr >= 0 && addr < MEM_WORDS;
+}
+
+/* Reads the word at addr, 0 if never written or outside the address space */
+static inline int
+APEX_mem_read(APEX_Memory *mem, int addr)
+{
+    if ((unsigned)addr >> MEM_PAGE_SHIFT == mem->read_page)
+    {
+        return mem->read_words[addr & (MEM_PAGE_WORDS - 1)];
+    }
+    return APEX_mem_read_slow(mem, addr);
+}
+
+/* Writes the word at addr, ignored outside the address space */
+static inline void
+APEX_mem_write(APEX_Memory *mem, int addr, int value)
+{
+    if ((unsigned)addr >> MEM_PAGE_SHIFT == mem->write_page
+        && atomic_load_explicit(&mem->write_page_ptr->refs, memory_order_acquire) == 1)
+    {
+        mem->write_page_ptr->words[addr & (MEM_PAGE_WORDS - 1)] = value;
+        return;
+    }
+    APEX_mem_write_slow(mem, addr, value);
+}
+#endif
@@ -0,0 +1,537 @@
+/*
+ * apex_mrc.c
+ * Miss-ratio curves of every LRU data cache geometry from one simulation
+ *
+ * Mattson's stack algorithm: in an LRU set, an access hits in every cache
+ * with more ways than the number of distinct lines touched in that set since
+ * the previous access to the same line (its stack distance). One histogram
+ * of stack distances per set count therefore gives the misses of all
+ * associativities with that many sets, and the set counts 1, 2, 4, ...
+ * MRC_MAX_SETS cover every power-of-two cache size.
+ *
+ * Each set keeps its lines in a treap ordered by last access time, whose
+ * subtree sizes give the number of lines accessed more recently than a given
+ * one in O(log n). A hash table maps line addresses to dense line ids.
+ *
+ * Data memory addresses are treated as byte addresses, as the
+ * post-increment of LDI and STI suggests, so cache_line is in bytes too.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+#include "apex_mrc.h"
+
+/* Largest set count analysed, a power of two */
+#define MRC_MAX_SETS_LOG2 12
+#define MRC_MAX_SETS (1 << MRC_MAX_SETS_LOG2)
+
+/* Associativities reported next to fully associative */
+static const int mrc_ways[] = { 1, 2, 4, 8, 16, 32 };
+#define MRC_NUM_WAYS ((int)(sizeof(mrc_ways) / sizeof(mrc_ways[0])))
+
+/* Largest cache size reported, in bytes */
+#define MRC_MAX_SIZE (16 << 20)
+
+/* Treap node of one line in one set, indexed by line id */
+typedef struct MrcNode
+{
+    long long key;                 /* Time of the last access, -1 if never */
+    unsigned prio;
+    int left;
+    int right;
+    int size;                      /* Nodes in this subtree */
+} MrcNode;
+
+/* LRU stacks of every set of one set count */
+typedef struct MrcLevel
+{
+    int num_sets;
+    MrcNode *nodes;
+    int *roots;
+    long long *hist;               /* Accesses per stack distance */
+} MrcLevel;
+
+struct APEX_StackDist
+{
+    int line_shift;
+    int num_levels;
+    long long now;                 /* Accesses so far */
+    long long cold;                /* First accesses to a line */
+    unsigned seed;
+
+    /* Line address to line id */
+    int *hash_lines;
+    int *hash_ids;
+    int hash_mask;
+    int num_lines;
+    int max_lines;                 /* Capacity of nodes and hist */
+
+    MrcLevel levels[MRC_MAX_SETS_LOG2 + 1];
+};
+
+static int
+node_size(const MrcNode *nodes, int n)
+{
+    return n < 0 ? 0 : nodes[n].size;
+}
+
+static void
+node_update(MrcNode *nodes, int n)
+{
+    nodes[n].size = 1 + node_size(nodes, nodes[n].left) + node_size(nodes, nodes[n].right);
+}
+
+/* Joins two treaps, every key of a being smaller than every key of b */
+static int
+treap_merge(MrcNode *nodes, int a, int b)
+{
+    if (a < 0)
+    {
+        return b;
+    }
+    if (b < 0)
+    {
+        return a;
+    }
+    if (nodes[a].prio > nodes[b].prio)
+    {
+        nodes[a].right = treap_merge(nodes, nodes[a].right, b);
+        node_update(nodes, a);
+        return a;
+    }
+    nodes[b].left = treap_merge(nodes, a, nodes[b].left);
+    node_update(nodes, b);
+    return b;
+}
+
+static int
+treap_erase(MrcNode *nodes, int t, long long key)
+{
+    if (nodes[t].key == key)
+    {
+        return treap_merge(nodes, nodes[t].left, nodes[t].right);
+    }
+    if (key < nodes[t].key)
+    {
+        nodes[t].left = treap_erase(nodes, nodes[t].left, key);
+    }
+    else
+    {
+        nodes[t].right = treap_erase(nodes, nodes[t].right, key);
+    }
+    node_update(nodes, t);
+    return t;
+}
+
+/* Inserts n, whose key is larger than every key in t */
+static int
+treap_push_back(MrcNode *nodes, int t, int n)
+{
+    if (t < 0)
+    {
+        return n;
+    }
+    if (nodes[n].prio > nodes[t].prio)
+    {
+        nodes[n].left = t;
+        node_update(nodes, n);
+        return n;
+    }
+    nodes[t].right = treap_push_back(nodes, nodes[t].right, n);
+    node_update(nodes, t);
+    return t;
+}
+
+/* Number of keys in t larger than key */
+static int
+treap_count_above(const MrcNode *nodes, int t, long long key)
+{
+    int count = 0;
+
+    while (t >= 0)
+    {
+        if (nodes[t].key > key)
+        {
+            count += 1 + node_size(nodes, nodes[t].right);
+            t = nodes[t].left;
+        }
+        else
+        {
+            t = nodes[t].right;
+        }
+    }
+    return count;
+}
+
+static int
+mrc_grow(APEX_StackDist *s)
+{
+    int max_lines = s->max_lines ? 2 * s->max_lines : 1024;
+
+    for (int i = 0; i < s->num_levels; ++i)
+    {
+        MrcLevel *level = &s->levels[i];
+        MrcNode *nodes = realloc(level->nodes, max_lines * sizeof(MrcNode));
+        long long *hist = realloc(level->hist, max_lines * sizeof(long long));
+
+        if (nodes)
+        {
+            level->nodes = nodes;
+        }
+        if (hist)
+        {
+            level->hist = hist;
+            memset(hist + s->max_lines, 0, (max_lines - s->max_lines) * sizeof(long long));
+        }
+        if (!nodes || !hist)
+        {
+            return FALSE;
+        }
+    }
+    s->max_lines = max_lines;
+    return TRUE;
+}
+
+static int
+mrc_rehash(APEX_StackDist *s)
+{
+    int size = s->hash_mask ? 2 * (s->hash_mask + 1) : 4096;
+    int *lines = malloc(size * sizeof(int));
+    int *ids = malloc(size * sizeof(int));
+
+    if (!lines || !ids)
+    {
+        free(lines);
+        free(ids);
+        return FALSE;
+    }
+    memset(ids, -1, size * sizeof(int));
+
+    for (int i = 0; s->hash_ids && i <= s->hash_mask; ++i)
+    {
+        if (s->hash_ids[i] >= 0)
+        {
+            unsigned h = (unsigned)s->hash_lines[i] * 2654435761u & (size - 1);
+
+            while (ids[h] >= 0)
+            {
+                h = (h + 1) & (size - 1);
+            }
+            lines[h] = s->hash_lines[i];
+            ids[h] = s->hash_ids[i];
+        }
+    }
+    free(s->hash_lines);
+    free(s->hash_ids);
+    s->hash_lines = lines;
+    s->hash_ids = ids;
+    s->hash_mask = size - 1;
+    return TRUE;
+}
+
+/* Returns the id of a line address, creating it on first use, or -1 */
+static int
+mrc_line_id(APEX_StackDist *s, int line)
+{
+    unsigned h = (unsigned)line * 2654435761u & s->hash_mask;
+    int id;
+
+    while (s->hash_ids[h] >= 0)
+    {
+        if (s->hash_lines[h] == line)
+        {
+            return s->hash_ids[h];
+        }
+        h = (h + 1) & s->hash_mask;
+    }
+
+    if (s->num_lines == s->max_lines && !mrc_grow(s))
+    {
+        return -1;
+    }
+    id = s->num_lines++;
+    s->hash_lines[h] = line;
+    s->hash_ids[h] = id;
+
+    s->seed ^= s->seed << 13;
+    s->seed ^= s->seed >> 17;
+    s->seed ^= s->seed << 5;
+    for (int i = 0; i < s->num_levels; ++i)
+    {
+        MrcNode *node = &s->levels[i].nodes[id];
+
+        node->key = -1;
+        node->prio = s->seed;
+        node->left = node->right = -1;
+        node->size = 1;
+    }
+
+    /* Keep the table at most half full */
+    if (2 * s->num_lines > s->hash_mask && !mrc_rehash(s))
+    {
+        return -1;
+    }
+    return id;
+}
+
+/*
+ * Creates the LRU stacks of 1, 2, 4, ... 2^(num_levels - 1) sets of
+ * line_bytes lines. Returns NULL when out of memory.
+ */
+APEX_StackDist *
+APEX_stackdist_create(int line_bytes, int num_levels)
+{
+    APEX_StackDist *s = calloc(1, sizeof(APEX_StackDist));
+
+    if (!s)
+    {
+        return NULL;
+    }
+    s->num_levels = num_levels;
+    for (int i = 0; i < num_levels; ++i)
+    {
+        s->levels[i].num_sets = 1 << i;
+        s->levels[i].roots = malloc((1 << i) * sizeof(int));
+        if (!s->levels[i].roots)
+        {
+            APEX_stackdist_free(s);
+            return NULL;
+        }
+        memset(s->levels[i].roots, -1, (1 << i) * sizeof(int));
+    }
+    while ((1 << s->line_shift) < line_bytes)
+    {
+        s->line_shift++;
+    }
+    s->seed = 2463534242u;
+    if (!mrc_grow(s) || !mrc_rehash(s))
+    {
+        APEX_stackdist_free(s);
+        return NULL;
+    }
+    return s;
+}
+
+void
+APEX_stackdist_free(APEX_StackDist *s)
+{
+    for (int i = 0; i < s->num_levels; ++i)
+    {
+        free(s->levels[i].nodes);
+        free(s->levels[i].roots);
+        free(s->levels[i].hist);
+    }
+    free(s->hash_lines);
+    free(s->hash_ids);
+    free(s);
+}
+
+/*
+ * Moves the line of one access to the top of its set in every level and
+ * stores its fully associative stack distance, the number of distinct lines
+ * touched since its previous access, in *distance (-1 on the first access).
+ *
+ * Returns FALSE when out of memory.
+ */
+int
+APEX_stackdist_access(APEX_StackDist *s, int addr, int *distance)
+{
+    int line = addr >> s->line_shift;
+    int id = mrc_line_id(s, line);
+
+    if (id < 0)
+    {
+        return FALSE;
+    }
+
+    *distance = -1;
+    if (s->levels[0].nodes[id].key < 0)
+    {
+        s->cold++;
+    }
+
+    for (int i = 0; i < s->num_levels; ++i)
+    {
+        MrcLevel *level = &s->levels[i];
+        MrcNode *node = &level->nodes[id];
+        int *root = &level->roots[line & (level->num_sets - 1)];
+
+        if (node->key >= 0)
+        {
+            int d = treap_count_above(level->nodes, *root, node->key);
+
+            level->hist[d]++;
+            if (i == 0)
+            {
+                *distance = d;
+            }
+            *root = treap_erase(level->nodes, *root, node->key);
+        }
+        node->key = s->now;
+        node->left = node->right = -1;
+        node->size = 1;
+        *root = treap_push_back(level->nodes, *root, id);
+    }
+    s->now++;
+    return TRUE;
+}
+
+/* Number of accesses so far, the time stamp of the next one */
+long long
+APEX_stackdist_time(const APEX_StackDist *s)
+{
+    return s->now;
+}
+
+/* Number of distinct lines accessed since the given time stamp */
+int
+APEX_stackdist_lines_since(const APEX_StackDist *s, long long time)
+{
+    return treap_count_above(s->levels[0].nodes, s->levels[0].roots[0], time - 1);
+}
+
+/* Misses of an LRU cache with 2^level sets of the given number of ways */
+static long long
+mrc_misses(const APEX_StackDist *s, int level, int ways)
+{
+    long long hits = 0;
+
+    for (int d = 0; d < ways && d < s->num_lines; ++d)
+    {
+        hits += s->levels[level].hist[d];
+    }
+    return s->now - hits;
+}
+
+static void
+mrc_format_size(char *buf, int size, long long bytes)
+{
+    if (bytes >= (1 << 20) && bytes % (1 << 20) == 0)
+    {
+        snprintf(buf, size, "%lldMB", bytes >> 20);
+    }
+    else if (bytes >= 1024 && bytes % 1024 == 0)
+    {
+        snprintf(buf, size, "%lldKB", bytes >> 10);
+    }
+    else
+    {
+        snprintf(buf, size, "%lldB", bytes);
+    }
+}
+
+static void
+mrc_print(const APEX_StackDist *s, long long loads)
+{
+    long long line_bytes = 1LL << s->line_shift;
+
+    printf("APEX_MRC: %lld data accesses (%lld loads, %lld stores), "
+           "%d distinct %lld-byte lines, %lld compulsory misses\n",
+           s->now, loads, s->now - loads, s->num_lines, line_bytes, s->cold);
+    printf("%-8s", "size");
+    for (int w = 0; w < MRC_NUM_WAYS; ++w)
+    {
+        printf(" %7d-way", mrc_ways[w]);
+    }
+    printf(" %11s\n", "full");
+
+    /* Rows double the size until everything fits a fully associative cache */
+    for (long long lines = 1; lines * line_bytes <= MRC_MAX_SIZE; lines *= 2)
+    {
+        int full_level = 0;
+        long long full_misses;
+        char size[24]; /* the 20 characters of any long long, unit and NUL */
+
+        mrc_format_size(size, sizeof(size), lines * line_bytes);
+        printf("%-8s", size);
+
+        for (int w = 0; w < MRC_NUM_WAYS; ++w)
+        {
+            long long sets = lines / mrc_ways[w];
+            int level = 0;
+
+            while ((1LL << level) < sets)
+            {
+                level++;
+            }
+            if (sets < 1 || level > MRC_MAX_SETS_LOG2 || !s->now)
+            {
+                printf(" %11s", "-");
+                continue;
+            }
+            printf(" %11.4f", (double)mrc_misses(s, level, mrc_ways[w]) / s->now);
+        }
+
+        full_misses = s->now ? mrc_misses(s, full_level, (int)lines) : 0;
+        printf(" %11.4f\n", s->now ? (double)full_misses / s->now : 0.0);
+        if (full_misses == s->cold)
+        {
+            break;
+        }
+    }
+}
+
+/*
+ * Simulates the pipeline until HALT retires, or for the given number of
+ * cycles, feeding every load and store leaving the memory stage into the
+ * LRU stacks, then prints the miss ratio of every cache size (rows) and
+ * associativity (columns) with lines of cpu->config.cache_line bytes.
+ */
+void
+APEX_mrc_run(APEX_CPU *cpu, const char *cycles)
+{
+    APEX_StackDist *s = APEX_stackdist_create(cpu->config.cache_line,
+                                              MRC_MAX_SETS_LOG2 + 1);
+    int max_cycles = cycles ? atoi(cycles) : 0;
+    int ok = s != NULL;
+    long long loads = 0;
+
+    while (ok)
+    {
+        int stop = APEX_cpu_cycle(cpu);
+        int distance;
+
+        if (cpu->mp == 1)
+        {
+            switch (cpu->pmemory.opcode)
+            {
+                case OPCODE_LOAD:
+                case OPCODE_LDI:
+                case OPCODE_LL:
+                {
+                    loads++;
+                }
+                /* fall through */
+                case OPCODE_STORE:
+                case OPCODE_STI:
+                case OPCODE_SC:
+                case OPCODE_FAA:
+                {
+                    ok = APEX_stackdist_access(s, cpu->pmemory.memory_address, &distance);
+                    break;
+                }
+            }
+        }
+
+        if (stop || (max_cycles > 0 && cpu->clock == max_cycles))
+        {
+            break;
+        }
+    }
+
+    if (!ok)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate stack distance state\n");
+    }
+    else
+    {
+        mrc_print(s, loads);
+    }
+    if (s)
+    {
+        APEX_stackdist_free(s);
+    }
+}
@@ -0,0 +1,20 @@
+/*
+ * apex_mrc.h
+ * Contains declarations of the LRU stack distance tracker and of the
+ * single-pass miss-ratio curve analysis of the data memory access stream
+ */
+#ifndef _APEX_MRC_H_
+#define _APEX_MRC_H_
+
+#include "apex_cpu.h"
+
+/* LRU stacks of a stream of addresses at several set counts */
+typedef struct APEX_StackDist APEX_StackDist;
+
+APEX_StackDist *APEX_stackdist_create(int line_bytes, int num_levels);
+int APEX_stackdist_access(APEX_StackDist *s, int addr, int *distance);
+long long APEX_stackdist_time(const APEX_StackDist *s);
+int APEX_stackdist_lines_since(const APEX_StackDist *s, long long time);
+void APEX_stackdist_free(APEX_StackDist *s);
+void APEX_mrc_run(APEX_CPU *cpu, const char *cycles);
+#endif
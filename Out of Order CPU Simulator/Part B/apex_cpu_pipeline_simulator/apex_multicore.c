@@ -0,0 +1,992 @@
+/*
+ * apex_multicore.c
+ * Multicore runs: config.cores copies of the program, each with its own
+ * pipeline and L1D and simulated on its own host thread, sharing the L2,
+ * memory and data memory. Core n starts with n in MULTICORE_ID_REG and the
+ * number of cores in MULTICORE_COUNT_REG to pick its share of the work.
+ *
+ * The cores run quanta of config.quantum cycles in parallel and meet at a
+ * barrier after each one. Within a quantum nothing shared changes:
+ *
+ * - an L1D miss is timed against the shared L2 and DRAM as they stood at
+ *   the start of the quantum, as if it were the only request in flight
+ * - a core sees its own stores at once, those of the other cores from the
+ *   next quantum on
+ *
+ * Every miss, upgrade, write back and store is logged instead. At the
+ * barrier one thread sorts the logs of all cores by cycle, then core, and
+ * replays the misses and write backs on the coherence directory and the
+ * shared L2 and DRAM; every core then applies the stores in that order to
+ * its data memory. The outcome only depends on the simulated cycles, never
+ * on how the host schedules the threads.
+ *
+ * The L1Ds are kept coherent by a MESI (or MOESI) directory with an entry
+ * per line, listing the cores that may hold it and the one owning it in E,
+ * M or O. Clean lines leave an L1D silently, so the directory checks the
+ * L1D of a listed core before acting on it. The state of an L1D line is
+ * its dirty and shared bits: S and O lines must be upgraded before a store,
+ * which invalidates every other copy. Timing follows the hops of the
+ * protocol, interconnect_latency cycles each:
+ *
+ * - a miss goes to the directory and back, around the shared L2, or is
+ *   forwarded to the owner which sends the line: three hops
+ * - a store miss or upgrade waiting for invalidations takes three hops,
+ *   an upgrade nobody else holds the line for two
+ *
+ * As with stores, invalidations reach the other L1Ds at the end of the
+ * quantum. A miss on a line the core lost to an invalidation is a
+ * coherence miss, and false sharing if no other core stored to the word it
+ * wants since (words are told apart modulo 64 in longer lines).
+ *
+ * LL, SC, FAA and FENCE stop their core until the barrier, where they are
+ * performed in cycle order with the stores of all cores on a reference copy
+ * of data memory, their own stores joining the others. Each core keeps its
+ * LL reservation there, lost to any store of another core to the word. The
+ * SC and FAA on a line are serialised: one starts once the previous one
+ * completed, the wait counting as contention. A stopped core resumes in
+ * the next quantum from the cycle it stopped at; quanta end quantum cycles
+ * after the core furthest behind, so no core runs more than a quantum
+ * ahead of another.
+ */
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "apex_cache.h"
+#include "apex_cpu.h"
+#include "apex_dram.h"
+#include "apex_macros.h"
+#include "apex_mem.h"
+#include "apex_multicore.h"
+
+/* Kinds of MulticoreEvent */
+#define EVENT_STORE 0
+#define EVENT_READ 1               /* L1D load miss */
+#define EVENT_PREFETCH 2
+#define EVENT_EXCLUSIVE 3          /* L1D store miss */
+#define EVENT_UPGRADE 4            /* Store to an S or O line */
+#define EVENT_WRITE_BACK 5
+#define EVENT_LL 6                 /* Atomics and fences stopping the core */
+#define EVENT_SC 7
+#define EVENT_FAA 8
+#define EVENT_FENCE 9
+
+/* Initial directory entries, a power of two */
+#define DIR_INITIAL_SIZE 1024
+
+/* Lines listed in the coherence report */
+#define COHERENCE_TOP 10
+
+/* Something a core did to shared state during a quantum */
+typedef struct MulticoreEvent
+{
+    int cycle;
+    int core;
+    int seq;                       /* Order among the events of the core */
+    int kind;                      /* EVENT_* */
+    int addr;                      /* Word of a store or atomic, line
+                                    * otherwise */
+    int value;                     /* Word stored or added, or the word a
+                                    * miss or upgrade is for */
+} MulticoreEvent;
+
+/* Directory entry of a line, with its coherence counters */
+typedef struct DirEntry
+{
+    int line;                      /* -1 for a free slot */
+    int owner;                     /* Core holding it E, M or O, or -1 */
+    unsigned sharers;              /* Cores that may hold a copy */
+    unsigned invalidated;          /* Cores that lost their copy to a store
+                                    * and have not missed on it since */
+    unsigned long long written[MULTICORE_MAX_CORES]; /* Words other cores
+                                    * stored to since each invalidation */
+    long long invalidations;
+    long long coherence_misses;
+    long long false_sharing;
+    int atomic_free;               /* Cycle the last SC or FAA on the line
+                                    * completed */
+} DirEntry;
+
+typedef struct APEX_Core
+{
+    int id;
+    int halted;
+    APEX_CPU *cpu;
+    struct Multicore *mc;
+    MulticoreEvent *events;        /* Logged during the current quantum */
+    int num_events;
+    int max_events;
+    int waiting;                   /* Stopped at an atomic or fence */
+    int atomic_done;               /* Cycle it would complete on its own */
+    int atomic_result;             /* Value for rd, set at the barrier */
+    int link;                      /* Word reserved by LL, -1 if none */
+    long long atomics;             /* LL, SC and FAA performed */
+    long long sc_failed;
+    long long fences;
+    long long contention;          /* Cycles waited for SC and FAA of
+                                    * other cores on the same line */
+} APEX_Core;
+
+typedef struct Multicore
+{
+    int num_cores;
+    int until;                     /* Cycle the current quantum ends at */
+    int max_cycles;                /* 0 for no limit */
+    int done;
+    int barriers;
+    APEX_CPU *shared;              /* Holds the shared L2 and DRAM */
+    APEX_Memory memory;            /* Data memory with every event so far
+                                    * applied in order */
+    APEX_Core core[MULTICORE_MAX_CORES];
+    MulticoreEvent *merged;        /* Events of the last quantum, in order */
+    int num_merged;
+    int max_merged;
+    DirEntry *dir;                 /* Open addressing on the line */
+    unsigned dir_mask;
+    int dir_used;
+    long long upgrades;
+    long long transfers;           /* Lines sent by another L1D */
+    long long invalidations;
+    long long coherence_misses;
+    long long false_sharing;
+    pthread_barrier_t barrier;
+} Multicore;
+
+static void
+out_of_memory(void)
+{
+    fprintf(stderr, "APEX_Error: Unable to allocate multicore state\n");
+    exit(1);
+}
+
+static unsigned
+dir_hash(int line)
+{
+    return (unsigned)line * 2654435761u;
+}
+
+/* Returns the directory entry of line, NULL if no L1D ever missed on it */
+static DirEntry *
+dir_find(const Multicore *mc, int line)
+{
+    for (unsigned i = dir_hash(line) & mc->dir_mask;; i = (i + 1) & mc->dir_mask)
+    {
+        if (mc->dir[i].line == line)
+        {
+            return &mc->dir[i];
+        }
+        if (mc->dir[i].line < 0)
+        {
+            return NULL;
+        }
+    }
+}
+
+static DirEntry *
+dir_alloc(unsigned size)
+{
+    DirEntry *dir = calloc(size, sizeof(DirEntry));
+
+    if (!dir)
+    {
+        out_of_memory();
+    }
+    for (unsigned i = 0; i < size; ++i)
+    {
+        dir[i].line = -1;
+        dir[i].owner = -1;
+    }
+    return dir;
+}
+
+/* Returns the directory entry of line, adding it if needed */
+static DirEntry *
+dir_get(Multicore *mc, int line)
+{
+    DirEntry *e = dir_find(mc, line);
+    unsigned i;
+
+    if (e)
+    {
+        return e;
+    }
+    if (2 * (mc->dir_used + 1) > (int)mc->dir_mask + 1)
+    {
+        DirEntry *old = mc->dir;
+        unsigned old_size = mc->dir_mask + 1;
+
+        mc->dir = dir_alloc(2 * old_size);
+        mc->dir_mask = 2 * old_size - 1;
+        for (unsigned j = 0; j < old_size; ++j)
+        {
+            if (old[j].line < 0)
+            {
+                continue;
+            }
+            for (i = dir_hash(old[j].line) & mc->dir_mask; mc->dir[i].line >= 0;
+                 i = (i + 1) & mc->dir_mask)
+            {
+            }
+            mc->dir[i] = old[j];
+        }
+        free(old);
+    }
+    for (i = dir_hash(line) & mc->dir_mask; mc->dir[i].line >= 0; i = (i + 1) & mc->dir_mask)
+    {
+    }
+    mc->dir[i].line = line;
+    mc->dir_used++;
+    return &mc->dir[i];
+}
+
+/* Cores other than core the directory lists as holding a copy */
+static unsigned
+dir_others(const DirEntry *e, int core)
+{
+    unsigned holders;
+
+    if (!e)
+    {
+        return 0;
+    }
+    holders = e->sharers | (e->owner >= 0 ? 1u << e->owner : 0);
+    return holders & ~(1u << core);
+}
+
+static void
+core_log(APEX_Core *core, int cycle, int kind, int addr, int value)
+{
+    MulticoreEvent *ev;
+
+    if (core->num_events == core->max_events)
+    {
+        core->max_events = core->max_events ? 2 * core->max_events : 256;
+        core->events = realloc(core->events, core->max_events * sizeof(MulticoreEvent));
+        if (!core->events)
+        {
+            out_of_memory();
+        }
+    }
+    ev = &core->events[core->num_events];
+    ev->cycle = cycle;
+    ev->core = core->id;
+    ev->seq = core->num_events++;
+    ev->kind = kind;
+    ev->addr = addr;
+    ev->value = value;
+}
+
+/*
+ * Called for a line missing in the L1D of a core, the request for the word
+ * addr leaving at cycle arrival; a store asks for the only copy. Returns
+ * the cycle the line arrives.
+ */
+int
+APEX_multicore_miss(APEX_CPU *cpu, int addr, int line, int arrival, int is_store,
+                    int prefetch)
+{
+    const Multicore *mc = cpu->core->mc;
+    const DirEntry *e = dir_find(mc, line);
+    int hop = cpu->config.interconnect_latency;
+    int id = cpu->core->id;
+    int done;
+
+    core_log(cpu->core, arrival,
+             prefetch ? EVENT_PREFETCH : is_store ? EVENT_EXCLUSIVE : EVENT_READ, line, addr);
+    if (e && e->owner >= 0 && e->owner != id)
+    {
+        return arrival + 3 * hop;
+    }
+    done = APEX_cache_estimate(mc->shared, line, arrival + hop) + hop;
+    if (is_store && dir_others(e, id) && done < arrival + 3 * hop)
+    {
+        done = arrival + 3 * hop;
+    }
+    return done;
+}
+
+/*
+ * Called for a store to the word addr of an S or O line, the upgrade
+ * request leaving at cycle now. Returns the cycle the store may complete.
+ */
+int
+APEX_multicore_upgrade(APEX_CPU *cpu, int addr, int line, int now)
+{
+    const Multicore *mc = cpu->core->mc;
+    int hops = dir_others(dir_find(mc, line), cpu->core->id) ? 3 : 2;
+
+    core_log(cpu->core, now, EVENT_UPGRADE, line, addr);
+    return now + hops * cpu->config.interconnect_latency;
+}
+
+/* Returns TRUE if line is listed in other L1Ds than that of cpu */
+int
+APEX_multicore_shared(APEX_CPU *cpu, int line)
+{
+    return dir_others(dir_find(cpu->core->mc, line), cpu->core->id) != 0;
+}
+
+/* Called for a dirty line the L1D of a core evicts */
+void
+APEX_multicore_write(APEX_CPU *cpu, int line)
+{
+    core_log(cpu->core, cpu->clock, EVENT_WRITE_BACK, line, 0);
+}
+
+/* Called for every store a core makes to its data memory */
+void
+APEX_multicore_store(APEX_CPU *cpu, int addr, int value)
+{
+    core_log(cpu->core, cpu->clock, EVENT_STORE, addr, value);
+}
+
+/*
+ * Called for an LL, SC, FAA or FENCE entering memory, which would
+ * complete at cycle done on its own. The core stops until the barrier,
+ * which sets cpu->mem_done and the result.
+ */
+void
+APEX_multicore_atomic(APEX_CPU *cpu, int opcode, int addr, int value, int done)
+{
+    int kind = opcode == OPCODE_LL ? EVENT_LL
+               : opcode == OPCODE_SC ? EVENT_SC
+               : opcode == OPCODE_FAA ? EVENT_FAA : EVENT_FENCE;
+
+    core_log(cpu->core, cpu->clock, kind, addr, value);
+    cpu->core->waiting = TRUE;
+    cpu->core->atomic_done = done;
+}
+
+/* Returns the value the last atomic of a core writes to rd */
+int
+APEX_multicore_result(const APEX_CPU *cpu)
+{
+    return cpu->core->atomic_result;
+}
+
+static int
+event_compare(const void *a, const void *b)
+{
+    const MulticoreEvent *x = a;
+    const MulticoreEvent *y = b;
+
+    if (x->cycle != y->cycle)
+    {
+        return x->cycle < y->cycle ? -1 : 1;
+    }
+    if (x->core != y->core)
+    {
+        return x->core - y->core;
+    }
+    return x->seq - y->seq;
+}
+
+static APEX_CacheLine *
+core_line(const Multicore *mc, int core, int line)
+{
+    return APEX_cache_find(mc->core[core].cpu, CACHE_L1D, line);
+}
+
+/* Bit of the word addr within its line, modulo 64 */
+static unsigned long long
+word_bit(const Multicore *mc, int addr)
+{
+    return 1ULL << ((addr & (mc->shared->config.cache_line - 1)) & 63);
+}
+
+/* Counts a miss of core on the word addr if it lost the line to a store */
+static void
+coherence_miss(Multicore *mc, DirEntry *e, int core, int addr)
+{
+    if (!(e->invalidated & (1u << core)))
+    {
+        return;
+    }
+    e->invalidated &= ~(1u << core);
+    e->coherence_misses++;
+    mc->coherence_misses++;
+    if (!(e->written[core] & word_bit(mc, addr)))
+    {
+        e->false_sharing++;
+        mc->false_sharing++;
+    }
+}
+
+/*
+ * A read miss or prefetch: the owner, if any, sends the line and keeps a
+ * copy, writing it back under MESI and keeping it O under MOESI; otherwise
+ * it comes from the shared L2. The reader gets E if nobody else holds it.
+ */
+static void
+dir_read(Multicore *mc, const MulticoreEvent *ev, int now)
+{
+    DirEntry *e = dir_get(mc, ev->addr);
+    int core = ev->core;
+    int owner = e->owner;
+    APEX_CacheLine *held = owner >= 0 && owner != core ? core_line(mc, owner, e->line) : NULL;
+    APEX_CacheLine *mine = core_line(mc, core, e->line);
+    unsigned live = 0;
+
+    if (ev->kind == EVENT_READ)
+    {
+        coherence_miss(mc, e, core, ev->value);
+    }
+    if (held)
+    {
+        mc->transfers++;
+        if (held->dirty && mc->shared->config.coherence == COHERENCE_MESI)
+        {
+            APEX_cache_shared_access(mc->shared, e->line, now, TRUE, FALSE);
+            held->dirty = FALSE;
+        }
+    }
+    else
+    {
+        APEX_cache_shared_access(mc->shared, e->line, now, FALSE, ev->kind == EVENT_PREFETCH);
+    }
+
+    for (int i = 0; i < mc->num_cores; ++i)
+    {
+        APEX_CacheLine *copy = i != core && (dir_others(e, core) & (1u << i))
+                                   ? core_line(mc, i, e->line) : NULL;
+
+        if (copy)
+        {
+            copy->shared = TRUE;
+            live |= 1u << i;
+        }
+    }
+    e->sharers = live | (1u << core);
+    e->owner = held && held->dirty ? owner : live ? -1 : core;
+    if (mine)
+    {
+        mine->shared = live != 0;
+    }
+}
+
+/*
+ * A store miss or upgrade: every other copy is invalidated, a dirty one
+ * being sent to the writer, which becomes the owner in M
+ */
+static void
+dir_write(Multicore *mc, const MulticoreEvent *ev, int now)
+{
+    DirEntry *e = dir_get(mc, ev->addr);
+    int core = ev->core;
+    unsigned others = dir_others(e, core);
+    int sent = FALSE;
+
+    if (ev->kind == EVENT_EXCLUSIVE)
+    {
+        coherence_miss(mc, e, core, ev->value);
+    }
+    for (int i = 0; i < mc->num_cores; ++i)
+    {
+        APEX_CacheLine *copy = others & (1u << i) ? core_line(mc, i, e->line) : NULL;
+
+        if (!copy)
+        {
+            continue;
+        }
+        sent |= copy->dirty;
+        copy->line = -1;
+        copy->dirty = FALSE;
+        copy->shared = FALSE;
+        copy->prefetched = FALSE;
+        e->invalidations++;
+        mc->invalidations++;
+        e->invalidated |= 1u << i;
+        e->written[i] = word_bit(mc, ev->value);
+    }
+
+    if (ev->kind == EVENT_UPGRADE)
+    {
+        mc->upgrades++;
+    }
+    else if (sent)
+    {
+        mc->transfers++;
+    }
+    else
+    {
+        APEX_cache_shared_access(mc->shared, e->line, now, FALSE, FALSE);
+    }
+    e->sharers = 1u << core;
+    e->owner = core;
+}
+
+/* A dirty line leaving an L1D goes to the shared L2 */
+static void
+dir_write_back(Multicore *mc, const MulticoreEvent *ev, int now)
+{
+    DirEntry *e = dir_find(mc, ev->addr);
+
+    APEX_cache_shared_access(mc->shared, ev->addr, now, TRUE, FALSE);
+    if (e)
+    {
+        e->sharers &= ~(1u << ev->core);
+        if (e->owner == ev->core)
+        {
+            e->owner = -1;
+        }
+    }
+}
+
+/* A store: other cores that lost the line now miss on written data */
+static void
+dir_store(Multicore *mc, const MulticoreEvent *ev)
+{
+    DirEntry *e = dir_find(mc, ev->addr >> mc->shared->caches.line_shift);
+
+    if (!e)
+    {
+        return;
+    }
+    for (int i = 0; i < mc->num_cores; ++i)
+    {
+        if (i != ev->core && (e->invalidated & (1u << i)))
+        {
+            e->written[i] |= word_bit(mc, ev->addr);
+        }
+    }
+}
+
+/* A store in the global order: reservations of other cores on it are lost */
+static void
+memory_store(Multicore *mc, const MulticoreEvent *ev)
+{
+    APEX_mem_write(&mc->memory, ev->addr, ev->value);
+    for (int i = 0; i < mc->num_cores; ++i)
+    {
+        if (i != ev->core && mc->core[i].link == ev->addr)
+        {
+            mc->core[i].link = -1;
+        }
+    }
+    dir_store(mc, ev);
+}
+
+/*
+ * Performs an atomic or fence in the global order and lets its core go on.
+ * A successful SC or an FAA becomes a store of the quantum.
+ */
+static void
+atomic_perform(Multicore *mc, MulticoreEvent *ev)
+{
+    APEX_Core *core = &mc->core[ev->core];
+    int old = APEX_mem_read(&mc->memory, ev->addr);
+    int done = core->atomic_done;
+    int writes = ev->kind == EVENT_FAA || (ev->kind == EVENT_SC && core->link == ev->addr);
+    DirEntry *e;
+
+    core->waiting = FALSE;
+    if (ev->kind == EVENT_FENCE)
+    {
+        core->fences++;
+        core->cpu->mem_done = done;
+        return;
+    }
+
+    /* Wait for an SC or FAA of another core holding the line */
+    e = dir_get(mc, ev->addr >> mc->shared->caches.line_shift);
+    if (e->atomic_free > ev->cycle)
+    {
+        core->contention += e->atomic_free - ev->cycle;
+        done += e->atomic_free - ev->cycle;
+    }
+    if (writes)
+    {
+        e->atomic_free = done;
+    }
+    core->cpu->mem_done = done;
+    core->atomics++;
+
+    switch (ev->kind)
+    {
+        case EVENT_LL:
+        {
+            core->atomic_result = old;
+            core->link = ev->addr;
+            break;
+        }
+
+        case EVENT_SC:
+        {
+            core->atomic_result = writes;
+            core->sc_failed += !writes;
+            core->link = -1;
+            break;
+        }
+
+        case EVENT_FAA:
+        {
+            core->atomic_result = old;
+            ev->value += old;
+            break;
+        }
+    }
+
+    if (writes)
+    {
+        ev->kind = EVENT_STORE;
+        memory_store(mc, ev);
+    }
+}
+
+/*
+ * Run by one thread while the others wait: orders the events of the
+ * quantum, replays them on the directory and the shared levels and sets
+ * the next quantum up
+ */
+static void
+multicore_weave(Multicore *mc)
+{
+    int total = 0;
+    int halted = 0;
+    int behind = INT_MAX;
+
+    for (int i = 0; i < mc->num_cores; ++i)
+    {
+        total += mc->core[i].num_events;
+    }
+    if (total > mc->max_merged)
+    {
+        mc->max_merged = total;
+        mc->merged = realloc(mc->merged, total * sizeof(MulticoreEvent));
+        if (!mc->merged)
+        {
+            out_of_memory();
+        }
+    }
+    mc->num_merged = 0;
+    for (int i = 0; i < mc->num_cores; ++i)
+    {
+        APEX_Core *core = &mc->core[i];
+
+        for (int j = 0; j < core->num_events; ++j)
+        {
+            mc->merged[mc->num_merged++] = core->events[j];
+        }
+        core->num_events = 0;
+        halted += core->halted;
+    }
+    if (mc->num_merged)
+    {
+        qsort(mc->merged, mc->num_merged, sizeof(MulticoreEvent), event_compare);
+    }
+
+    for (int i = 0; i < mc->num_merged; ++i)
+    {
+        MulticoreEvent *ev = &mc->merged[i];
+        int now = ev->cycle > mc->shared->clock ? ev->cycle : mc->shared->clock;
+
+        switch (ev->kind)
+        {
+            case EVENT_STORE:
+            {
+                memory_store(mc, ev);
+                break;
+            }
+
+            case EVENT_LL:
+            case EVENT_SC:
+            case EVENT_FAA:
+            case EVENT_FENCE:
+            {
+                atomic_perform(mc, ev);
+                break;
+            }
+
+            case EVENT_READ:
+            case EVENT_PREFETCH:
+            {
+                dir_read(mc, ev, now);
+                break;
+            }
+
+            case EVENT_EXCLUSIVE:
+            case EVENT_UPGRADE:
+            {
+                dir_write(mc, ev, now);
+                break;
+            }
+
+            case EVENT_WRITE_BACK:
+            {
+                dir_write_back(mc, ev, now);
+                break;
+            }
+        }
+    }
+
+    /* Cores stopped at an atomic lag behind; the next quantum ends a
+     * quantum after the one furthest behind */
+    mc->barriers++;
+    for (int i = 0; i < mc->num_cores; ++i)
+    {
+        if (!mc->core[i].halted && mc->core[i].cpu->clock < behind)
+        {
+            behind = mc->core[i].cpu->clock;
+        }
+    }
+    if (halted == mc->num_cores || (mc->max_cycles && behind >= mc->max_cycles))
+    {
+        mc->done = TRUE;
+        return;
+    }
+    mc->until = behind + mc->shared->config.quantum;
+    if (mc->max_cycles && mc->until > mc->max_cycles)
+    {
+        mc->until = mc->max_cycles;
+    }
+}
+
+static void *
+core_thread(void *arg)
+{
+    APEX_Core *core = arg;
+    Multicore *mc = core->mc;
+    APEX_CPU *cpu = core->cpu;
+
+    while (TRUE)
+    {
+        /* Stores of every core in the last quantum become visible */
+        for (int i = 0; i < mc->num_merged; ++i)
+        {
+            if (mc->merged[i].kind == EVENT_STORE)
+            {
+                APEX_mem_write(&cpu->data_memory, mc->merged[i].addr, mc->merged[i].value);
+            }
+        }
+        if (mc->done)
+        {
+            break;
+        }
+
+        while (!core->halted && !core->waiting && cpu->clock < mc->until)
+        {
+            core->halted = APEX_cpu_cycle(cpu);
+        }
+
+        pthread_barrier_wait(&mc->barrier);
+        if (core->id == 0)
+        {
+            multicore_weave(mc);
+        }
+        pthread_barrier_wait(&mc->barrier);
+    }
+    return NULL;
+}
+
+static int
+line_compare(const void *a, const void *b)
+{
+    const DirEntry *x = a;
+    const DirEntry *y = b;
+
+    if (x->invalidations != y->invalidations)
+    {
+        return x->invalidations > y->invalidations ? -1 : 1;
+    }
+    if (x->coherence_misses != y->coherence_misses)
+    {
+        return x->coherence_misses > y->coherence_misses ? -1 : 1;
+    }
+    return x->line - y->line;
+}
+
+/* Prints the protocol counters and the lines invalidated most */
+static void
+coherence_print(const Multicore *mc)
+{
+    static const char *names[] = { "MESI", "MOESI" };
+    const APEX_Config *config = &mc->shared->config;
+    DirEntry *lines = malloc(mc->dir_used * sizeof(DirEntry) + 1);
+    int num_lines = 0;
+
+    printf("coherence %s, %d cycles per hop: %lld upgrades, %lld invalidations, "
+           "%lld L1D to L1D transfers\n", names[config->coherence],
+           config->interconnect_latency, mc->upgrades, mc->invalidations, mc->transfers);
+    printf("coherence misses %lld, false sharing %lld (%.2f%%)\n", mc->coherence_misses,
+           mc->false_sharing,
+           mc->coherence_misses ? 100.0 * mc->false_sharing / mc->coherence_misses : 0.0);
+    if (!lines)
+    {
+        return;
+    }
+    for (unsigned i = 0; i <= mc->dir_mask; ++i)
+    {
+        if (mc->dir[i].line >= 0 && (mc->dir[i].invalidations || mc->dir[i].coherence_misses))
+        {
+            lines[num_lines++] = mc->dir[i];
+        }
+    }
+    if (num_lines)
+    {
+        qsort(lines, num_lines, sizeof(DirEntry), line_compare);
+        printf("%-10s %14s %17s %14s\n", "line addr", "invalidations", "coherence_misses",
+               "false_sharing");
+        for (int i = 0; i < num_lines && i < COHERENCE_TOP; ++i)
+        {
+            printf("%-10d %14lld %17lld %14lld\n",
+                   lines[i].line << mc->shared->caches.line_shift, lines[i].invalidations,
+                   lines[i].coherence_misses, lines[i].false_sharing);
+        }
+    }
+    free(lines);
+}
+
+static void
+multicore_print(const Multicore *mc)
+{
+    const APEX_CPU *first = mc->core[0].cpu;
+    long long faults = 0;
+    int cycles = 0;
+
+    long long atomics = 0;
+    long long sc_failed = 0;
+    long long fences = 0;
+    long long contention = 0;
+
+    printf("%-6s %12s %12s %8s %12s %12s %12s %10s %12s\n", "core", "cycles", "insns", "CPI",
+           "stalls", "mem_stalls", "l1d_misses", "atomics", "contention");
+    for (int i = 0; i < mc->num_cores; ++i)
+    {
+        const APEX_Core *core = &mc->core[i];
+        const APEX_CPU *cpu = core->cpu;
+
+        printf("%-6d %12d %12d %8.3f %12d %12d %12lld %10lld %12lld\n", i, cpu->clock,
+               cpu->insn_completed,
+               cpu->insn_completed ? (double)cpu->clock / cpu->insn_completed : 0.0,
+               cpu->stall_cycles, cpu->mem_stall_cycles,
+               cpu->caches.level[CACHE_L1D].misses, core->atomics, core->contention);
+        atomics += core->atomics;
+        sc_failed += core->sc_failed;
+        fences += core->fences;
+        contention += core->contention;
+        if (cpu->clock > cycles)
+        {
+            cycles = cpu->clock;
+        }
+        faults += cpu->data_memory.faults;
+    }
+    /* Atomics and fences end a quantum early, so barriers times the quantum
+     * is no measure of the cycles */
+    printf("%d cores, %d cycles, %d barriers, quantum %d\n", mc->num_cores, cycles,
+           mc->barriers, mc->shared->config.quantum);
+    if (atomics || fences)
+    {
+        printf("atomics %lld (%lld SC failed), fences %lld, %lld cycles of contention\n",
+               atomics, sc_failed, fences, contention);
+    }
+    if (mc->shared->config.cache_size[CACHE_L2] || first->config.cache_size[CACHE_L1D])
+    {
+        printf("shared levels:\n");
+        APEX_cache_print_stats(mc->shared);
+        coherence_print(mc);
+    }
+
+    printf("\n=============== STATE OF DATA MEMORY (non-zero) =============\n");
+    for (int i = 0; i < DATA_MEMORY_SIZE; ++i)
+    {
+        int value = APEX_mem_peek(&first->data_memory, i);
+
+        if (value)
+        {
+            printf("| MEM[%-4d] | Data Value=%-4d |\n", i, value);
+        }
+    }
+    if (faults)
+    {
+        fprintf(stderr, "APEX_Error: %lld data memory accesses outside [0, %lld) were ignored\n",
+                faults, MEM_WORDS);
+    }
+}
+
+/*
+ * Runs config.cores copies of the program until all of them retired HALT,
+ * or the given number of cycles elapsed, then reports every core and the
+ * shared levels.
+ */
+void
+APEX_multicore_run(const APEX_CPU *cpu, const char *cycles)
+{
+    Multicore *mc = calloc(1, sizeof(Multicore));
+    APEX_CPU *cores = calloc(cpu->config.cores, sizeof(APEX_CPU));
+    APEX_CPU *shared = calloc(1, sizeof(APEX_CPU));
+    pthread_t threads[MULTICORE_MAX_CORES];
+
+    if (!mc || !cores || !shared)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate multicore state\n");
+        free(mc);
+        free(cores);
+        free(shared);
+        return;
+    }
+
+    /* The shared APEX_CPU only models the levels below the L1Ds */
+    shared->config = cpu->config;
+    shared->config.cache_size[CACHE_L1D] = 0;
+    shared->config.prefetch = PREFETCH_NONE;
+    APEX_cache_init(shared);
+
+    mc->num_cores = cpu->config.cores;
+    mc->max_cycles = cycles ? atoi(cycles) : 0;
+    mc->until = cpu->config.quantum;
+    if (mc->max_cycles > 0 && mc->until > mc->max_cycles)
+    {
+        mc->until = mc->max_cycles;
+    }
+    mc->shared = shared;
+    mc->memory = cpu->data_memory;
+    APEX_mem_clone(&mc->memory);
+    mc->dir = dir_alloc(DIR_INITIAL_SIZE);
+    mc->dir_mask = DIR_INITIAL_SIZE - 1;
+    pthread_barrier_init(&mc->barrier, NULL, mc->num_cores);
+
+    for (int i = 0; i < mc->num_cores; ++i)
+    {
+        APEX_Core *core = &mc->core[i];
+
+        APEX_cpu_copy(&cores[i], cpu);
+        cores[i].config.cache_size[CACHE_L2] = 0;
+        cores[i].config.memory = MEMORY_FLAT;
+        cores[i].regs[MULTICORE_ID_REG] = i;
+        cores[i].regs[MULTICORE_COUNT_REG] = mc->num_cores;
+        cores[i].core = core;
+        core->id = i;
+        core->link = -1;
+        core->cpu = &cores[i];
+        core->mc = mc;
+    }
+    for (int i = 0; i < mc->num_cores; ++i)
+    {
+        pthread_create(&threads[i], NULL, core_thread, &mc->core[i]);
+    }
+    for (int i = 0; i < mc->num_cores; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    if (shared->config.memory == MEMORY_DRAM)
+    {
+        APEX_dram_advance(shared, CACHE_PENDING);
+    }
+    multicore_print(mc);
+
+    pthread_barrier_destroy(&mc->barrier);
+    for (int i = 0; i < mc->num_cores; ++i)
+    {
+        APEX_cpu_release(&cores[i]);
+        free(mc->core[i].events);
+    }
+    free(mc->merged);
+    free(mc->dir);
+    APEX_mem_release(&mc->memory);
+    APEX_cpu_release(shared);
+    free(mc);
+    free(cores);
+    free(shared);
+}
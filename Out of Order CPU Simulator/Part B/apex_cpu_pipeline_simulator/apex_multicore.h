@@ -0,0 +1,20 @@
+/*
+ * apex_multicore.h
+ * Contains declarations of multicore runs: cores with private pipelines and
+ * L1Ds, each on its own host thread, sharing the L2 and memory
+ */
+#ifndef _APEX_MULTICORE_H_
+#define _APEX_MULTICORE_H_
+
+#include "apex_cpu.h"
+
+int APEX_multicore_miss(APEX_CPU *cpu, int addr, int line, int arrival, int is_store,
+                        int prefetch);
+int APEX_multicore_upgrade(APEX_CPU *cpu, int addr, int line, int now);
+int APEX_multicore_shared(APEX_CPU *cpu, int line);
+void APEX_multicore_write(APEX_CPU *cpu, int line);
+void APEX_multicore_atomic(APEX_CPU *cpu, int opcode, int addr, int value, int done);
+int APEX_multicore_result(const APEX_CPU *cpu);
+void APEX_multicore_store(APEX_CPU *cpu, int addr, int value);
+void APEX_multicore_run(const APEX_CPU *cpu, const char *cycles);
+#endif
@@ -0,0 +1,235 @@
+/*
+ * apex_prefetch.c
+ * Prefetchers attached to one level of the data cache hierarchy, chosen
+ * with the prefetch option:
+ *
+ * next_line  tagged next-line: a miss, or the first use of a prefetched
+ *            line, fetches the prefetch_degree lines that follow it
+ * stride     reference prediction table indexed by the pc of the load or
+ *            store, prefetching along the stride once it repeated
+ * stream     stream buffers: a miss starts a FIFO of the lines after it,
+ *            held outside the cache until a later miss finds them
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "apex_cache.h"
+#include "apex_macros.h"
+#include "apex_prefetch.h"
+
+/* States of a reference prediction table entry */
+#define RPT_INIT 0
+#define RPT_TRANSIENT 1
+#define RPT_STEADY 2
+#define RPT_NO_PRED 3
+
+static void
+next_line_access(APEX_CPU *cpu, int addr, int miss, int first_use, int now)
+{
+    int line = addr >> cpu->caches.line_shift;
+
+    if (!miss && !first_use)
+    {
+        return;
+    }
+    for (int i = 1; i <= cpu->config.prefetch_degree; ++i)
+    {
+        APEX_cache_prefetch(cpu, line + i, now);
+    }
+}
+
+/*
+ * Trains the entry of pc with addr and, in the steady state, prefetches the
+ * prefetch_degree lines ahead along its stride. A stride shorter than a
+ * line walks consecutive lines.
+ */
+static void
+stride_access(APEX_CPU *cpu, int pc, int addr, int now)
+{
+    APEX_RptEntry *entry = &cpu->caches.prefetch.rpt[((pc - 4000) / 4) % PREFETCH_RPT_SIZE];
+    int shift = cpu->caches.line_shift;
+    int stride;
+
+    if (entry->pc != pc)
+    {
+        entry->pc = pc;
+        entry->prev_addr = addr;
+        entry->stride = 0;
+        entry->state = RPT_INIT;
+        return;
+    }
+
+    stride = addr - entry->prev_addr;
+    entry->prev_addr = addr;
+    switch (entry->state)
+    {
+        case RPT_INIT:
+        case RPT_TRANSIENT:
+        {
+            if (stride == entry->stride)
+            {
+                entry->state = RPT_STEADY;
+                break;
+            }
+            entry->stride = stride;
+            entry->state = entry->state == RPT_INIT ? RPT_TRANSIENT : RPT_NO_PRED;
+            break;
+        }
+
+        case RPT_STEADY:
+        {
+            if (stride != entry->stride)
+            {
+                entry->state = RPT_INIT;
+            }
+            break;
+        }
+
+        case RPT_NO_PRED:
+        {
+            if (stride == entry->stride)
+            {
+                entry->state = RPT_TRANSIENT;
+                break;
+            }
+            entry->stride = stride;
+            break;
+        }
+    }
+
+    if (entry->state != RPT_STEADY || entry->stride == 0)
+    {
+        return;
+    }
+    for (int i = 1; i <= cpu->config.prefetch_degree; ++i)
+    {
+        if (abs(entry->stride) >= (1 << shift))
+        {
+            APEX_cache_prefetch(cpu, (addr + i * entry->stride) >> shift, now);
+        }
+        else
+        {
+            APEX_cache_prefetch(cpu, (addr >> shift) + (entry->stride > 0 ? i : -i), now);
+        }
+    }
+}
+
+/* Tops the buffer up to prefetch_degree lines, continuing after its last */
+static void
+stream_fill(APEX_CPU *cpu, APEX_StreamBuffer *buf, int next, int now)
+{
+    APEX_Prefetcher *pf = &cpu->caches.prefetch;
+
+    if (buf->num)
+    {
+        next = buf->line[buf->num - 1] + 1;
+    }
+    while (buf->num < cpu->config.prefetch_degree)
+    {
+        int ready = APEX_cache_fetch_time(cpu, cpu->config.prefetch_level, next, now);
+
+        if (ready < 0)
+        {
+            break;
+        }
+        buf->line[buf->num] = next;
+        buf->ready[buf->num] = ready;
+        buf->num++;
+        next++;
+        pf->issued++;
+    }
+    buf->lru = ++pf->stamp;
+}
+
+/* A miss nothing covered replaces the least recently used stream */
+static void
+stream_access(APEX_CPU *cpu, int addr, int miss, int now)
+{
+    APEX_Prefetcher *pf = &cpu->caches.prefetch;
+    APEX_StreamBuffer *victim = &pf->stream[0];
+
+    if (!miss)
+    {
+        return;
+    }
+    for (int i = 1; i < PREFETCH_STREAMS; ++i)
+    {
+        if (pf->stream[i].lru < victim->lru)
+        {
+            victim = &pf->stream[i];
+        }
+    }
+    victim->num = 0;
+    stream_fill(cpu, victim, (addr >> cpu->caches.line_shift) + 1, now);
+}
+
+/*
+ * Tells the prefetcher about a demand access of addr by the load or store
+ * at pc, in the cycle now, at the level it is attached to. first_use is set
+ * on the first hit of a line the prefetcher brought in.
+ */
+void
+APEX_prefetch_access(APEX_CPU *cpu, int pc, int addr, int miss, int first_use, int now)
+{
+    switch (cpu->config.prefetch)
+    {
+        case PREFETCH_NEXT_LINE:
+        {
+            next_line_access(cpu, addr, miss, first_use, now);
+            break;
+        }
+
+        case PREFETCH_STRIDE:
+        {
+            stride_access(cpu, pc, addr, now);
+            break;
+        }
+
+        case PREFETCH_STREAM:
+        {
+            stream_access(cpu, addr, miss, now);
+            break;
+        }
+    }
+}
+
+/*
+ * Called on a miss: looks for line among the lines the prefetcher holds
+ * outside the cache. A stream buffer hit drops the entries ahead of line,
+ * which the stream skipped, and refills the buffer.
+ *
+ * Returns TRUE and the cycle the line arrives in *ready if it was found.
+ */
+int
+APEX_prefetch_lookup(APEX_CPU *cpu, int line, int now, int *ready)
+{
+    APEX_Prefetcher *pf = &cpu->caches.prefetch;
+
+    if (cpu->config.prefetch != PREFETCH_STREAM)
+    {
+        return FALSE;
+    }
+    for (int i = 0; i < PREFETCH_STREAMS; ++i)
+    {
+        APEX_StreamBuffer *buf = &pf->stream[i];
+
+        for (int j = 0; j < buf->num; ++j)
+        {
+            if (buf->line[j] != line)
+            {
+                continue;
+            }
+            *ready = buf->ready[j];
+            pf->useful++;
+            for (int k = j + 1; k < buf->num; ++k)
+            {
+                buf->line[k - j - 1] = buf->line[k];
+                buf->ready[k - j - 1] = buf->ready[k];
+            }
+            buf->num -= j + 1;
+            stream_fill(cpu, buf, line + 1, now);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
@@ -0,0 +1,13 @@
+/*
+ * apex_prefetch.h
+ * Contains declarations of the prefetchers that can be attached to one
+ * level of the data cache hierarchy
+ */
+#ifndef _APEX_PREFETCH_H_
+#define _APEX_PREFETCH_H_
+
+#include "apex_cpu.h"
+
+void APEX_prefetch_access(APEX_CPU *cpu, int pc, int addr, int miss, int first_use, int now);
+int APEX_prefetch_lookup(APEX_CPU *cpu, int line, int now, int *ready);
+#endif
@@ -0,0 +1,422 @@
+/*
+ * apex_profile.c
+ * Reuse-distance, working-set and stride profiler of the two address
+ * streams of the pipeline
+ *
+ * The data stream holds the address APEX_execute computes for every LOAD,
+ * LDI, STORE and STI, the instruction stream the pc of every fetch, wrong
+ * path fetches included and refetches while decode stalls excluded. Both are attributed to the static pc issuing the
+ * access and measured in cache_line lines:
+ *
+ *  - the reuse distance of an access is the number of distinct lines
+ *    touched since the previous access to its line, so it hits in a fully
+ *    associative LRU cache of more lines than that
+ *  - the working set of a window of profile_window cycles is the number of
+ *    distinct lines touched in it
+ *  - the stride of an access is the address delta since the previous access
+ *    of the same static pc; the most frequent strides of every pc are kept
+ *    with the space-saving algorithm
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+#include "apex_mrc.h"
+#include "apex_profile.h"
+
+/* Reuse distance buckets: 0, then powers of four up to PROFILE_BUCKETS - 2,
+ * the last bucket counting first accesses */
+#define PROFILE_BUCKETS 10
+#define PROFILE_COLD (PROFILE_BUCKETS - 1)
+
+/* Strides tracked per static pc */
+#define PROFILE_STRIDES 4
+
+/* Rows of the per-pc tables and of the working-set series */
+#define PROFILE_TOP 20
+#define PROFILE_MAX_WINDOWS 32
+
+/* Share of accesses with the most frequent stride to call it regular */
+#define PROFILE_REGULAR 0.9
+
+static const char *bucket_names[PROFILE_BUCKETS] = {
+    "0", "1-3", "4-15", "16-63", "64-255", "256-1K", "1K-4K", "4K-16K", ">=16K", "cold"
+};
+
+/* Accesses issued by one static pc */
+typedef struct ProfilePc
+{
+    long long accesses;
+    long long hist[PROFILE_BUCKETS];
+    int last_addr;
+    int strides[PROFILE_STRIDES];
+    long long stride_count[PROFILE_STRIDES];
+} ProfilePc;
+
+/* One address stream */
+typedef struct ProfileStream
+{
+    const char *name;
+    int strides;                   /* Report stride patterns */
+    APEX_StackDist *stack;
+    long long hist[PROFILE_BUCKETS];
+    ProfilePc *pcs;                /* Indexed by code memory slot */
+    long long window_start;        /* Stack time at the start of the window */
+    int *ws;                       /* Working set of every completed window */
+    int num_windows;
+    int max_windows;
+} ProfileStream;
+
+static int
+profile_bucket(int distance)
+{
+    int bucket = 1;
+
+    if (distance < 0)
+    {
+        return PROFILE_COLD;
+    }
+    if (distance == 0)
+    {
+        return 0;
+    }
+    while (distance >= 4 && bucket < PROFILE_COLD - 1)
+    {
+        distance >>= 2;
+        bucket++;
+    }
+    return bucket;
+}
+
+/* Space-saving update: a new stride replaces the least frequent one */
+static void
+profile_stride(ProfilePc *pc, int stride)
+{
+    int min = 0;
+
+    for (int i = 0; i < PROFILE_STRIDES; ++i)
+    {
+        if (pc->stride_count[i] && pc->strides[i] == stride)
+        {
+            pc->stride_count[i]++;
+            return;
+        }
+        if (pc->stride_count[i] < pc->stride_count[min])
+        {
+            min = i;
+        }
+    }
+    pc->strides[min] = stride;
+    pc->stride_count[min]++;
+}
+
+static int
+profile_access(ProfileStream *stream, int pc_index, int addr)
+{
+    ProfilePc *pc = &stream->pcs[pc_index];
+    int distance;
+    int bucket;
+
+    if (!APEX_stackdist_access(stream->stack, addr, &distance))
+    {
+        return FALSE;
+    }
+    bucket = profile_bucket(distance);
+    stream->hist[bucket]++;
+    pc->hist[bucket]++;
+
+    if (pc->accesses > 0)
+    {
+        profile_stride(pc, addr - pc->last_addr);
+    }
+    pc->last_addr = addr;
+    pc->accesses++;
+    return TRUE;
+}
+
+static int
+profile_end_window(ProfileStream *stream)
+{
+    if (stream->num_windows == stream->max_windows)
+    {
+        int max_windows = stream->max_windows ? 2 * stream->max_windows : 256;
+        int *ws = realloc(stream->ws, max_windows * sizeof(int));
+
+        if (!ws)
+        {
+            return FALSE;
+        }
+        stream->ws = ws;
+        stream->max_windows = max_windows;
+    }
+    stream->ws[stream->num_windows++]
+        = APEX_stackdist_lines_since(stream->stack, stream->window_start);
+    stream->window_start = APEX_stackdist_time(stream->stack);
+    return TRUE;
+}
+
+/* Index of the most frequent stride of a pc */
+static int
+profile_top_stride(const ProfilePc *pc)
+{
+    int top = 0;
+
+    for (int i = 1; i < PROFILE_STRIDES; ++i)
+    {
+        if (pc->stride_count[i] > pc->stride_count[top])
+        {
+            top = i;
+        }
+    }
+    return top;
+}
+
+/* Smallest bucket holding at least half of the reuses of a histogram */
+static int
+profile_median(const long long *hist)
+{
+    long long reuses = 0, seen = 0;
+
+    for (int b = 0; b < PROFILE_COLD; ++b)
+    {
+        reuses += hist[b];
+    }
+    for (int b = 0; b < PROFILE_COLD; ++b)
+    {
+        seen += hist[b];
+        if (reuses && 2 * seen >= reuses)
+        {
+            return b;
+        }
+    }
+    return PROFILE_COLD;
+}
+
+static void
+profile_print_hist(const ProfileStream *stream)
+{
+    long long total = 0, seen = 0;
+
+    for (int b = 0; b < PROFILE_BUCKETS; ++b)
+    {
+        total += stream->hist[b];
+    }
+
+    printf("\n--%s REUSE DISTANCE (lines)--\n", stream->name);
+    printf("%-10s %14s %8s %8s\n", "distance", "accesses", "share", "cumul");
+    for (int b = 0; b < PROFILE_BUCKETS; ++b)
+    {
+        seen += stream->hist[b];
+        printf("%-10s %14lld %7.2f%% %7.2f%%\n", bucket_names[b], stream->hist[b],
+               total ? 100.0 * stream->hist[b] / total : 0.0,
+               total ? 100.0 * seen / total : 0.0);
+    }
+}
+
+static void
+profile_print_ws(const ProfileStream *stream, int window)
+{
+    int step = (stream->num_windows + PROFILE_MAX_WINDOWS - 1) / PROFILE_MAX_WINDOWS;
+    long long sum = 0;
+    int max = 0;
+
+    if (stream->num_windows == 0)
+    {
+        return;
+    }
+    for (int i = 0; i < stream->num_windows; ++i)
+    {
+        sum += stream->ws[i];
+        if (stream->ws[i] > max)
+        {
+            max = stream->ws[i];
+        }
+    }
+
+    printf("\n--%s WORKING SET (lines per %d cycles, mean %.1f, max %d)--\n",
+           stream->name, window, (double)sum / stream->num_windows, max);
+    printf("%-14s %8s\n", "cycles", "lines");
+    for (int i = 0; i < stream->num_windows; i += step)
+    {
+        char range[32];
+
+        snprintf(range, sizeof(range), "%lld-", (long long)i * window);
+        printf("%-14s %8d\n", range, stream->ws[i]);
+    }
+}
+
+static int
+profile_pc_cmp(const void *a, const void *b)
+{
+    const ProfilePc *x = *(const ProfilePc **)a, *y = *(const ProfilePc **)b;
+
+    if (x->accesses != y->accesses)
+    {
+        return x->accesses < y->accesses ? 1 : -1;
+    }
+    return x < y ? -1 : 1;
+}
+
+static void
+profile_print_pcs(const ProfileStream *stream, const APEX_CPU *cpu,
+                  const ProfilePc **order)
+{
+    int n = 0;
+
+    for (int i = 0; i < cpu->code_memory_size; ++i)
+    {
+        if (stream->pcs[i].accesses)
+        {
+            order[n++] = &stream->pcs[i];
+        }
+    }
+    qsort(order, n, sizeof(ProfilePc *), profile_pc_cmp);
+
+    printf("\n--%s PER PC--\n", stream->name);
+    printf("%-6s %-6s %12s %7s %9s %8s", "pc", "insn", "accesses", "cold",
+           "median", "<64");
+    if (stream->strides)
+    {
+        printf(" %8s %7s %-10s", "stride", "share", "pattern");
+    }
+    printf("\n");
+    for (int i = 0; i < n && i < PROFILE_TOP; ++i)
+    {
+        const ProfilePc *pc = order[i];
+        int index = (int)(pc - stream->pcs);
+        int top = profile_top_stride(pc);
+        long long near = 0;
+        double share = pc->accesses > 1
+                           ? (double)pc->stride_count[top] / (pc->accesses - 1) : 0.0;
+        const char *pattern = "-";
+        char stride[16];
+
+        for (int b = 0; b < 4; ++b)
+        {
+            near += pc->hist[b];
+        }
+        if (pc->accesses > 1)
+        {
+            pattern = share < PROFILE_REGULAR ? "irregular"
+                      : pc->strides[top] == 0 ? "same" : "strided";
+            snprintf(stride, sizeof(stride), "%d", pc->strides[top]);
+        }
+        else
+        {
+            snprintf(stride, sizeof(stride), "-");
+        }
+
+        printf("%-6d %-6s %12lld %6.1f%% %9s %7.1f%%",
+               4000 + 4 * index, cpu->code_memory[index].opcode_str,
+               pc->accesses, 100.0 * pc->hist[PROFILE_COLD] / pc->accesses,
+               bucket_names[profile_median(pc->hist)], 100.0 * near / pc->accesses);
+        if (stream->strides)
+        {
+            printf(" %8s %6.1f%% %-10s", stride, 100.0 * share, pattern);
+        }
+        printf("\n");
+    }
+}
+
+/*
+ * Simulates the pipeline until HALT retires, or for the given number of
+ * cycles, and prints for the data and instruction streams their reuse
+ * distance histogram, working set over time and the busiest static pcs
+ * with their reuse, the share of reuses under 64 lines and stride pattern.
+ */
+void
+APEX_profile_run(APEX_CPU *cpu, const char *cycles)
+{
+    ProfileStream streams[2];
+    ProfileStream *data = &streams[0], *insn = &streams[1];
+    const ProfilePc **order = malloc(cpu->code_memory_size * sizeof(ProfilePc *));
+    int window = cpu->config.profile_window;
+    int max_cycles = cycles ? atoi(cycles) : 0;
+    int ok = order != NULL;
+
+    memset(streams, 0, sizeof(streams));
+    data->name = "DATA";
+    data->strides = TRUE;
+    insn->name = "INSTRUCTION";
+    for (int i = 0; i < 2; ++i)
+    {
+        streams[i].stack = APEX_stackdist_create(cpu->config.cache_line, 1);
+        streams[i].pcs = calloc(cpu->code_memory_size, sizeof(ProfilePc));
+        ok = ok && streams[i].stack && streams[i].pcs;
+    }
+
+    while (ok)
+    {
+        int stop = APEX_cpu_cycle(cpu);
+
+        /* A stalled fetch presents the same instruction again */
+        if (cpu->fp == 1 && cpu->stall_count == 0)
+        {
+            ok = profile_access(insn, (cpu->pfetch.pc - 4000) / 4, cpu->pfetch.pc);
+        }
+
+        if (ok && cpu->ep == 1)
+        {
+            switch (cpu->pexecute.opcode)
+            {
+                case OPCODE_LOAD:
+                case OPCODE_LDI:
+                case OPCODE_STORE:
+                case OPCODE_STI:
+                case OPCODE_LL:
+                case OPCODE_SC:
+                case OPCODE_FAA:
+                {
+                    ok = profile_access(data, (cpu->pexecute.pc - 4000) / 4,
+                                        cpu->pexecute.memory_address);
+                    break;
+                }
+            }
+        }
+
+        if (ok && cpu->clock % window == 0)
+        {
+            ok = profile_end_window(data) && profile_end_window(insn);
+        }
+
+        if (stop || (max_cycles > 0 && cpu->clock == max_cycles))
+        {
+            break;
+        }
+    }
+
+    /* The last window may be partial */
+    if (ok && cpu->clock % window != 0)
+    {
+        ok = profile_end_window(data) && profile_end_window(insn);
+    }
+
+    if (!ok)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate profiler state\n");
+    }
+    else
+    {
+        printf("APEX_PROFILE: %d cycles, %d instructions, %d-byte lines\n",
+               cpu->clock, cpu->insn_completed, cpu->config.cache_line);
+        for (int i = 0; i < 2; ++i)
+        {
+            profile_print_hist(&streams[i]);
+            profile_print_ws(&streams[i], window);
+            profile_print_pcs(&streams[i], cpu, order);
+        }
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        if (streams[i].stack)
+        {
+            APEX_stackdist_free(streams[i].stack);
+        }
+        free(streams[i].pcs);
+        free(streams[i].ws);
+    }
+    free(order);
+}
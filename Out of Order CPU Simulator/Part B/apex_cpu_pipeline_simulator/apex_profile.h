@@ -0,0 +1,12 @@
+/*
+ * apex_profile.h
+ * Contains declarations of the reuse-distance, working-set and stride
+ * profiler of the data and instruction address streams
+ */
+#ifndef _APEX_PROFILE_H_
+#define _APEX_PROFILE_H_
+
+#include "apex_cpu.h"
+
+void APEX_profile_run(APEX_CPU *cpu, const char *cycles);
+#endif
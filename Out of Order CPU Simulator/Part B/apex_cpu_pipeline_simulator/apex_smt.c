@@ -0,0 +1,217 @@
+/*
+ * apex_smt.c
+ * SMT runs: config.smt_threads threads share the pipeline latches, each
+ * with its own pc, registers, flags and code image. Fetch takes one thread
+ * a cycle, so the load-use stalls and branch bubbles of one thread are
+ * filled with the instructions of the others; the run measures how much
+ * of them is won back against the same threads run one after another.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+#include "apex_mem.h"
+#include "apex_smt.h"
+
+static const char *fetch_names[] = { "icount", "round_robin" };
+
+/* Totals of a run, SMT or a thread alone */
+typedef struct SmtRun
+{
+    int cycles;
+    int insns;
+    int stalls;
+    int mem_stalls;
+} SmtRun;
+
+/* Runs cpu until HALT retires, or until max_cycles if positive */
+static void
+run_until_halt(APEX_CPU *cpu, int max_cycles, SmtRun *run)
+{
+    while (!APEX_cpu_cycle(cpu) && cpu->clock != max_cycles)
+    {
+    }
+    run->cycles = cpu->clock;
+    run->insns = cpu->insn_completed;
+    run->stalls = cpu->stall_cycles;
+    run->mem_stalls = cpu->mem_stall_cycles;
+}
+
+/*
+ * Runs thread alone on a copy of cpu, the pipeline as it is before the SMT
+ * run and the thread numbered the same, so that it does the same share of
+ * the work
+ */
+static void
+run_alone(const APEX_CPU *cpu, int thread, int max_cycles, SmtRun *run)
+{
+    APEX_CPU *alone = calloc(1, sizeof(APEX_CPU));
+
+    if (!alone)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate SMT state\n");
+        exit(1);
+    }
+    APEX_cpu_copy(alone, cpu);
+    alone->config.smt_threads = 1;
+    alone->code_memory = cpu->threads[thread].code_memory;
+    alone->code_memory_size = cpu->threads[thread].code_memory_size;
+    memcpy(alone->regs, cpu->threads[thread].regs, sizeof(alone->regs));
+    run_until_halt(alone, max_cycles, run);
+    APEX_cpu_release(alone);
+    free(alone);
+}
+
+static void
+print_run(const char *name, const SmtRun *run)
+{
+    printf("%-8s %12d %12d %8.3f %12d %12d\n", name, run->cycles, run->insns,
+           run->cycles ? (double)run->insns / run->cycles : 0.0, run->stalls,
+           run->mem_stalls);
+}
+
+static void
+smt_print(const APEX_CPU *cpu, const char *const names[], const SmtRun *smt,
+          const SmtRun alone[])
+{
+    int n = cpu->config.smt_threads;
+    SmtRun serial = { 0, 0, 0, 0 };
+
+    printf("%-6s %-24s %12s %12s %12s %12s\n", "thread", "program", "insns", "halt_cycle",
+           "alone_cycles", "alone_CPI");
+    for (int t = 0; t < n; ++t)
+    {
+        printf("%-6d %-24s %12d %12d %12d %12.3f\n", t, names[t],
+               cpu->threads[t].insn_completed, cpu->threads[t].halt_cycle, alone[t].cycles,
+               alone[t].insns ? (double)alone[t].cycles / alone[t].insns : 0.0);
+        serial.cycles += alone[t].cycles;
+        serial.insns += alone[t].insns;
+        serial.stalls += alone[t].stalls;
+        serial.mem_stalls += alone[t].mem_stalls;
+    }
+
+    printf("\n%-8s %12s %12s %8s %12s %12s\n", "run", "cycles", "insns", "IPC", "stalls",
+           "mem_stalls");
+    print_run("smt", smt);
+    print_run("serial", &serial);
+
+    /*
+     * IPC against IPC rather than cycles against cycles: under a cycle limit
+     * the runs stop at the same cycle with different amounts of work done
+     */
+    double smt_ipc = smt->cycles ? (double)smt->insns / smt->cycles : 0.0;
+    double serial_ipc = serial.cycles ? (double)serial.insns / serial.cycles : 0.0;
+
+    printf("%d threads, fetch %s: throughput %.3fx of running them one after another\n", n,
+           fetch_names[cpu->config.smt_fetch], serial_ipc ? smt_ipc / serial_ipc : 0.0);
+
+    for (int t = 0; t < n; ++t)
+    {
+        const int *regs = t == cpu->thread ? cpu->regs : cpu->threads[t].regs;
+
+        printf("\n--STATE OF ARCHITECTURAL REGISTER FILE OF THREAD %d--\n", t);
+        for (int i = 0; i < REG_FILE_SIZE; ++i)
+        {
+            printf("| REG[%-2d] | Value=%-4d |\n", i, regs[i]);
+        }
+    }
+
+    printf("\n=============== STATE OF DATA MEMORY (non-zero) =============\n");
+    for (int i = 0; i < DATA_MEMORY_SIZE; ++i)
+    {
+        int value = APEX_mem_peek(&cpu->data_memory, i);
+
+        if (value)
+        {
+            printf("| MEM[%-4d] | Data Value=%-4d |\n", i, value);
+        }
+    }
+    if (cpu->data_memory.faults)
+    {
+        fprintf(stderr, "APEX_Error: %lld data memory accesses outside [0, %lld) were ignored\n",
+                cpu->data_memory.faults, MEM_WORDS);
+    }
+}
+
+/*
+ * Runs config.smt_threads threads on the pipeline of cpu until all of them
+ * retired HALT, or the given number of cycles elapsed. Thread n > 0 runs
+ * images[n - 1] when given, the input program otherwise, and starts with n
+ * in MULTICORE_ID_REG and the number of threads in MULTICORE_COUNT_REG.
+ * Each thread is also run alone to report the throughput gained.
+ */
+void
+APEX_smt_run(APEX_CPU *cpu, const char *program, const char *const images[],
+             int num_images, const char *cycles)
+{
+    int n = cpu->config.smt_threads;
+    int max_cycles = cycles ? atoi(cycles) : 0;
+    APEX_Instruction *code[SMT_MAX_THREADS] = { NULL };
+    const char *names[SMT_MAX_THREADS];
+    SmtRun alone[SMT_MAX_THREADS];
+    SmtRun smt;
+
+    if (n < 2)
+    {
+        fprintf(stderr, "APEX_Error: the smt command needs smt_threads of 2 or more\n");
+        return;
+    }
+    if (num_images > n - 1)
+    {
+        fprintf(stderr, "APEX_Error: %d smt_image options for %d threads\n", num_images, n);
+        return;
+    }
+
+    for (int t = 0; t < n; ++t)
+    {
+        APEX_Thread *thread = &cpu->threads[t];
+
+        memset(thread, 0, sizeof(APEX_Thread));
+        names[t] = program;
+        thread->code_memory = cpu->code_memory;
+        thread->code_memory_size = cpu->code_memory_size;
+        if (t > 0 && t <= num_images)
+        {
+            names[t] = images[t - 1];
+            code[t] = create_code_memory(images[t - 1], &thread->code_memory_size);
+            if (!code[t])
+            {
+                fprintf(stderr, "APEX_Error: Unable to load '%s' for thread %d\n",
+                        images[t - 1], t);
+                for (int i = 1; i < t; ++i)
+                {
+                    free(code[i]);
+                }
+                return;
+            }
+            thread->code_memory = code[t];
+        }
+        thread->pc = cpu->pc;
+        memcpy(thread->regs, cpu->regs, sizeof(thread->regs));
+        thread->regs[MULTICORE_ID_REG] = t;
+        thread->regs[MULTICORE_COUNT_REG] = n;
+        thread->fetching = TRUE;
+        thread->link_addr = -1;
+    }
+    for (int t = 0; t < n; ++t)
+    {
+        run_alone(cpu, t, max_cycles, &alone[t]);
+    }
+
+    /* Thread 0 starts out in the pipeline */
+    memcpy(cpu->regs, cpu->threads[0].regs, sizeof(cpu->regs));
+    cpu->thread = 0;
+    cpu->fetch_thread = n - 1;
+    run_until_halt(cpu, max_cycles, &smt);
+    smt_print(cpu, names, &smt, alone);
+
+    /* The pipeline may hold another thread's code, leave it the program's */
+    cpu->code_memory = cpu->threads[0].code_memory;
+    cpu->code_memory_size = cpu->threads[0].code_memory_size;
+    for (int t = 1; t < n; ++t)
+    {
+        free(code[t]);
+    }
+}
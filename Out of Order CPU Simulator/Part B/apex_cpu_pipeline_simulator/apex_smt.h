@@ -0,0 +1,13 @@
+/*
+ * apex_smt.h
+ * Contains declarations of SMT runs: several threads, each with its own
+ * architectural state and code, sharing one pipeline
+ */
+#ifndef _APEX_SMT_H_
+#define _APEX_SMT_H_
+
+#include "apex_cpu.h"
+
+void APEX_smt_run(APEX_CPU *cpu, const char *program, const char *const images[],
+                  int num_images, const char *cycles);
+#endif
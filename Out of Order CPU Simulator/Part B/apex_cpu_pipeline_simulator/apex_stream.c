@@ -0,0 +1,136 @@
+/*
+ * apex_stream.c
+ * Lock-free ring buffer broadcasting a dynamic instruction stream from one
+ * producer to a fixed set of readers
+ *
+ * Every reader sees every record in order. The producer only overwrites a
+ * slot once all readers are past it. Each side caches the other's position
+ * and only reloads it when the ring looks full or empty, so in steady state
+ * a push or pop touches no shared cache line but its own.
+ */
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_macros.h"
+#include "apex_stream.h"
+
+int
+APEX_stream_init(APEX_Stream *stream, int size_log2, int num_readers)
+{
+    memset(stream, 0, sizeof(APEX_Stream));
+
+    if (num_readers < 1 || num_readers > APEX_STREAM_MAX_READERS)
+    {
+        return FALSE;
+    }
+    stream->ring = malloc(sizeof(APEX_Retire) << size_log2);
+    if (!stream->ring)
+    {
+        return FALSE;
+    }
+    stream->mask = (1L << size_log2) - 1;
+    stream->num_readers = num_readers;
+    return TRUE;
+}
+
+static long
+slowest_reader(APEX_Stream *stream)
+{
+    long min = atomic_load_explicit(&stream->tail[0].pos, memory_order_acquire);
+
+    for (int i = 1; i < stream->num_readers; ++i)
+    {
+        long pos = atomic_load_explicit(&stream->tail[i].pos, memory_order_acquire);
+
+        if (pos < min)
+        {
+            min = pos;
+        }
+    }
+    return min;
+}
+
+/*
+ * Appends one record, waiting while the slowest reader is a full ring
+ * behind.
+ *
+ * Returns FALSE when every reader has detached and nobody is listening.
+ */
+int
+APEX_stream_push(APEX_Stream *stream, const APEX_Retire *rec)
+{
+    long head = atomic_load_explicit(&stream->head.pos, memory_order_relaxed);
+
+    while (head - stream->head.cached > stream->mask)
+    {
+        stream->head.cached = slowest_reader(stream);
+        if (stream->head.cached == LONG_MAX)
+        {
+            return FALSE;
+        }
+        if (head - stream->head.cached > stream->mask)
+        {
+            sched_yield();
+        }
+    }
+
+    stream->ring[head & stream->mask] = *rec;
+    atomic_store_explicit(&stream->head.pos, head + 1, memory_order_release);
+    return TRUE;
+}
+
+/* Marks the end of the stream, readers drain what is left and then stop */
+void
+APEX_stream_close(APEX_Stream *stream)
+{
+    atomic_store_explicit(&stream->closed, TRUE, memory_order_release);
+}
+
+/*
+ * Takes the next record for the given reader.
+ *
+ * Returns FALSE once the stream is closed and fully consumed.
+ */
+int
+APEX_stream_pop(APEX_Stream *stream, int reader, APEX_Retire *rec)
+{
+    APEX_StreamCursor *tail = &stream->tail[reader];
+    long pos = atomic_load_explicit(&tail->pos, memory_order_relaxed);
+
+    while (pos >= tail->cached)
+    {
+        int closed = atomic_load_explicit(&stream->closed, memory_order_acquire);
+
+        tail->cached = atomic_load_explicit(&stream->head.pos, memory_order_acquire);
+        if (pos < tail->cached)
+        {
+            break;
+        }
+        if (closed)
+        {
+            return FALSE;
+        }
+        sched_yield();
+    }
+
+    *rec = stream->ring[pos & stream->mask];
+    atomic_store_explicit(&tail->pos, pos + 1, memory_order_release);
+    return TRUE;
+}
+
+/* Stops a reader for good, the producer no longer waits for it */
+void
+APEX_stream_detach(APEX_Stream *stream, int reader)
+{
+    atomic_store_explicit(&stream->tail[reader].pos, LONG_MAX, memory_order_release);
+}
+
+void
+APEX_stream_free(APEX_Stream *stream)
+{
+    free(stream->ring);
+    stream->ring = NULL;
+}
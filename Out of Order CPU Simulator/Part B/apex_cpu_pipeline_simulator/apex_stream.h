@@ -0,0 +1,39 @@
+/*
+ * apex_stream.h
+ * Contains declarations of the ring buffer that carries a dynamic
+ * instruction stream from one producer thread to one or more readers
+ */
+#ifndef _APEX_STREAM_H_
+#define _APEX_STREAM_H_
+
+#include <stdatomic.h>
+
+#include "apex_cpu.h"
+
+#define APEX_STREAM_MAX_READERS 8
+
+/* Per-thread cursor, padded so readers never share a cache line */
+typedef struct APEX_StreamCursor
+{
+    _Atomic long pos;              /* Records consumed (or produced) */
+    long cached;                   /* Last seen position of the other side */
+    char pad[64 - sizeof(long) * 2];
+} APEX_StreamCursor;
+
+typedef struct APEX_Stream
+{
+    APEX_Retire *ring;
+    long mask;                     /* Ring size - 1, size is a power of two */
+    int num_readers;
+    _Atomic int closed;
+    APEX_StreamCursor head;        /* Producer */
+    APEX_StreamCursor tail[APEX_STREAM_MAX_READERS];
+} APEX_Stream;
+
+int APEX_stream_init(APEX_Stream *stream, int size_log2, int num_readers);
+int APEX_stream_push(APEX_Stream *stream, const APEX_Retire *rec);
+void APEX_stream_close(APEX_Stream *stream);
+int APEX_stream_pop(APEX_Stream *stream, int reader, APEX_Retire *rec);
+void APEX_stream_detach(APEX_Stream *stream, int reader);
+void APEX_stream_free(APEX_Stream *stream);
+#endif
@@ -0,0 +1,585 @@
+/*
+ * apex_sweep.c
+ * Runs one program under several configurations and reports how they
+ * compare
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_checker.h"
+#include "apex_cpu.h"
+#include "apex_func.h"
+#include "apex_macros.h"
+#include "apex_stream.h"
+#include "apex_sweep.h"
+
+/* Rows shown in each table of the differential report */
+#define DIFF_TOP 20
+
+/* One configuration of a differential run, simulated on its own thread */
+typedef struct SweepLane
+{
+    APEX_CPU *cpu;
+    APEX_Stream *stream;
+    int reader;
+    int max_cycles;
+    long long *pc_cycles;          /* Cycles attributed to each code slot */
+    long long *pc_count;           /* Retirements of each code slot */
+    int diverged;
+} SweepLane;
+
+/* One row of the differential report */
+typedef struct SweepDelta
+{
+    int pc;
+    int last_pc;
+    long long count;
+    long long cycles[2];
+} SweepDelta;
+
+/* Runs cpu until HALT retires or max_cycles (0 for no limit) elapse */
+static void
+sweep_run(APEX_CPU *cpu, int max_cycles)
+{
+    while (!APEX_cpu_cycle(cpu))
+    {
+        if (max_cycles > 0 && cpu->clock == max_cycles)
+        {
+            break;
+        }
+    }
+}
+
+/*
+ * Simulates the program once per bypass configuration, each starting from
+ * a copy of the initial state, and reports cycles and the speedup of every
+ * configuration over the stall-only pipeline.
+ */
+void
+APEX_sweep_bypass(const APEX_CPU *cpu, const char *cycles)
+{
+    static const int order[] = { BYPASS_NONE, BYPASS_EX, BYPASS_MEM, BYPASS_FULL };
+    APEX_CPU *run = calloc(1, sizeof(APEX_CPU));
+    int max_cycles = cycles ? atoi(cycles) : 0;
+    int base_cycles = 0;
+
+    if (!run)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate sweep state\n");
+        return;
+    }
+
+    printf("%-8s %12s %12s %8s %12s %12s %8s\n", "bypass", "cycles",
+           "insns", "CPI", "stalls", "saved", "speedup");
+
+    for (int i = 0; i < 4; ++i)
+    {
+        APEX_cpu_copy(run, cpu);
+        run->config.bypass = order[i];
+        sweep_run(run, max_cycles);
+
+        if (order[i] == BYPASS_NONE)
+        {
+            base_cycles = run->clock;
+        }
+
+        printf("%-8s %12d %12d %8.3f %12d %12d %7.3fx\n",
+               APEX_config_bypass_name(order[i]), run->clock,
+               run->insn_completed,
+               run->insn_completed ? (double)run->clock / run->insn_completed : 0.0,
+               run->stall_cycles, base_cycles - run->clock,
+               run->clock ? (double)base_cycles / run->clock : 0.0);
+    }
+
+    APEX_cpu_release(run);
+    free(run);
+}
+
+/*
+ * Simulates the program once per pipeline width, from the scalar pipeline
+ * up to SUPERSCALAR_MAX_WIDTH, and reports the IPC of every width with its
+ * speedup over the scalar pipeline and over the width one narrower.
+ */
+void
+APEX_sweep_width(const APEX_CPU *cpu, const char *cycles)
+{
+    APEX_CPU *run = calloc(1, sizeof(APEX_CPU));
+    int max_cycles = cycles ? atoi(cycles) : 0;
+    int base_cycles = 0;
+    int last_cycles = 0;
+
+    if (!run)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate sweep state\n");
+        return;
+    }
+
+    printf("%-8s %12s %12s %8s %12s %12s %8s %8s\n", "width", "cycles", "insns", "IPC",
+           "stalls", "mem_stalls", "speedup", "gain");
+
+    for (int width = 1; width <= SUPERSCALAR_MAX_WIDTH; ++width)
+    {
+        APEX_cpu_copy(run, cpu);
+        run->config.width = width;
+        sweep_run(run, max_cycles);
+
+        if (width == 1)
+        {
+            base_cycles = run->clock;
+            last_cycles = run->clock;
+        }
+
+        printf("%-8d %12d %12d %8.3f %12d %12d %7.3fx %7.3fx\n", width, run->clock,
+               run->insn_completed,
+               run->clock ? (double)run->insn_completed / run->clock : 0.0,
+               run->stall_cycles, run->mem_stall_cycles,
+               run->clock ? (double)base_cycles / run->clock : 0.0,
+               run->clock ? (double)last_cycles / run->clock : 0.0);
+        last_cycles = run->clock;
+    }
+
+    APEX_cpu_release(run);
+    free(run);
+}
+
+/*
+ * Simulates the program with the flags written in order and renamed, and
+ * reports the decode stalls of branches on their flags and the IPC that
+ * renaming recovers.
+ */
+void
+APEX_sweep_flags(const APEX_CPU *cpu, const char *cycles)
+{
+    static const char *names[] = { "off", "on" };
+    APEX_CPU *run = calloc(1, sizeof(APEX_CPU));
+    int max_cycles = cycles ? atoi(cycles) : 0;
+    double base_ipc = 0.0;
+
+    if (!run)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate sweep state\n");
+        return;
+    }
+
+    printf("%-8s %12s %12s %8s %12s %12s %8s\n", "rename", "cycles", "insns", "IPC",
+           "stalls", "flag_stalls", "speedup");
+
+    for (int rename = 0; rename < 2; ++rename)
+    {
+        double ipc;
+
+        APEX_cpu_copy(run, cpu);
+        run->config.flag_rename = rename;
+        sweep_run(run, max_cycles);
+
+        ipc = run->clock ? (double)run->insn_completed / run->clock : 0.0;
+        if (!rename)
+        {
+            base_ipc = ipc;
+        }
+        printf("%-8s %12d %12d %8.3f %12d %12d %7.3fx\n", names[rename], run->clock,
+               run->insn_completed, ipc, run->stall_cycles, run->flag_stall_cycles,
+               base_ipc ? ipc / base_ipc : 0.0);
+        if (rename)
+        {
+            printf("renaming the flags recovers %.3f IPC (%.2f%%)\n", ipc - base_ipc,
+                   base_ipc ? 100.0 * (ipc - base_ipc) / base_ipc : 0.0);
+        }
+    }
+
+    APEX_cpu_release(run);
+    free(run);
+}
+
+/*
+ * Simulates the program with branches resolved in every stage from decode
+ * to writeback under every bypass configuration, and reports the redirects
+ * and the speedup of each stage over resolving in execute with the same
+ * bypass paths: what resolving earlier saves against what forwarding to
+ * decode does.
+ */
+void
+APEX_sweep_resolve(const APEX_CPU *cpu, const char *cycles)
+{
+    static const int order[] = { BYPASS_NONE, BYPASS_EX, BYPASS_MEM, BYPASS_FULL };
+    APEX_CPU *run = calloc(1, sizeof(APEX_CPU));
+    int max_cycles = cycles ? atoi(cycles) : 0;
+
+    if (!run)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate sweep state\n");
+        return;
+    }
+
+    printf("%-10s %-8s %12s %8s %12s %12s %12s %8s\n", "resolve", "bypass", "cycles", "IPC",
+           "stalls", "redirects", "in_decode", "speedup");
+
+    for (int i = 0; i < 4; ++i)
+    {
+        int base_cycles = 0;
+
+        APEX_cpu_copy(run, cpu);
+        run->config.bypass = order[i];
+        run->config.branch_resolve = RESOLVE_EXECUTE;
+        sweep_run(run, max_cycles);
+        base_cycles = run->clock;
+
+        for (int stage = 0; stage < RESOLVE_STAGES; ++stage)
+        {
+            APEX_cpu_copy(run, cpu);
+            run->config.bypass = order[i];
+            run->config.branch_resolve = stage;
+            sweep_run(run, max_cycles);
+
+            printf("%-10s %-8s %12d %8.3f %12d %12d %12d %7.3fx\n",
+                   APEX_config_resolve_name(stage), APEX_config_bypass_name(order[i]),
+                   run->clock, run->clock ? (double)run->insn_completed / run->clock : 0.0,
+                   run->stall_cycles, run->redirects, run->early_resolved,
+                   run->clock ? (double)base_cycles / run->clock : 0.0);
+        }
+    }
+
+    APEX_cpu_release(run);
+    free(run);
+}
+
+/*
+ * Simulates the program once without prefetching and once per prefetcher
+ * at the configured prefetch_level, and reports the memory stall cycles
+ * each prefetcher hides next to its accuracy, coverage and lateness.
+ */
+void
+APEX_sweep_prefetch(const APEX_CPU *cpu, const char *cycles)
+{
+    APEX_CPU *run = calloc(1, sizeof(APEX_CPU));
+    int max_cycles = cycles ? atoi(cycles) : 0;
+    int base_stalls = 0;
+
+    if (!run)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate sweep state\n");
+        return;
+    }
+    if (!cpu->config.cache_size[cpu->config.prefetch_level])
+    {
+        fprintf(stderr, "APEX_Error: prefetch_sweep needs a cache at prefetch_level\n");
+        free(run);
+        return;
+    }
+
+    printf("%-10s %12s %12s %12s %8s %10s %9s %9s %8s\n", "prefetch", "cycles",
+           "mem_stalls", "hidden", "hidden%", "issued", "accuracy", "coverage",
+           "late");
+
+    for (int kind = PREFETCH_NONE; kind <= PREFETCH_STREAM; ++kind)
+    {
+        const APEX_Prefetcher *pf = &run->caches.prefetch;
+        long long misses;
+
+        APEX_cpu_copy(run, cpu);
+        run->config.prefetch = kind;
+        sweep_run(run, max_cycles);
+
+        if (kind == PREFETCH_NONE)
+        {
+            base_stalls = run->mem_stall_cycles;
+        }
+        misses = run->caches.level[run->config.prefetch_level].misses;
+
+        printf("%-10s %12d %12d %12d %7.2f%% %10lld %8.2f%% %8.2f%% %7.2f%%\n",
+               APEX_config_prefetch_name(kind), run->clock, run->mem_stall_cycles,
+               base_stalls - run->mem_stall_cycles,
+               base_stalls ? 100.0 * (base_stalls - run->mem_stall_cycles) / base_stalls : 0.0,
+               pf->issued,
+               pf->issued ? 100.0 * pf->useful / pf->issued : 0.0,
+               pf->useful + misses ? 100.0 * pf->useful / (pf->useful + misses) : 0.0,
+               pf->useful ? 100.0 * pf->late / pf->useful : 0.0);
+    }
+
+    APEX_cpu_release(run);
+    free(run);
+}
+
+/*
+ * Simulates one lane, taking every retired instruction's expected effects
+ * from the shared functional stream. The cycles since the previous
+ * retirement are charged to the retiring instruction.
+ */
+static void *
+sweep_lane_run(void *arg)
+{
+    SweepLane *lane = arg;
+    APEX_CPU *cpu = lane->cpu;
+    int last_retire = 0;
+    int stop = FALSE;
+
+    while (!stop)
+    {
+        stop = APEX_cpu_cycle(cpu);
+
+        if (cpu->wp == 1)
+        {
+            APEX_Retire expect, got;
+            int index = (cpu->pwriteback.pc - 4000) / 4;
+
+            APEX_checker_from_stage(&cpu->pwriteback, &got);
+            if (!APEX_stream_pop(lane->stream, lane->reader, &expect)
+                || !APEX_checker_compare(&expect, &got))
+            {
+                lane->diverged = cpu->clock;
+                break;
+            }
+            lane->pc_cycles[index] += cpu->clock - last_retire;
+            lane->pc_count[index]++;
+            last_retire = cpu->clock;
+        }
+
+        if (lane->max_cycles > 0 && cpu->clock == lane->max_cycles)
+        {
+            break;
+        }
+    }
+
+    APEX_stream_detach(lane->stream, lane->reader);
+    return NULL;
+}
+
+static int
+sweep_delta_cmp(const void *a, const void *b)
+{
+    const SweepDelta *x = a, *y = b;
+    long long dx = llabs(x->cycles[1] - x->cycles[0]);
+    long long dy = llabs(y->cycles[1] - y->cycles[0]);
+
+    if (dx != dy)
+    {
+        return dx < dy ? 1 : -1;
+    }
+    return x->pc - y->pc;
+}
+
+static void
+sweep_print_deltas(const char *title, SweepDelta *rows, int num_rows)
+{
+    qsort(rows, num_rows, sizeof(SweepDelta), sweep_delta_cmp);
+
+    printf("\n--%s--\n", title);
+    printf("%-11s %12s %14s %14s %14s %8s\n", "pc", "executions",
+           "cycles A", "cycles B", "B - A", "speedup");
+
+    for (int i = 0; i < num_rows && i < DIFF_TOP; ++i)
+    {
+        char range[32];
+
+        if (rows[i].cycles[0] == rows[i].cycles[1])
+        {
+            break;
+        }
+        if (rows[i].last_pc != rows[i].pc)
+        {
+            snprintf(range, sizeof(range), "%d-%d", rows[i].pc, rows[i].last_pc);
+        }
+        else
+        {
+            snprintf(range, sizeof(range), "%d", rows[i].pc);
+        }
+        printf("%-11s %12lld %14lld %14lld %14lld %7.3fx\n", range, rows[i].count,
+               rows[i].cycles[0], rows[i].cycles[1],
+               rows[i].cycles[1] - rows[i].cycles[0],
+               rows[i].cycles[1] ? (double)rows[i].cycles[0] / rows[i].cycles[1] : 0.0);
+    }
+}
+
+/*
+ * Marks the first instruction of every static basic block: the program
+ * entry, branch targets and the instructions after a branch, JUMP or HALT.
+ * JUMP targets are only known at run time and are added by the producer.
+ */
+static void
+sweep_static_leaders(const APEX_CPU *cpu, char *leader)
+{
+    leader[0] = TRUE;
+
+    for (int i = 0; i < cpu->code_memory_size; ++i)
+    {
+        const APEX_Instruction *ins = &cpu->code_memory[i];
+
+        switch (ins->opcode)
+        {
+            case OPCODE_BZ:
+            case OPCODE_BNZ:
+            case OPCODE_BP:
+            case OPCODE_BNP:
+            {
+                int target = i + ins->imm / 4;
+
+                if (target >= 0 && target < cpu->code_memory_size)
+                {
+                    leader[target] = TRUE;
+                }
+            }
+            /* fall through */
+            case OPCODE_JUMP:
+            case OPCODE_HALT:
+            {
+                if (i + 1 < cpu->code_memory_size)
+                {
+                    leader[i + 1] = TRUE;
+                }
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Simulates the program under cpu->config (A) and config_b (B) at the same
+ * time on two threads. The calling thread runs the functional engine once
+ * and broadcasts its retirement stream to both lanes, which check their
+ * pipeline against it while attributing cycles to each static pc. Reports
+ * the cycle deltas per basic block and per pc.
+ */
+void
+APEX_sweep_diff(const APEX_CPU *cpu, const APEX_Config *config_b,
+                const char *cycles)
+{
+    int size = cpu->code_memory_size;
+    APEX_CPU *golden = calloc(1, sizeof(APEX_CPU));
+    APEX_CPU *lane_cpu = calloc(2, sizeof(APEX_CPU));
+    long long *counters = calloc(4 * (size_t)size, sizeof(long long));
+    char *leader = calloc(size, 1);
+    SweepDelta *rows = calloc(size, sizeof(SweepDelta));
+    SweepLane lanes[2];
+    pthread_t threads[2];
+    APEX_Stream stream;
+    int num_blocks = 0;
+
+    if (!golden || !lane_cpu || !counters || !leader || !rows
+        || !APEX_stream_init(&stream, 16, 2))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate differential run state\n");
+        free(golden);
+        free(lane_cpu);
+        free(counters);
+        free(leader);
+        free(rows);
+        return;
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        APEX_cpu_copy(&lane_cpu[i], cpu);
+        lanes[i].cpu = &lane_cpu[i];
+        lanes[i].stream = &stream;
+        lanes[i].reader = i;
+        lanes[i].max_cycles = cycles ? atoi(cycles) : 0;
+        lanes[i].pc_cycles = counters + (2 * i) * size;
+        lanes[i].pc_count = counters + (2 * i + 1) * size;
+        lanes[i].diverged = 0;
+    }
+    lane_cpu[1].config = *config_b;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        if (pthread_create(&threads[i], NULL, sweep_lane_run, &lanes[i]) != 0)
+        {
+            fprintf(stderr, "APEX_Error: Unable to start the lane of config %s\n",
+                    i ? "B" : "A");
+            APEX_stream_close(&stream);
+            for (int j = 0; j < i; ++j)
+            {
+                pthread_join(threads[j], NULL);
+            }
+            APEX_stream_free(&stream);
+            APEX_cpu_release(&lane_cpu[0]);
+            APEX_cpu_release(&lane_cpu[1]);
+            free(golden);
+            free(lane_cpu);
+            free(counters);
+            free(leader);
+            free(rows);
+            return;
+        }
+    }
+
+    /* Producer: the functional engine, one record per instruction */
+    sweep_static_leaders(cpu, leader);
+    APEX_cpu_copy(golden, cpu);
+    while (TRUE)
+    {
+        APEX_Retire rec;
+        int halted = APEX_func_step(golden, &rec);
+
+        if (!APEX_stream_push(&stream, &rec) || halted)
+        {
+            break;
+        }
+        if (rec.opcode == OPCODE_JUMP && golden->pc >= 4000
+            && (golden->pc - 4000) / 4 < size)
+        {
+            leader[(golden->pc - 4000) / 4] = TRUE;
+        }
+    }
+    APEX_stream_close(&stream);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("%-6s %-40s %12s %12s %8s\n", "config", "options", "cycles", "insns", "CPI");
+    for (int i = 0; i < 2; ++i)
+    {
+        char options[256];
+
+        APEX_config_format(&lane_cpu[i].config, options, sizeof(options));
+        printf("%-6s %-40s %12d %12d %8.3f\n", i ? "B" : "A", options,
+               lane_cpu[i].clock, lane_cpu[i].insn_completed,
+               lane_cpu[i].insn_completed
+                   ? (double)lane_cpu[i].clock / lane_cpu[i].insn_completed : 0.0);
+        if (lanes[i].diverged)
+        {
+            printf("APEX_Error: config %s diverged from the functional engine at cycle %d\n",
+                   i ? "B" : "A", lanes[i].diverged);
+        }
+    }
+    printf("Speedup of B over A: %.3fx (%d cycles)\n",
+           lane_cpu[1].clock ? (double)lane_cpu[0].clock / lane_cpu[1].clock : 0.0,
+           lane_cpu[0].clock - lane_cpu[1].clock);
+
+    /* Basic blocks run from one leader to the slot before the next */
+    for (int i = 0; i < size; ++i)
+    {
+        if (leader[i] || num_blocks == 0)
+        {
+            rows[num_blocks].pc = 4000 + 4 * i;
+            rows[num_blocks].count = lanes[0].pc_count[i];
+            num_blocks++;
+        }
+        rows[num_blocks - 1].last_pc = 4000 + 4 * i;
+        rows[num_blocks - 1].cycles[0] += lanes[0].pc_cycles[i];
+        rows[num_blocks - 1].cycles[1] += lanes[1].pc_cycles[i];
+    }
+    sweep_print_deltas("CYCLE DELTA PER BASIC BLOCK", rows, num_blocks);
+
+    for (int i = 0; i < size; ++i)
+    {
+        rows[i].pc = rows[i].last_pc = 4000 + 4 * i;
+        rows[i].count = lanes[0].pc_count[i];
+        rows[i].cycles[0] = lanes[0].pc_cycles[i];
+        rows[i].cycles[1] = lanes[1].pc_cycles[i];
+    }
+    sweep_print_deltas("CYCLE DELTA PER PC", rows, size);
+
+    APEX_stream_free(&stream);
+    APEX_cpu_release(golden);
+    APEX_cpu_release(&lane_cpu[0]);
+    APEX_cpu_release(&lane_cpu[1]);
+    free(golden);
+    free(lane_cpu);
+    free(counters);
+    free(leader);
+    free(rows);
+}
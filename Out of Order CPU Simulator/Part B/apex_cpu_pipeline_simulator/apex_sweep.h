@@ -0,0 +1,18 @@
+/*
+ * apex_sweep.h
+ * Contains declarations of the runs that compare one program under several
+ * configurations
+ */
+#ifndef _APEX_SWEEP_H_
+#define _APEX_SWEEP_H_
+
+#include "apex_cpu.h"
+
+void APEX_sweep_bypass(const APEX_CPU *cpu, const char *cycles);
+void APEX_sweep_width(const APEX_CPU *cpu, const char *cycles);
+void APEX_sweep_flags(const APEX_CPU *cpu, const char *cycles);
+void APEX_sweep_resolve(const APEX_CPU *cpu, const char *cycles);
+void APEX_sweep_prefetch(const APEX_CPU *cpu, const char *cycles);
+void APEX_sweep_diff(const APEX_CPU *cpu, const APEX_Config *config_b,
+                     const char *cycles);
+#endif
@@ -0,0 +1,89 @@
+/*
+ * apex_table.c
+ * Tables of the caches and the branch predictor. They are allocated when
+ * their unit sets its geometry up, to the size configured, so a CPU that
+ * does not use a unit carries nothing of it.
+ *
+ * Copies of the CPU share the tables like data memory pages: a copy only
+ * counts another holder, and the first write through a shared table copies
+ * it. A debugger checkpoint thus costs nothing for a table the CPU has not
+ * touched since the one before. The holders may run on different threads,
+ * hence the atomic counts.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_table.h"
+
+static APEX_Table *
+table_new(size_t size)
+{
+    APEX_Table *table = malloc(sizeof(APEX_Table) + size);
+
+    if (!table)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate cache and predictor tables\n");
+        exit(1);
+    }
+    atomic_init(&table->refs, 1);
+    table->size = size;
+    return table;
+}
+
+/*
+ * Replaces *table with one of size bytes, all zero, and returns its data.
+ * No table is allocated for 0 bytes.
+ */
+void *
+APEX_table_alloc(APEX_Table **table, size_t size)
+{
+    APEX_table_release(table);
+    if (!size)
+    {
+        return NULL;
+    }
+    *table = table_new(size);
+    memset((*table)->data, 0, size);
+    return (*table)->data;
+}
+
+/* Returns the data of *table to write to, copying it first if shared */
+void *
+APEX_table_write(APEX_Table **table)
+{
+    APEX_Table *shared = *table;
+
+    if (!shared)
+    {
+        return NULL;
+    }
+    if (atomic_load_explicit(&shared->refs, memory_order_acquire) > 1)
+    {
+        *table = table_new(shared->size);
+        memcpy((*table)->data, shared->data, shared->size);
+        APEX_table_release(&shared);
+    }
+    return (*table)->data;
+}
+
+/* Counts one more holder of table, which a plain struct copy made */
+void
+APEX_table_clone(APEX_Table *table)
+{
+    if (table)
+    {
+        atomic_fetch_add_explicit(&table->refs, 1, memory_order_relaxed);
+    }
+}
+
+/* Drops the hold on *table, freeing it with the last holder */
+void
+APEX_table_release(APEX_Table **table)
+{
+    if (*table && atomic_fetch_sub_explicit(&(*table)->refs, 1, memory_order_acq_rel) == 1)
+    {
+        free(*table);
+    }
+    *table = NULL;
+}
@@ -0,0 +1,25 @@
+/*
+ * apex_table.h
+ * Contains declarations of the tables of the caches and the branch
+ * predictor, allocated to their configured size and shared copy-on-write
+ * between copies of the CPU
+ */
+#ifndef _APEX_TABLE_H_
+#define _APEX_TABLE_H_
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/* Entries of one table, counting the copies of the CPU holding it */
+typedef struct APEX_Table
+{
+    _Atomic int refs;
+    size_t size;                   /* Bytes of data */
+    _Alignas(long long) unsigned char data[];
+} APEX_Table;
+
+void *APEX_table_alloc(APEX_Table **table, size_t size);
+void *APEX_table_write(APEX_Table **table);
+void APEX_table_clone(APEX_Table *table);
+void APEX_table_release(APEX_Table **table);
+#endif
@@ -0,0 +1,481 @@
+/*
+ * apex_trace.c
+ * Dynamic traces recorded by the functional engine and the trace-driven
+ * timing runs replaying them
+ *
+ * A trace holds one APEX_TraceRecord per executed instruction, carrying
+ * what the pipeline cannot know without evaluating it: the data memory word
+ * of loads and stores, the outcome of conditional branches and the target
+ * of JUMP. With cpu->trace set, the pipeline stages take these from the
+ * trace instead of executing, so any number of timing configurations can
+ * replay one recording side by side. A live run instead streams the trace
+ * from the functional engine on one thread to the pipeline on another.
+ */
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_func.h"
+#include "apex_macros.h"
+#include "apex_stream.h"
+#include "apex_trace.h"
+
+/* Records in the ring of a live trace run */
+#define TRACE_QUEUE_SIZE_LOG2 16
+
+static const char trace_magic[8] = "APEXTRC1";
+
+/* Layout of a trace file, followed by num_records APEX_TraceRecord */
+typedef struct TraceHeader
+{
+    char magic[8];
+    long long num_records;
+} TraceHeader;
+
+/* Fills the info field of a trace record from a functional retirement */
+static int
+trace_info(const APEX_Retire *rec, int next_pc)
+{
+    switch (rec->opcode)
+    {
+        case OPCODE_LOAD:
+        case OPCODE_LDI:
+        case OPCODE_LL:
+        case OPCODE_SC:
+        case OPCODE_FAA:
+        {
+            return rec->mem_read;
+        }
+
+        case OPCODE_STORE:
+        case OPCODE_STI:
+        {
+            return rec->mem_addr;
+        }
+
+        /* Branches leave the flags they test untouched */
+        case OPCODE_BZ:
+        {
+            return rec->zero_flag == TRUE;
+        }
+
+        case OPCODE_BNZ:
+        {
+            return rec->zero_flag == FALSE;
+        }
+
+        case OPCODE_BP:
+        {
+            return rec->positive_flag == TRUE;
+        }
+
+        case OPCODE_BNP:
+        {
+            return rec->positive_flag == FALSE;
+        }
+
+        case OPCODE_JUMP:
+        {
+            return next_pc;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Runs the program on the functional engine until HALT, or until pc leaves
+ * code memory, and writes its dynamic trace to filename.
+ *
+ * Returns FALSE, after printing why, when the file cannot be written.
+ */
+int
+APEX_trace_record(const APEX_CPU *cpu, const char *filename)
+{
+    APEX_CPU *golden = calloc(1, sizeof(APEX_CPU));
+    TraceHeader header;
+    FILE *fp;
+    int halted = FALSE;
+
+    if (!filename)
+    {
+        fprintf(stderr, "APEX_Error: trace_record needs a file name\n");
+        free(golden);
+        return FALSE;
+    }
+    fp = fopen(filename, "wb");
+    if (!fp || !golden)
+    {
+        fprintf(stderr, "APEX_Error: Unable to create trace '%s'\n", filename);
+        if (fp)
+        {
+            fclose(fp);
+        }
+        free(golden);
+        return FALSE;
+    }
+
+    memcpy(header.magic, trace_magic, sizeof(header.magic));
+    header.num_records = 0;
+    fwrite(&header, sizeof(header), 1, fp);
+
+    APEX_cpu_copy(golden, cpu);
+    while (!halted)
+    {
+        APEX_Retire rec;
+        APEX_TraceRecord out;
+        int pc = golden->pc;
+        int retired = golden->insn_completed;
+
+        halted = APEX_func_step(golden, &rec);
+        if (golden->insn_completed == retired)
+        {
+            break;
+        }
+        out.pc = pc;
+        out.info = trace_info(&rec, golden->pc);
+        fwrite(&out, sizeof(out), 1, fp);
+        header.num_records++;
+    }
+
+    rewind(fp);
+    fwrite(&header, sizeof(header), 1, fp);
+    if (fclose(fp) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write trace '%s'\n", filename);
+        APEX_cpu_release(golden);
+        free(golden);
+        return FALSE;
+    }
+
+    printf("APEX_TRACE: %lld instructions recorded to %s\n",
+           header.num_records, filename);
+    APEX_cpu_release(golden);
+    free(golden);
+    return TRUE;
+}
+
+/*
+ * Reads a trace recorded for the program loaded in cpu and stores its
+ * length in *len. Returns NULL, after printing why, when the file is not a
+ * trace or belongs to another program.
+ */
+APEX_TraceRecord *
+APEX_trace_load(const APEX_CPU *cpu, const char *filename, long *len)
+{
+    APEX_TraceRecord *trace;
+    TraceHeader header;
+    FILE *fp;
+
+    if (!filename)
+    {
+        fprintf(stderr, "APEX_Error: trace_run needs a trace file name\n");
+        return NULL;
+    }
+    fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open trace '%s'\n", filename);
+        return NULL;
+    }
+    if (fread(&header, sizeof(header), 1, fp) != 1
+        || memcmp(header.magic, trace_magic, sizeof(header.magic)) != 0
+        || header.num_records <= 0)
+    {
+        fprintf(stderr, "APEX_Error: '%s' is not an APEX trace\n", filename);
+        fclose(fp);
+        return NULL;
+    }
+
+    trace = malloc(header.num_records * sizeof(APEX_TraceRecord));
+    if (!trace)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate %lld trace records\n",
+                header.num_records);
+        fclose(fp);
+        return NULL;
+    }
+    if (fread(trace, sizeof(APEX_TraceRecord), header.num_records, fp)
+        != (size_t)header.num_records)
+    {
+        fprintf(stderr, "APEX_Error: Trace '%s' is truncated\n", filename);
+        free(trace);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+
+    for (long long i = 0; i < header.num_records; ++i)
+    {
+        int index = (trace[i].pc - 4000) / 4;
+
+        if (trace[i].pc < 4000 || index >= cpu->code_memory_size
+            || trace[i].pc % 4 != 0)
+        {
+            fprintf(stderr, "APEX_Error: Trace '%s' does not match the program, "
+                    "record %lld has pc %d\n", filename, i, trace[i].pc);
+            free(trace);
+            return NULL;
+        }
+    }
+
+    *len = (long)header.num_records;
+    return trace;
+}
+
+/*
+ * Replays the trace on one configuration until HALT retires, or until the
+ * trace is exhausted and the pipeline has drained
+ */
+static void *
+trace_lane_run(void *arg)
+{
+    APEX_CPU *cpu = arg;
+
+    while (!APEX_cpu_cycle(cpu))
+    {
+        if (cpu->trace_pos == cpu->trace_len && !cpu->decode.has_insn
+            && !cpu->execute.has_insn && !cpu->memory.has_insn
+            && !cpu->writeback.has_insn)
+        {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void
+trace_print_lanes(const APEX_CPU *lanes, int num_lanes)
+{
+    printf("%-6s %-40s %12s %12s %8s %12s %12s\n", "config", "options", "cycles",
+           "insns", "CPI", "stalls", "mem_stalls");
+    for (int i = 0; i < num_lanes; ++i)
+    {
+        char name[16];
+        char options[256];
+
+        snprintf(name, sizeof(name), "c%d", i);
+        APEX_config_format(&lanes[i].config, options, sizeof(options));
+        printf("%-6s %-40s %12d %12d %8.3f %12d %12d\n", name, options,
+               lanes[i].clock, lanes[i].insn_completed,
+               lanes[i].insn_completed
+                   ? (double)lanes[i].clock / lanes[i].insn_completed : 0.0,
+               lanes[i].stall_cycles, lanes[i].mem_stall_cycles);
+    }
+}
+
+/*
+ * Replays the trace in filename under every configuration at once, one
+ * thread each, and reports their cycles side by side. All threads share the
+ * read-only trace.
+ *
+ * Returns FALSE, after printing why, when the trace cannot be used.
+ */
+int
+APEX_trace_run(const APEX_CPU *cpu, const APEX_Config *configs,
+               int num_configs, const char *filename)
+{
+    APEX_CPU *lanes = calloc(num_configs, sizeof(APEX_CPU));
+    pthread_t threads[APEX_MAX_CONFIGS];
+    APEX_TraceRecord *trace;
+    long len;
+
+    if (!lanes)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate trace run state\n");
+        return FALSE;
+    }
+    trace = APEX_trace_load(cpu, filename, &len);
+    if (!trace)
+    {
+        free(lanes);
+        return FALSE;
+    }
+
+    for (int i = 0; i < num_configs; ++i)
+    {
+        APEX_cpu_copy(&lanes[i], cpu);
+        lanes[i].config = configs[i];
+        lanes[i].trace = trace;
+        lanes[i].trace_mask = ~0L;
+        lanes[i].trace_len = len;
+        lanes[i].trace_pos = 0;
+        if (pthread_create(&threads[i], NULL, trace_lane_run, &lanes[i]) != 0)
+        {
+            fprintf(stderr, "APEX_Error: Unable to start the lane of config c%d\n", i);
+            for (int j = 0; j <= i; ++j)
+            {
+                if (j < i)
+                {
+                    pthread_join(threads[j], NULL);
+                }
+                APEX_cpu_release(&lanes[j]);
+            }
+            free(trace);
+            free(lanes);
+            return FALSE;
+        }
+    }
+    for (int i = 0; i < num_configs; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("APEX_TRACE: %ld instructions replayed under %d configurations\n",
+           len, num_configs);
+    trace_print_lanes(lanes, num_configs);
+
+    for (int i = 0; i < num_configs; ++i)
+    {
+        APEX_cpu_release(&lanes[i]);
+    }
+    free(trace);
+    free(lanes);
+    return TRUE;
+}
+
+/*
+ * Called by fetch on the timing thread once every published record has been
+ * fetched: hands the consumed slots back to the functional thread and waits
+ * for more. The newest record stays in place, a taken branch to the next pc
+ * fetches it again.
+ *
+ * Returns FALSE once the functional thread is done and nothing is left.
+ */
+int
+APEX_trace_queue_wait(APEX_CPU *cpu)
+{
+    APEX_TraceQueue *queue = cpu->trace_queue;
+
+    atomic_store_explicit(&queue->tail.pos, cpu->trace_pos - 1, memory_order_release);
+    while (TRUE)
+    {
+        int closed = atomic_load_explicit(&queue->closed, memory_order_acquire);
+
+        cpu->trace_len = atomic_load_explicit(&queue->head.pos, memory_order_acquire);
+        if (cpu->trace_pos < cpu->trace_len)
+        {
+            return TRUE;
+        }
+        if (closed)
+        {
+            return FALSE;
+        }
+        sched_yield();
+    }
+}
+
+/* Appends one record, waiting while the timing thread is a full ring behind */
+static void
+trace_queue_push(APEX_TraceQueue *queue, const APEX_TraceRecord *rec)
+{
+    long head = atomic_load_explicit(&queue->head.pos, memory_order_relaxed);
+
+    while (head - queue->head.cached > queue->mask)
+    {
+        queue->head.cached = atomic_load_explicit(&queue->tail.pos, memory_order_acquire);
+        if (head - queue->head.cached > queue->mask)
+        {
+            sched_yield();
+        }
+    }
+
+    queue->ring[head & queue->mask] = *rec;
+    atomic_store_explicit(&queue->head.pos, head + 1, memory_order_release);
+}
+
+/* Timing thread of a live run, detaches so the producer never waits on it */
+static void *
+trace_live_lane_run(void *arg)
+{
+    APEX_CPU *cpu = arg;
+
+    trace_lane_run(cpu);
+    atomic_store_explicit(&cpu->trace_queue->tail.pos, LONG_MAX, memory_order_release);
+    return NULL;
+}
+
+/*
+ * Simulates the program under cpu->config as two pipelined threads: the
+ * calling thread runs ahead on the functional engine and streams the trace
+ * through a lock-free queue to a timing thread, which replays it through the
+ * pipeline stages. Neither thread waits for the other except when the
+ * queue is full or empty.
+ *
+ * Returns FALSE, after printing why, when the queue cannot be allocated.
+ */
+int
+APEX_trace_live(const APEX_CPU *cpu)
+{
+    APEX_CPU *golden = calloc(1, sizeof(APEX_CPU));
+    APEX_CPU *lane = calloc(1, sizeof(APEX_CPU));
+    APEX_TraceQueue queue;
+    pthread_t thread;
+
+    memset(&queue, 0, sizeof(queue));
+    queue.ring = malloc(sizeof(APEX_TraceRecord) << TRACE_QUEUE_SIZE_LOG2);
+    queue.mask = (1L << TRACE_QUEUE_SIZE_LOG2) - 1;
+    queue.tail.pos = -1;
+    if (!golden || !lane || !queue.ring)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate live trace state\n");
+        free(golden);
+        free(lane);
+        free(queue.ring);
+        return FALSE;
+    }
+
+    APEX_cpu_copy(lane, cpu);
+    lane->trace = queue.ring;
+    lane->trace_mask = queue.mask;
+    lane->trace_len = 0;
+    lane->trace_pos = 0;
+    lane->trace_queue = &queue;
+    if (pthread_create(&thread, NULL, trace_live_lane_run, lane) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to start the timing thread\n");
+        free(queue.ring);
+        APEX_cpu_release(lane);
+        free(golden);
+        free(lane);
+        return FALSE;
+    }
+
+    APEX_cpu_copy(golden, cpu);
+    while (TRUE)
+    {
+        APEX_Retire rec;
+        APEX_TraceRecord out;
+        int pc = golden->pc;
+        int retired = golden->insn_completed;
+        int halted = APEX_func_step(golden, &rec);
+
+        if (golden->insn_completed == retired)
+        {
+            break;
+        }
+        out.pc = pc;
+        out.info = trace_info(&rec, golden->pc);
+        trace_queue_push(&queue, &out);
+        if (halted)
+        {
+            break;
+        }
+    }
+    atomic_store_explicit(&queue.closed, TRUE, memory_order_release);
+    pthread_join(thread, NULL);
+
+    printf("APEX_TRACE: %d instructions streamed to the timing thread\n",
+           golden->insn_completed);
+    trace_print_lanes(lane, 1);
+
+    free(queue.ring);
+    APEX_cpu_release(golden);
+    APEX_cpu_release(lane);
+    free(golden);
+    free(lane);
+    return TRUE;
+}
@@ -0,0 +1,30 @@
+/*
+ * apex_trace.h
+ * Contains declarations of the dynamic trace recorder and of the
+ * trace-driven timing runs
+ */
+#ifndef _APEX_TRACE_H_
+#define _APEX_TRACE_H_
+
+#include "apex_cpu.h"
+#include "apex_stream.h"
+
+/* Single-producer single-consumer ring carrying a live trace from the
+ * functional thread to the timing thread */
+typedef struct APEX_TraceQueue
+{
+    APEX_TraceRecord *ring;
+    long mask;                     /* Ring size - 1, size is a power of two */
+    _Atomic int closed;
+    APEX_StreamCursor head;        /* Functional thread */
+    APEX_StreamCursor tail;        /* Timing thread */
+} APEX_TraceQueue;
+
+int APEX_trace_queue_wait(APEX_CPU *cpu);
+int APEX_trace_record(const APEX_CPU *cpu, const char *filename);
+APEX_TraceRecord *APEX_trace_load(const APEX_CPU *cpu, const char *filename,
+                                  long *len);
+int APEX_trace_run(const APEX_CPU *cpu, const APEX_Config *configs,
+                   int num_configs, const char *filename);
+int APEX_trace_live(const APEX_CPU *cpu);
+#endif
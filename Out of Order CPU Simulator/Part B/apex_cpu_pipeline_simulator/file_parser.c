@@ -154,22 +154,46 @@ set_opcode_str(const char *opcode_str)
         return OPCODE_JUMP;
     }
 
+    if (strcmp(opcode_str, "LL") == 0)
+    {
+        return OPCODE_LL;
+    }
+
+    if (strcmp(opcode_str, "SC") == 0)
+    {
+        return OPCODE_SC;
+    }
+
+    if (strcmp(opcode_str, "FAA") == 0)
+    {
+        return OPCODE_FAA;
+    }
+
+    if (strcmp(opcode_str, "FENCE") == 0)
+    {
+        return OPCODE_FENCE;
+    }
+
     assert(0 && "Invalid opcode");
     return 0;
 }
 
+/*
+ * Splits the opcode from its operands. The line ending is a separator too,
+ * so that an opcode without operands, such as FENCE, is found on any line.
+ */
 static void
 split_opcode_from_insn_string(char *buffer, char tokens[2][128])
 {
     int token_num = 0;
 
-    char *token = strtok(buffer, " ");
+    char *token = strtok(buffer, " \t\r\n");
 
-    while (token != NULL)
+    while (token != NULL && token_num < 2)
     {
         strcpy(tokens[token_num], token);
         token_num++;
-        token = strtok(NULL, " ");
+        token = strtok(NULL, " \t\r\n");
     }
 }
 
@@ -231,6 +255,7 @@ create_APEX_instruction(APEX_Instruction *ins, char *buffer)
         case OPCODE_ADDL:
         case OPCODE_SUBL:
         case OPCODE_LDI:
+        case OPCODE_LL:
         {
             ins->rd = get_num_from_string(tokens[0]);
             ins->rs1 = get_num_from_string(tokens[1]);
@@ -247,6 +272,16 @@ create_APEX_instruction(APEX_Instruction *ins, char *buffer)
             break;
         }
 
+        case OPCODE_SC:
+        case OPCODE_FAA:
+        {
+            ins->rd = get_num_from_string(tokens[0]);
+            ins->rs1 = get_num_from_string(tokens[1]);
+            ins->rs2 = get_num_from_string(tokens[2]);
+            ins->imm = get_num_from_string(tokens[3]);
+            break;
+        }
+
         case OPCODE_BZ:
         case OPCODE_BNZ:
         case OPCODE_BP:
@@ -272,6 +307,7 @@ create_APEX_instruction(APEX_Instruction *ins, char *buffer)
 
         case OPCODE_HALT:
         case OPCODE_NOP:
+        case OPCODE_FENCE:
         {
             break;
         }
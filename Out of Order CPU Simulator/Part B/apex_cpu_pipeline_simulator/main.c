@@ -9,12 +9,78 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "apex_cache.h"
+#include "apex_checker.h"
 #include "apex_cpu.h"
+#include "apex_debug.h"
+#include "apex_frontend.h"
+#include "apex_fu.h"
+#include "apex_fusion.h"
+#include "apex_gdbstub.h"
+#include "apex_issue.h"
+#include "apex_mrc.h"
+#include "apex_multicore.h"
+#include "apex_profile.h"
+#include "apex_smt.h"
+#include "apex_sweep.h"
+#include "apex_trace.h"
+
+/* Commands a pipeline wider than 1, fusing instructions, with another
+ * front end or resolving branches in another stage can run, all of them
+ * only watching it retire as a whole */
+static int
+wide_command(const char *command)
+{
+    static const char *commands[] = { "simulate", "display", "single_step", "show_mem",
+                                      "check", "cache_stats", "prefetch_sweep",
+                                      "bypass_sweep", "width_sweep", "issue_stats",
+                                      "fu_stats", "flags_sweep", "fusion_stats",
+                                      "frontend_stats", "indirect_stats", "resolve_sweep" };
+
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); ++i)
+    {
+        if (strcmp(command, commands[i]) == 0)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* TRUE when config fuses any pair */
+static int
+fusing(const APEX_Config *config)
+{
+    for (int op = 0; op < OPCODE_COUNT; ++op)
+    {
+        if (config->fuse[op])
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* The data image and the code of SMT threads belong to the program, not to
+ * a configuration */
+static int
+data_option(const char *option)
+{
+    return strncmp(option, "data_image=", 11) == 0 || strncmp(option, "data_base=", 10) == 0
+           || strncmp(option, "smt_image=", 10) == 0;
+}
 
 int
 main(int argc, char const *argv[])
 {
     APEX_CPU *cpu;
+    APEX_Config configs[APEX_MAX_CONFIGS];
+    int num_configs = 1;
+    const char *arg = NULL;
+    const char *data_image = NULL;
+    int data_base = 0;
+    const char *smt_images[SMT_MAX_THREADS];
+    int num_smt_images = 0;
 
     //fprintf(stderr, "APEX CPU Pipeline Simulator v%0.1lf\n", VERSION);
 
@@ -24,14 +90,266 @@ main(int argc, char const *argv[])
         exit(1);
     }
 
-    cpu = APEX_cpu_init(argv[1]);
+    for (int i = 3; i < argc; ++i)
+    {
+        if (strncmp(argv[i], "data_image=", 11) == 0)
+        {
+            data_image = argv[i] + 11;
+        }
+        else if (strncmp(argv[i], "data_base=", 10) == 0)
+        {
+            data_base = atoi(argv[i] + 10);
+        }
+        else if (strncmp(argv[i], "smt_image=", 10) == 0)
+        {
+            if (num_smt_images == SMT_MAX_THREADS - 1)
+            {
+                fprintf(stderr, "APEX_Error: At most %d smt_image options\n",
+                        SMT_MAX_THREADS - 1);
+                exit(1);
+            }
+            smt_images[num_smt_images++] = argv[i] + 10;
+        }
+    }
+
+    cpu = APEX_cpu_init(argv[1], data_image, data_base);
     if (!cpu)
     {
         fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
         exit(1);
     }
+
+    /* Anything after the command is either its argument or a key=value
+     * configuration option. Options prefixed with "c<n>." (or "b." for
+     * c1) only apply to configuration n of a multi-configuration run, on
+     * top of the plain options. */
+    for (int i = 3; i < argc; ++i)
+    {
+        const char *option = argv[i];
+        int target;
+
+        if (!strchr(option, '='))
+        {
+            arg = option;
+            continue;
+        }
+        if (data_option(option))
+        {
+            continue;
+        }
+
+        target = APEX_config_target(&option);
+        if (target < 0 || (target == 0 && !APEX_config_set(&cpu->config, option)))
+        {
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        if (target >= num_configs)
+        {
+            num_configs = target + 1;
+        }
+    }
+
+    for (int i = 0; i < APEX_MAX_CONFIGS; ++i)
+    {
+        configs[i] = cpu->config;
+    }
+    for (int i = 3; i < argc; ++i)
+    {
+        const char *option = argv[i];
+        int target;
+
+        if (!strchr(option, '=') || data_option(option))
+        {
+            continue;
+        }
+        target = APEX_config_target(&option);
+        if (target == 0)
+        {
+            continue;
+        }
+        if (strcmp(argv[2], "diff") != 0 && strcmp(argv[2], "trace_run") != 0)
+        {
+            fprintf(stderr, "APEX_Error: '%s' is only valid for the diff and trace_run commands\n", argv[i]);
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        if (strcmp(argv[2], "diff") == 0 && target > 1)
+        {
+            fprintf(stderr, "APEX_Error: '%s' is not valid for the diff command, which only "
+                    "compares A and B (b. or c1.)\n", argv[i]);
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        if (!APEX_config_set(&configs[target], option))
+        {
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+    }
+    /* The lanes of diff and trace_run retire one unfused instruction a
+     * cycle, fetched by the coupled front end and resolving branches in
+     * execute, so every configuration of the run is held to the same
+     * limits as A */
+    for (int i = 0; i < num_configs; ++i)
+    {
+        const APEX_Config *config = i == 0 ? &cpu->config : &configs[i];
+        char prefix[16] = "";
+
+        if (i > 0)
+        {
+            snprintf(prefix, sizeof(prefix), "c%d.", i);
+        }
+        if (!APEX_config_check(config))
+        {
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        if (config->width > 1 && !wide_command(argv[2]))
+        {
+            fprintf(stderr, "APEX_Error: %swidth is not valid for the %s command\n", prefix,
+                    argv[2]);
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        if (fusing(config) && !wide_command(argv[2]))
+        {
+            fprintf(stderr, "APEX_Error: %sfuse is not valid for the %s command\n", prefix,
+                    argv[2]);
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        if ((config->frontend != FRONTEND_COUPLED || config->l1i_size)
+            && !wide_command(argv[2]))
+        {
+            fprintf(stderr, "APEX_Error: %sfrontend and %sl1i_size are not valid for the %s "
+                    "command\n", prefix, prefix, argv[2]);
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        if (config->branch_resolve != RESOLVE_EXECUTE && !wide_command(argv[2]))
+        {
+            fprintf(stderr, "APEX_Error: %sbranch_resolve is not valid for the %s command\n",
+                    prefix, argv[2]);
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+    }
+    if (cpu->config.smt_threads > 1 && strcmp(argv[2], "smt") != 0)
+    {
+        fprintf(stderr, "APEX_Error: smt_threads is only valid for the smt command\n");
+        APEX_cpu_stop(cpu);
+        exit(1);
+    }
     
-    APEX_cpu_run(cpu,argv[2],argv[3]);
+    if (strcmp(argv[2], "debug") == 0)
+    {
+        APEX_debug_run(cpu);
+    }
+    else if (strcmp(argv[2], "check") == 0)
+    {
+        if (!APEX_checker_run(cpu, arg))
+        {
+            APEX_cpu_stop(cpu);
+            return 2;
+        }
+    }
+    else if (strcmp(argv[2], "diff") == 0)
+    {
+        APEX_sweep_diff(cpu, &configs[1], arg);
+    }
+    else if (strcmp(argv[2], "trace_record") == 0 || strcmp(argv[2], "trace_run") == 0)
+    {
+        int ok = strcmp(argv[2], "trace_record") == 0
+                     ? APEX_trace_record(cpu, arg)
+                     : APEX_trace_run(cpu, configs, num_configs, arg);
+
+        if (!ok)
+        {
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+    }
+    else if (strcmp(argv[2], "trace_live") == 0)
+    {
+        if (!APEX_trace_live(cpu))
+        {
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+    }
+    else if (strcmp(argv[2], "cache_mrc") == 0)
+    {
+        APEX_mrc_run(cpu, arg);
+    }
+    else if (strcmp(argv[2], "mem_profile") == 0)
+    {
+        APEX_profile_run(cpu, arg);
+    }
+    else if (strcmp(argv[2], "cache_stats") == 0)
+    {
+        APEX_cache_run(cpu, arg);
+    }
+    else if (strcmp(argv[2], "prefetch_sweep") == 0)
+    {
+        APEX_sweep_prefetch(cpu, arg);
+    }
+    else if (strcmp(argv[2], "multicore") == 0)
+    {
+        APEX_multicore_run(cpu, arg);
+    }
+    else if (strcmp(argv[2], "smt") == 0)
+    {
+        APEX_smt_run(cpu, argv[1], smt_images, num_smt_images, arg);
+    }
+    else if (strcmp(argv[2], "bypass_sweep") == 0)
+    {
+        APEX_sweep_bypass(cpu, arg);
+    }
+    else if (strcmp(argv[2], "width_sweep") == 0)
+    {
+        APEX_sweep_width(cpu, arg);
+    }
+    else if (strcmp(argv[2], "flags_sweep") == 0)
+    {
+        APEX_sweep_flags(cpu, arg);
+    }
+    else if (strcmp(argv[2], "resolve_sweep") == 0)
+    {
+        APEX_sweep_resolve(cpu, arg);
+    }
+    else if (strcmp(argv[2], "issue_stats") == 0)
+    {
+        APEX_issue_run(cpu, arg);
+    }
+    else if (strcmp(argv[2], "fu_stats") == 0)
+    {
+        APEX_fu_run(cpu, arg);
+    }
+    else if (strcmp(argv[2], "frontend_stats") == 0)
+    {
+        APEX_frontend_run(cpu, arg);
+    }
+    else if (strcmp(argv[2], "indirect_stats") == 0)
+    {
+        APEX_frontend_indirect_run(cpu, arg);
+    }
+    else if (strcmp(argv[2], "fusion_stats") == 0)
+    {
+        APEX_fusion_run(cpu, arg);
+    }
+    else if (strcmp(argv[2], "gdbserver") == 0 || strcmp(argv[2], "gdbserver_func") == 0)
+    {
+        if (!APEX_gdb_serve(cpu, arg, strcmp(argv[2], "gdbserver") == 0))
+        {
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+    }
+    else
+    {
+        APEX_cpu_run(cpu,argv[2],arg);
+    }
     APEX_cpu_stop(cpu);
     return 0;
 }
\ No newline at end of file